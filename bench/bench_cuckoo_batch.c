@@ -0,0 +1,84 @@
+/* bench_cuckoo_batch.c -- compare cuckoo_lookup() one element at a time
+ *                         with cuckoo_lookup_batch(), on filters from
+ *                         cache-sized up to much larger than the LLC.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "cuckoo.h"
+
+#define LOOKUPS 4000000
+#define BATCH   64
+
+static double now_seconds() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void run(size_t slots) {
+	cuckoofilter cf;
+	uint64_t    *keys = malloc(LOOKUPS * sizeof(uint64_t));
+	void        *ptrs[BATCH];
+	size_t       lens[BATCH];
+	bool         results[BATCH];
+	size_t       found = 0;
+	double       start, single, batched;
+
+	if (keys == NULL || cuckoo_init(&cf, slots / 4, 4, 500) != true) {
+		fprintf(stderr, "out of memory\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (uint64_t key = 0; key < slots / 10 * 9; key++) {
+		cuckoo_add(&cf, &key, sizeof(key));
+	}
+
+	// half of the keys looked up are in the filter
+	for (size_t i = 0; i < LOOKUPS; i++) {
+		keys[i] = ((uint64_t)rand() << 16 ^ rand()) % (slots / 10 * 18);
+	}
+
+	start = now_seconds();
+	for (size_t i = 0; i < LOOKUPS; i++) {
+		found += cuckoo_lookup(cf, &keys[i], sizeof(uint64_t));
+	}
+	single = now_seconds() - start;
+
+	start = now_seconds();
+	for (size_t i = 0; i < LOOKUPS; i += BATCH) {
+		for (size_t b = 0; b < BATCH; b++) {
+			ptrs[b] = &keys[i + b];
+			lens[b] = sizeof(uint64_t);
+		}
+
+		cuckoo_lookup_batch(cf, ptrs, lens, BATCH, results);
+		for (size_t b = 0; b < BATCH; b++) {
+			found -= results[b];
+		}
+	}
+	batched = now_seconds() - start;
+
+	printf("%10zu slots %8zu KiB %10.2f Mlookup/s single %10.2f Mlookup/s batched%s\n",
+		   slots, cuckoo_memory(cf) / 1024,
+		   LOOKUPS / single / 1e6, LOOKUPS / batched / 1e6,
+		   (found != 0) ? " (results differ)" : "");
+
+	cuckoo_destroy(cf);
+	free(keys);
+}
+
+int main() {
+	printf("%d lookups, 16 bit fingerprints, 4 per bucket, 90%% load\n\n", LOOKUPS);
+
+	for (size_t slots = 1 << 16; slots <= 1 << 26; slots <<= 2) {
+		run(slots);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,95 @@
+/* bench_cuckoo_load.c -- compare random-walk and breadth-first eviction in
+ *                        cuckoo filters: load factor reached before the
+ *                        first failed insert, and insert latency as the
+ *                        filter fills up.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "cuckoo.h"
+
+#define SLOTS     (1 << 20)
+#define MAX_KICKS 500
+
+static uint64_t now_ns() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* run() - insert until the first failure, then report the load factor and
+ *         the latency of the last 5% of inserts, where evictions are long.
+ */
+static void run(size_t bucket_size, int flags, uint64_t *latencies) {
+	cuckoofilter cf;
+	uint64_t     key;
+	size_t       added = 0;
+
+	if (cuckoo_init_ex(&cf, SLOTS / bucket_size, bucket_size, MAX_KICKS, 16, flags) != true) {
+		fprintf(stderr, "cuckoo_init_ex() failed\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (key = 0; key < SLOTS; key++) {
+		uint64_t start = now_ns();
+		bool     ok    = cuckoo_add(&cf, &key, sizeof(key));
+
+		latencies[key] = now_ns() - start;
+		if (!ok) {
+			break;
+		}
+		added++;
+	}
+
+	size_t    tail  = added / 20;
+	uint64_t *last  = latencies + added - tail;
+	uint64_t  total = 0;
+
+	for (size_t i = 0; i < tail; i++) {
+		total += last[i];
+	}
+	qsort(last, tail, sizeof(uint64_t), compare_u64);
+
+	printf("%-8s %2zu slots %8.2f%% load %10.0f ns mean %10lu ns p99 %10lu ns max\n",
+		   (flags & CUCKOO_BFS) ? "bfs" : "random",
+		   bucket_size,
+		   cuckoo_load_factor(cf),
+		   tail ? (double)total / tail : 0.0,
+		   tail ? last[tail * 99 / 100] : 0,
+		   tail ? last[tail - 1] : 0);
+
+	cuckoo_destroy(cf);
+}
+
+int main() {
+	uint64_t *latencies = malloc(SLOTS * sizeof(uint64_t));
+	size_t    sizes[]   = { 2, 4, 8 };
+
+	if (latencies == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("%d slots, 16 bit fingerprints, max_kicks %d\n", SLOTS, MAX_KICKS);
+	printf("latencies are for the last 5%% of inserts before the first failure\n\n");
+
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		run(sizes[i], 0, latencies);
+		run(sizes[i], CUCKOO_BFS, latencies);
+	}
+
+	free(latencies);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,133 @@
+/* bench_cuckoo_mt.c -- measure how cuckoo filter lookups scale across
+ *                      threads: a plain filter read without synchronization,
+ *                      a CUCKOO_CONCURRENT filter, and a CUCKOO_CONCURRENT
+ *                      filter with one thread removing and re-adding
+ *                      elements throughout.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "cuckoo.h"
+
+#define SLOTS       (1 << 22)
+#define ELEMENTS    (SLOTS / 10 * 9)
+#define LOOKUPS     4000000
+#define MAX_THREADS 64
+
+typedef struct {
+	cuckoofilter *cf;
+	uint64_t      seed;
+	size_t        found;
+} reader_args;
+
+typedef struct {
+	cuckoofilter *cf;
+	bool          done;
+} writer_args;
+
+static double now_seconds() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *reader(void *arg) {
+	reader_args *args = arg;
+	uint64_t     key  = args->seed;
+
+	// half of the keys looked up are in the filter
+	for (int i = 0; i < LOOKUPS; i++) {
+		key = key * 6364136223846793005ULL + 1442695040888963407ULL;
+		uint64_t k = (key >> 20) % (ELEMENTS * 2);
+		args->found += cuckoo_lookup(*args->cf, &k, sizeof(k));
+	}
+
+	return NULL;
+}
+
+static void *writer(void *arg) {
+	writer_args *args = arg;
+
+	for (uint64_t key = 0; !__atomic_load_n(&args->done, __ATOMIC_RELAXED); key = (key + 1) % ELEMENTS) {
+		cuckoo_remove(args->cf, &key, sizeof(key));
+		cuckoo_add(args->cf, &key, sizeof(key));
+	}
+
+	return NULL;
+}
+
+static double run(cuckoofilter *cf, int threads, bool with_writer) {
+	pthread_t   tids[MAX_THREADS];
+	pthread_t   wtid;
+	reader_args args[MAX_THREADS];
+	writer_args wargs = { cf, false };
+	double      start, elapsed;
+
+	if (with_writer) {
+		pthread_create(&wtid, NULL, writer, &wargs);
+	}
+
+	start = now_seconds();
+	for (int t = 0; t < threads; t++) {
+		args[t].cf    = cf;
+		args[t].seed  = t + 1;
+		args[t].found = 0;
+		pthread_create(&tids[t], NULL, reader, &args[t]);
+	}
+
+	for (int t = 0; t < threads; t++) {
+		pthread_join(tids[t], NULL);
+	}
+	elapsed = now_seconds() - start;
+
+	if (with_writer) {
+		__atomic_store_n(&wargs.done, true, __ATOMIC_RELAXED);
+		pthread_join(wtid, NULL);
+	}
+
+	return (double)LOOKUPS * threads / elapsed / 1e6;
+}
+
+static void fill(cuckoofilter *cf, int flags) {
+	if (cuckoo_init_ex(cf, SLOTS / 4, 4, 500, 16, flags) != true) {
+		fprintf(stderr, "cuckoo_init_ex() failed\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (uint64_t key = 0; key < ELEMENTS; key++) {
+		cuckoo_add(cf, &key, sizeof(key));
+	}
+}
+
+int main() {
+	long         cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	cuckoofilter plain;
+	cuckoofilter concurrent;
+
+	fill(&plain, CUCKOO_BFS);
+	fill(&concurrent, CUCKOO_CONCURRENT);
+
+	printf("%d slots, %.0f%% load, %d lookups per thread, %ld online CPUs\n\n",
+		   SLOTS, cuckoo_load_factor(concurrent), LOOKUPS, cpus);
+	printf("%8s %16s %21s %22s\n", "threads", "plain Mlookup/s", "concurrent Mlookup/s", "with writer Mlookup/s");
+
+	for (int threads = 1; threads <= MAX_THREADS && threads <= cpus * 2; threads *= 2) {
+		double unsynchronized = run(&plain, threads, false);
+		double optimistic     = run(&concurrent, threads, false);
+		double contended      = run(&concurrent, threads, true);
+
+		printf("%8d %16.2f %21.2f %22.2f\n", threads, unsynchronized, optimistic, contended);
+	}
+
+	cuckoo_destroy(plain);
+	cuckoo_destroy(concurrent);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,105 @@
+/* bench_gaussiannb_batch.c -- compare gaussiannb_predict() called once per
+ *                             sample with gaussiannb_predict_batch() over
+ *                             the same row-major matrix, and with the
+ *                             single precision gaussiannbf_predict_batch().
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "gaussiannb.h"
+#include "gaussiannbf.h"
+
+#define CLASSES  8
+#define FEATURES 32
+#define TRAIN    10000
+#define SAMPLES  1000000
+
+static double now_seconds() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main() {
+	gaussiannb  gnb;
+	gaussiannbf gnbf;
+	double     *X             = malloc(SAMPLES * FEATURES * sizeof(double));
+	float      *Xf            = malloc(SAMPLES * FEATURES * sizeof(float));
+	double    **rows          = malloc(TRAIN * sizeof(double *));
+	int        *y             = malloc(TRAIN * sizeof(int));
+	int        *single        = malloc(SAMPLES * sizeof(int));
+	int        *batch         = malloc(SAMPLES * sizeof(int));
+	unsigned    state         = 1;
+	size_t      mismatches    = 0;
+	size_t      disagreements = 0;
+	double      start, single_time, batch_time, float_time;
+
+	if (X == NULL || Xf == NULL || rows == NULL || y == NULL || single == NULL || batch == NULL ||
+		gaussiannb_init(&gnb, CLASSES, FEATURES) != true) {
+		fprintf(stderr, "unable to allocate memory\n");
+		return EXIT_FAILURE;
+	}
+
+	// each class is centered on its own offset
+	for (size_t i = 0; i < SAMPLES; i++) {
+		for (size_t j = 0; j < FEATURES; j++) {
+			state = state * 1103515245 + 12345;
+			X[i * FEATURES + j]  = (double)(i % CLASSES) + (double)(state >> 16) / 65536.0;
+			Xf[i * FEATURES + j] = X[i * FEATURES + j];
+		}
+	}
+
+	for (size_t i = 0; i < TRAIN; i++) {
+		rows[i] = X + i * FEATURES;
+		y[i]    = i % CLASSES;
+	}
+
+	gaussiannb_train(&gnb, rows, y, TRAIN);
+	if (gaussiannbf_from_double(&gnbf, &gnb) != true) {
+		fprintf(stderr, "unable to allocate memory\n");
+		return EXIT_FAILURE;
+	}
+
+	start = now_seconds();
+	for (size_t i = 0; i < SAMPLES; i++) {
+		single[i] = gaussiannb_predict(&gnb, X + i * FEATURES);
+	}
+	single_time = now_seconds() - start;
+
+	start = now_seconds();
+	gaussiannb_predict_batch(&gnb, X, SAMPLES, batch, NULL);
+	batch_time = now_seconds() - start;
+
+	for (size_t i = 0; i < SAMPLES; i++) {
+		mismatches += single[i] != batch[i];
+	}
+
+	start = now_seconds();
+	gaussiannbf_predict_batch(&gnbf, Xf, SAMPLES, single, NULL);
+	float_time = now_seconds() - start;
+
+	for (size_t i = 0; i < SAMPLES; i++) {
+		disagreements += single[i] != batch[i];
+	}
+
+	printf("%d samples, %d classes, %d features\n", SAMPLES, CLASSES, FEATURES);
+	printf("%-8s %8.2f Msamples/s\n", "single", SAMPLES / single_time / 1e6);
+	printf("%-8s %8.2f Msamples/s\n", "batch", SAMPLES / batch_time / 1e6);
+	printf("%-8s %8.2f Msamples/s\n", "float", SAMPLES / float_time / 1e6);
+	printf("%zu mismatched predictions\n", mismatches);
+	printf("%zu float predictions differ from double\n", disagreements);
+
+	gaussiannb_destroy(gnb);
+	gaussiannbf_destroy(gnbf);
+	free(X);
+	free(Xf);
+	free(rows);
+	free(y);
+	free(single);
+	free(batch);
+
+	return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,130 @@
+/* bench_gaussiannb_mahalanobis.c -- compare anomaly scoring with
+ *                                   gaussiannb_mahalanobis_distance(),
+ *                                   called per sample per class, against
+ *                                   gaussiannb_mahalanobis_batch(), a
+ *                                   streaming top-k, and the single
+ *                                   precision
+ *                                   gaussiannbf_mahalanobis_batch() over
+ *                                   the same samples.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+
+#include "gaussiannb.h"
+#include "gaussiannbf.h"
+
+#define CLASSES  8
+#define FEATURES 32
+#define TRAIN    10000
+#define SAMPLES  1000000
+#define CHUNK    65536
+#define TOPK     100
+
+static double now_seconds() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main() {
+	gaussiannb        gnb;
+	gaussiannbf       gnbf;
+	gaussiannbtopk    topk;
+	gaussiannbanomaly top[TOPK];
+	double           *X      = malloc(SAMPLES * FEATURES * sizeof(double));
+	float            *Xf     = malloc(SAMPLES * FEATURES * sizeof(float));
+	float            *scores = malloc(SAMPLES * sizeof(float));
+	double           *single = malloc(SAMPLES * sizeof(double));
+	double           *batch  = malloc(SAMPLES * sizeof(double));
+	int              *y      = malloc(TRAIN * sizeof(int));
+	unsigned          state  = 1;
+	double            worst  = 0.0;
+	double            worstf = 0.0;
+	double            start, single_time, batch_time, topk_time, float_time;
+
+	if (X == NULL || Xf == NULL || scores == NULL || single == NULL || batch == NULL || y == NULL ||
+		gaussiannb_init(&gnb, CLASSES, FEATURES) != true ||
+		gaussiannb_topk_init(&topk, TOPK) != true) {
+		fprintf(stderr, "unable to allocate memory\n");
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < SAMPLES; i++) {
+		for (size_t j = 0; j < FEATURES; j++) {
+			state = state * 1103515245 + 12345;
+			X[i * FEATURES + j]  = (double)(i % CLASSES) + (double)(state >> 16) / 65536.0;
+			Xf[i * FEATURES + j] = X[i * FEATURES + j];
+		}
+	}
+
+	for (size_t i = 0; i < TRAIN; i++) {
+		y[i] = i % CLASSES;
+	}
+
+	gaussiannb_train_contiguous(&gnb, X, y, TRAIN);
+	if (gaussiannbf_from_double(&gnbf, &gnb) != true) {
+		fprintf(stderr, "unable to allocate memory\n");
+		return EXIT_FAILURE;
+	}
+
+	start = now_seconds();
+	for (size_t i = 0; i < SAMPLES; i++) {
+		single[i] = INFINITY;
+		for (size_t c = 0; c < CLASSES; c++) {
+			double d = gaussiannb_mahalanobis_distance(&gnb, X + i * FEATURES, c);
+			single[i] = d < single[i] ? d : single[i];
+		}
+	}
+	single_time = now_seconds() - start;
+
+	start = now_seconds();
+	gaussiannb_mahalanobis_batch(&gnb, X, SAMPLES, batch, NULL);
+	batch_time = now_seconds() - start;
+
+	start = now_seconds();
+	for (size_t i = 0; i < SAMPLES; i += CHUNK) {
+		size_t count = SAMPLES - i < CHUNK ? SAMPLES - i : CHUNK;
+		gaussiannb_mahalanobis_topk(&gnb, X + i * FEATURES, count, &topk);
+	}
+	topk_time = now_seconds() - start;
+
+	start = now_seconds();
+	gaussiannbf_mahalanobis_batch(&gnbf, Xf, SAMPLES, scores, NULL);
+	float_time = now_seconds() - start;
+
+	for (size_t i = 0; i < SAMPLES; i++) {
+		double diff = fabs(single[i] - batch[i]) / single[i];
+		worst = diff > worst ? diff : worst;
+
+		diff   = fabs(single[i] - scores[i]) / single[i];
+		worstf = diff > worstf ? diff : worstf;
+	}
+
+	gaussiannb_topk_results(topk, top);
+
+	printf("%d samples, %d classes, %d features\n", SAMPLES, CLASSES, FEATURES);
+	printf("%-8s %8.2f Msamples/s\n", "single", SAMPLES / single_time / 1e6);
+	printf("%-8s %8.2f Msamples/s\n", "batch", SAMPLES / batch_time / 1e6);
+	printf("%-8s %8.2f Msamples/s, in chunks of %d\n", "top-k", SAMPLES / topk_time / 1e6, CHUNK);
+	printf("%-8s %8.2f Msamples/s\n", "float", SAMPLES / float_time / 1e6);
+	printf("largest relative difference: %g\n", worst);
+	printf("largest relative difference in float: %g\n", worstf);
+	printf("most anomalous: sample %zu at %f\n", top[0].index, top[0].distance);
+
+	gaussiannb_topk_destroy(topk);
+	gaussiannb_destroy(gnb);
+	gaussiannbf_destroy(gnbf);
+	free(X);
+	free(Xf);
+	free(scores);
+	free(single);
+	free(batch);
+	free(y);
+
+	return EXIT_SUCCESS;
+}
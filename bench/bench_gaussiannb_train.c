@@ -0,0 +1,76 @@
+/* bench_gaussiannb_train.c -- compare gaussiannb_train() over an array of
+ *                             row pointers with gaussiannb_train_contiguous()
+ *                             over the same rows in one row-major matrix.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+
+#include "gaussiannb.h"
+
+#define CLASSES  8
+#define FEATURES 32
+#define SAMPLES  1000000
+
+static double now_seconds() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main() {
+	gaussiannb two_pass, one_pass;
+	double    *X     = malloc(SAMPLES * FEATURES * sizeof(double));
+	double   **rows  = malloc(SAMPLES * sizeof(double *));
+	int       *y     = malloc(SAMPLES * sizeof(int));
+	unsigned   state = 1;
+	double     start, two_pass_time, one_pass_time, worst = 0.0;
+
+	if (X == NULL || rows == NULL || y == NULL ||
+		gaussiannb_init(&two_pass, CLASSES, FEATURES) != true ||
+		gaussiannb_init(&one_pass, CLASSES, FEATURES) != true) {
+		fprintf(stderr, "unable to allocate memory\n");
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < SAMPLES; i++) {
+		rows[i] = X + i * FEATURES;
+		y[i]    = i % CLASSES;
+		for (size_t j = 0; j < FEATURES; j++) {
+			state = state * 1103515245 + 12345;
+			X[i * FEATURES + j] = (double)y[i] + (double)(state >> 16) / 65536.0;
+		}
+	}
+
+	start = now_seconds();
+	gaussiannb_train_contiguous(&one_pass, X, y, SAMPLES);
+	one_pass_time = now_seconds() - start;
+
+	start = now_seconds();
+	gaussiannb_train(&two_pass, rows, y, SAMPLES);
+	two_pass_time = now_seconds() - start;
+
+	for (size_t c = 0; c < CLASSES; c++) {
+		for (size_t j = 0; j < FEATURES; j++) {
+			double diff = fabs(one_pass.classes[c].variance[j] - two_pass.classes[c].variance[j]);
+			worst = diff > worst ? diff : worst;
+		}
+	}
+
+	printf("%d samples, %d classes, %d features\n", SAMPLES, CLASSES, FEATURES);
+	printf("%-11s %8.2f Msamples/s\n", "two pass", SAMPLES / two_pass_time / 1e6);
+	printf("%-11s %8.2f Msamples/s\n", "single pass", SAMPLES / one_pass_time / 1e6);
+	printf("largest variance difference: %g\n", worst);
+
+	gaussiannb_destroy(two_pass);
+	gaussiannb_destroy(one_pass);
+	free(X);
+	free(rows);
+	free(y);
+
+	return EXIT_SUCCESS;
+}
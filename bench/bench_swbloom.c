@@ -0,0 +1,90 @@
+/* bench_swbloom.c -- compare memory and throughput of sliding-window bloom
+ *                    filters against time-decaying bloom filters.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "tdbloom.h"
+#include "swbloom.h"
+
+#define ELEMENTS 1000000
+#define WINDOW   3600
+
+static double now_seconds() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, size_t bytes, double add, double lookup, size_t hits) {
+	printf("%-24s %10.2f MB %10.2f Madd/s %10.2f Mlookup/s  (%zu hits)\n",
+		   name,
+		   bytes / (1024.0 * 1024.0),
+		   ELEMENTS / add / 1e6,
+		   ELEMENTS / lookup / 1e6,
+		   hits);
+}
+
+int main() {
+	tdbloom  tdbf;
+	swbloom  swbf;
+	uint64_t key;
+	double   start, add, lookup;
+	size_t   hits;
+
+	printf("%d elements, %d second window\n\n", ELEMENTS, WINDOW);
+
+	if (tdbloom_init(&tdbf, ELEMENTS, 0.01, WINDOW) != TDBF_SUCCESS) {
+		fprintf(stderr, "tdbloom_init() failed\n");
+		return EXIT_FAILURE;
+	}
+
+	start = now_seconds();
+	for (key = 0; key < ELEMENTS; key++) {
+		tdbloom_add(&tdbf, &key, sizeof(key));
+	}
+	add = now_seconds() - start;
+
+	hits  = 0;
+	start = now_seconds();
+	for (key = 0; key < ELEMENTS; key++) {
+		hits += tdbloom_lookup(tdbf, &key, sizeof(key));
+	}
+	lookup = now_seconds() - start;
+
+	report("tdbloom", tdbf.filter_size, add, lookup, hits);
+	tdbloom_destroy(tdbf);
+
+	size_t generations[] = { 2, 4, 8 };
+	for (size_t i = 0; i < sizeof(generations) / sizeof(generations[0]); i++) {
+		char name[32];
+
+		if (swbloom_init(&swbf, ELEMENTS, 0.01, WINDOW, generations[i]) != SWBF_SUCCESS) {
+			fprintf(stderr, "swbloom_init() failed\n");
+			return EXIT_FAILURE;
+		}
+
+		start = now_seconds();
+		for (key = 0; key < ELEMENTS; key++) {
+			swbloom_add(&swbf, &key, sizeof(key));
+		}
+		add = now_seconds() - start;
+
+		hits  = 0;
+		start = now_seconds();
+		for (key = 0; key < ELEMENTS; key++) {
+			hits += swbloom_lookup(swbf, &key, sizeof(key));
+		}
+		lookup = now_seconds() - start;
+
+		snprintf(name, sizeof(name), "swbloom (%zu generations)", generations[i]);
+		report(name, swbloom_memory(swbf), add, lookup, hits);
+		swbloom_destroy(swbf);
+	}
+
+	return EXIT_SUCCESS;
+}
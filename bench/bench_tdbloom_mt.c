@@ -0,0 +1,95 @@
+/* bench_tdbloom_mt.c -- measure tdbloom ingest throughput from multiple
+ *                       threads, comparing a filter shared behind a mutex
+ *                       to a TDBLOOM_CONCURRENT filter shared without one.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "tdbloom.h"
+
+#define ELEMENTS   4000000
+#define MAX_THREADS 64
+
+typedef struct {
+	tdbloom         *tdbf;
+	pthread_mutex_t *lock;
+	uint64_t         first;
+	uint64_t         count;
+} worker_args;
+
+static double now_seconds() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *worker(void *arg) {
+	worker_args *args = arg;
+
+	for (uint64_t key = args->first; key < args->first + args->count; key++) {
+		if (args->lock != NULL) {
+			pthread_mutex_lock(args->lock);
+			tdbloom_add(args->tdbf, &key, sizeof(key));
+			pthread_mutex_unlock(args->lock);
+		} else {
+			tdbloom_add(args->tdbf, &key, sizeof(key));
+		}
+	}
+
+	return NULL;
+}
+
+static double run(int threads, bool use_mutex) {
+	tdbloom         tdbf;
+	pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+	pthread_t       tids[MAX_THREADS];
+	worker_args     args[MAX_THREADS];
+	double          start, elapsed;
+
+	if (tdbloom_init_ex(&tdbf, ELEMENTS, 0.01, 3600, TDBLOOM_RESOLUTION_DEFAULT,
+						use_mutex ? 0 : TDBLOOM_CONCURRENT) != TDBF_SUCCESS) {
+		fprintf(stderr, "tdbloom_init_ex() failed\n");
+		exit(EXIT_FAILURE);
+	}
+
+	start = now_seconds();
+	for (int t = 0; t < threads; t++) {
+		args[t].tdbf  = &tdbf;
+		args[t].lock  = use_mutex ? &lock : NULL;
+		args[t].first = (uint64_t)t * (ELEMENTS / threads);
+		args[t].count = ELEMENTS / threads;
+		pthread_create(&tids[t], NULL, worker, &args[t]);
+	}
+
+	for (int t = 0; t < threads; t++) {
+		pthread_join(tids[t], NULL);
+	}
+	elapsed = now_seconds() - start;
+
+	tdbloom_destroy(tdbf);
+
+	return ELEMENTS / elapsed / 1e6;
+}
+
+int main() {
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	printf("%d elements, %ld online CPUs\n\n", ELEMENTS, cpus);
+	printf("%8s %16s %16s\n", "threads", "mutex Madd/s", "atomic Madd/s");
+
+	for (int threads = 1; threads <= MAX_THREADS && threads <= cpus * 2; threads *= 2) {
+		double locked     = run(threads, true);
+		double concurrent = run(threads, false);
+
+		printf("%8d %16.2f %16.2f\n", threads, locked, concurrent);
+	}
+
+	return EXIT_SUCCESS;
+}
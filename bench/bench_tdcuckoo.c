@@ -0,0 +1,102 @@
+/* bench_tdcuckoo.c -- compare memory use and add/lookup throughput of
+ *                     time-decaying bloom and cuckoo filters sized for the
+ *                     same number of elements and false positive rate.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "tdbloom.h"
+#include "tdcuckoo.h"
+
+#define ELEMENTS 1000000
+#define TIMEOUT  3600
+
+static double now_seconds() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, size_t bytes, double add, double hit, double miss) {
+	printf("%-10s %10zu bytes %6.2f bytes/element %8.2f Madds/s %8.2f Mhits/s %8.2f Mmisses/s\n",
+		   name, bytes, (double)bytes / ELEMENTS,
+		   ELEMENTS / add / 1e6, ELEMENTS / hit / 1e6, ELEMENTS / miss / 1e6);
+}
+
+static void run(float accuracy) {
+	tdbloom  tdbf;
+	tdcuckoo tdcf;
+	uint64_t key;
+	size_t   found = 0;
+	double   start, add, hit, miss;
+
+	printf("accuracy %g, %d elements\n", accuracy, ELEMENTS);
+
+	if (tdbloom_init(&tdbf, ELEMENTS, accuracy, TIMEOUT) != TDBF_SUCCESS ||
+		tdcuckoo_init(&tdcf, ELEMENTS, accuracy, TIMEOUT) != TDCF_SUCCESS) {
+		fprintf(stderr, "unable to initialize filters\n");
+		exit(EXIT_FAILURE);
+	}
+
+	start = now_seconds();
+	for (key = 0; key < ELEMENTS; key++) {
+		tdbloom_add(&tdbf, &key, sizeof(key));
+	}
+	add = now_seconds() - start;
+
+	start = now_seconds();
+	for (key = 0; key < ELEMENTS; key++) {
+		found += tdbloom_lookup(tdbf, &key, sizeof(key));
+	}
+	hit = now_seconds() - start;
+
+	start = now_seconds();
+	for (key = ELEMENTS; key < 2 * ELEMENTS; key++) {
+		found += tdbloom_lookup(tdbf, &key, sizeof(key));
+	}
+	miss = now_seconds() - start;
+
+	report("tdbloom", tdbf.filter_size, add, hit, miss);
+
+	start = now_seconds();
+	for (key = 0; key < ELEMENTS; key++) {
+		tdcuckoo_add(&tdcf, &key, sizeof(key));
+	}
+	add = now_seconds() - start;
+
+	start = now_seconds();
+	for (key = 0; key < ELEMENTS; key++) {
+		found += tdcuckoo_lookup(tdcf, &key, sizeof(key));
+	}
+	hit = now_seconds() - start;
+
+	start = now_seconds();
+	for (key = ELEMENTS; key < 2 * ELEMENTS; key++) {
+		found += tdcuckoo_lookup(tdcf, &key, sizeof(key));
+	}
+	miss = now_seconds() - start;
+
+	report("tdcuckoo", tdcf.filter_size, add, hit, miss);
+
+	// keep lookups from being optimized away
+	if (found == 0) {
+		printf("no elements found\n");
+	}
+
+	tdbloom_destroy(tdbf);
+	tdcuckoo_destroy(tdcf);
+}
+
+int main() {
+	float accuracies[] = { 0.01, 0.001, 0.0002 };
+
+	for (size_t i = 0; i < sizeof(accuracies) / sizeof(accuracies[0]); i++) {
+		run(accuracies[i]);
+	}
+
+	return EXIT_SUCCESS;
+}
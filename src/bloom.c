@@ -38,7 +38,7 @@ static size_t ideal_size(const size_t expected, const float accuracy) {
 bool bloom_init(bloomfilter *bf, const size_t expected, const float accuracy) {
 	bf->size        = ideal_size(expected, accuracy);
 	bf->hashcount   = (bf->size / expected) * log(2);
-	bf->bitmap_size = ceil(bf->size / 8);
+	bf->bitmap_size = (bf->size + 7) / 8;
 	bf->expected    = expected;
 	bf->accuracy    = accuracy;
 	bf->insertions  = 0;
@@ -230,7 +230,7 @@ bool bloom_load(bloomfilter *bf, const char *path) {
 	fread(bf, sizeof(bloomfilter), 1, fp);
 
 	// basic sanity check. should fail if filter isn't valid
-	if (ceil(bf->size / 8) != bf->bitmap_size ||
+	if ((bf->size + 7) / 8 != bf->bitmap_size ||
 		sizeof(bloomfilter) + bf->bitmap_size != sb.st_size) {
 		fclose(fp);
 		return false;
@@ -13,6 +13,16 @@
 #include "mmh3.h"
 #include "cbloom.h"
 
+const char *cbloom_errors[] = {
+	"Success",
+	"Out of memory",
+	"Invalid counter size",
+	"Unable to open file",
+	"Unable to write to file",
+	"Unable to read file",
+	"fstat() failure",
+	"Invalid file format"
+};
 
 /* ideal_size() -- calculate ideal size of a filter
  *
@@ -22,16 +22,10 @@ typedef enum {
 	CBF_ERRORCOUNT
 } cbloom_error_t;
 
-const char *cbloom_errors[] = {
-	"Success",
-	"Out of memory",
-	"Invalid counter size",
-	"Unable to open file",
-	"Unable to write to file",
-	"Unable to read file",
-	"fstat() failure",
-	"Invalid file format"
-};
+/* cbloom_errors -- human-readable error messages. defined in cbloom.c so
+ *                  other modules can include this header for counter_size.
+ */
+extern const char *cbloom_errors[];
 
 /* counter_size -- used for setting appropriately-sized counters, which can
                    result in a reduced memory footprint if smaller counts are
@@ -0,0 +1,348 @@
+/* ccuckoo.c
+ *
+ * Counting cuckoo filter. Each 16 bit entry packs a 12 bit fingerprint with
+ * a 4 bit counter, so repeated adds of an element increment its entry
+ * rather than taking another slot. When an entry's counter is full, another
+ * entry with the same fingerprint is started (fingerprint chaining), so an
+ * element's count is the sum over the matching entries in its two buckets.
+ *
+ * At a 95% load this costs about 2.1 bytes per distinct element, with a
+ * false positive rate of about 2 * bucket_size / 4096. A counting bloom
+ * filter with 8 bit counters needs about 9.6 bytes per element for a 1%
+ * false positive rate.
+ */
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ccuckoo.h"
+
+/* entry_fingerprint(), entry_count() -- unpack an entry
+ */
+static inline uint16_t entry_fingerprint(uint16_t entry) {
+	return entry >> CCUCKOO_COUNTER_BITS;
+}
+
+static inline uint16_t entry_count(uint16_t entry) {
+	return entry & CCUCKOO_COUNTER_MAX;
+}
+
+/* buckets, stash, and evictions come from cuckoocore.h, on 16 bit entries.
+ * a slot is vacant only when it's empty, and the stash never drops entries.
+ */
+#define CORE_ENTRY                      uint16_t
+#define CORE_FILTER                     ccuckoofilter
+#define CORE_STASH_SIZE                 CCUCKOO_STASH_SIZE
+#define CORE_MAX_KICKS(filter)          ((filter)->max_kicks)
+#define CORE_FINGERPRINT(entry)         entry_fingerprint(entry)
+#define CORE_VACANT(filter, entry, now) ((void)(now), (entry) == 0)
+#define CORE_STORED(filter)             ((filter)->used += 1)
+
+#include "cuckoocore.h"
+
+/* ccuckoo_init() - initialize a counting cuckoo filter
+ *
+ * Args:
+ *     ccf         - filter to initialize
+ *     num_buckets - number of buckets
+ *     bucket_size - number of entries per bucket: 2, 4, or 8
+ *     max_kicks   - maximum number of evictions attempted per insert
+ *
+ * Returns:
+ *     true on success
+ *     false if parameters are invalid or unable to allocate memory
+ */
+bool ccuckoo_init(ccuckoofilter *ccf, size_t num_buckets, size_t bucket_size, size_t max_kicks) {
+	if (num_buckets == 0 || (bucket_size != 2 && bucket_size != 4 && bucket_size != 8)) {
+		return false;
+	}
+
+	ccf->num_buckets = num_buckets;
+	ccf->bucket_size = bucket_size;
+	ccf->max_kicks   = max_kicks;
+	ccf->used        = 0;
+	ccf->prng_state  = seed_xorshift32();
+	ccf->stash_count = 0;
+
+	ccf->entries = calloc(num_buckets * bucket_size, sizeof(uint16_t));
+	if (ccf->entries == NULL) {
+		return false;
+	}
+
+	return true;
+}
+
+/* ccuckoo_destroy() - free memory allocated by ccuckoo_init()
+ *
+ * Args:
+ *     ccf - filter to destroy
+ *
+ * Returns:
+ *     Nothing
+ */
+void ccuckoo_destroy(ccuckoofilter ccf) {
+	free(ccf.entries);
+}
+
+/* ccuckoo_memory() - number of bytes used by a filter's buckets
+ *
+ * Args:
+ *     ccf - filter to check
+ *
+ * Returns:
+ *     size of all buckets in bytes
+ */
+size_t ccuckoo_memory(ccuckoofilter ccf) {
+	return ccf.num_buckets * ccf.bucket_size * sizeof(uint16_t);
+}
+
+/* ccuckoo_load_factor() - percentage of entries in use
+ *
+ * Args:
+ *     ccf - filter to check
+ *
+ * Returns:
+ *     load factor, 0.0 through 100.0
+ */
+double ccuckoo_load_factor(ccuckoofilter ccf) {
+	size_t capacity = ccf.num_buckets * ccf.bucket_size;
+	return ((double)ccf.used / (double)capacity) * 100.0;
+}
+
+/* element_hash(), alt_index() - a filter's view of cuckoo_hash() and
+ *     cuckoo_alt_index(), so elements hash as they do in cuckoo.c
+ */
+static void element_hash(const ccuckoofilter *ccf, void *key, size_t len, size_t *i1, uint16_t *fingerprint) {
+	cuckoo_hash(key, len, ccf->num_buckets, CCUCKOO_FINGERPRINT_BITS, i1, fingerprint);
+}
+
+static size_t alt_index(const ccuckoofilter *ccf, size_t index, uint16_t fingerprint) {
+	return cuckoo_alt_index(ccf->num_buckets, index, fingerprint);
+}
+
+/* find_entry() - find an entry holding 'fingerprint' in either bucket, or
+ *                the stash. when 'below_max' is set, only entries whose
+ *                counters aren't full are considered.
+ *
+ * Returns:
+ *     pointer to the entry, or NULL if there is none
+ */
+static uint16_t *find_entry(ccuckoofilter *ccf, size_t i1, size_t i2, uint16_t fingerprint, bool below_max) {
+	size_t buckets[2] = { i1, i2 };
+
+	for (int i = 0; i < ((i1 == i2) ? 1 : 2); i++) {
+		uint16_t *bucket = ccf->entries + buckets[i] * ccf->bucket_size;
+
+		for (size_t b = 0; b < ccf->bucket_size; b++) {
+			if (bucket[b] != 0 && entry_fingerprint(bucket[b]) == fingerprint &&
+				(!below_max || entry_count(bucket[b]) < CCUCKOO_COUNTER_MAX)) {
+				return &bucket[b];
+			}
+		}
+	}
+
+	for (size_t s = 0; s < ccf->stash_count; s++) {
+		uint16_t *entry = &ccf->stash[s].entry;
+
+		if ((ccf->stash[s].index == i1 || ccf->stash[s].index == i2) &&
+			entry_fingerprint(*entry) == fingerprint &&
+			(!below_max || entry_count(*entry) < CCUCKOO_COUNTER_MAX)) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+/* ccuckoo_add() - count an occurrence of an element
+ *
+ * Args:
+ *     ccf - filter to add element to
+ *     key - element to add
+ *     len - length of element in bytes
+ *
+ * Returns:
+ *     true if element was counted
+ *     false if a new entry was needed and no room could be made. the filter
+ *           is left as it was.
+ */
+bool ccuckoo_add(ccuckoofilter *ccf, void *key, size_t len) {
+	size_t   i1;
+	uint16_t fingerprint;
+
+	if (ccf->stash_count > 0) {
+		core_stash_drain(ccf, 0);
+	}
+
+	element_hash(ccf, key, len, &i1, &fingerprint);
+	size_t    i2    = alt_index(ccf, i1, fingerprint);
+	uint16_t *entry = find_entry(ccf, i1, i2, fingerprint, true);
+
+	if (entry != NULL) {
+		*entry += 1;
+		return true;
+	}
+
+	return core_insert(ccf, i1, i2, (fingerprint << CCUCKOO_COUNTER_BITS) | 1, 0);
+}
+
+/* ccuckoo_add_string() - helper function to add string elements
+ *
+ * Args:
+ *     ccf - filter to add element to
+ *     key - string to add
+ *
+ * Returns:
+ *     true if element was counted
+ *     false if no room could be made
+ */
+bool ccuckoo_add_string(ccuckoofilter *ccf, char *key) {
+	return ccuckoo_add(ccf, key, strlen(key));
+}
+
+/* ccuckoo_count() - approximate number of times an element was added. this
+ *                   may overcount if another element shares its fingerprint
+ *                   and a bucket.
+ *
+ * Args:
+ *     ccf - filter to use
+ *     key - element to count
+ *     len - length of element in bytes
+ *
+ * Returns:
+ *     approximate count of 'key' in the filter
+ */
+size_t ccuckoo_count(ccuckoofilter ccf, void *key, size_t len) {
+	size_t   i1;
+	uint16_t fingerprint;
+	size_t   count = 0;
+
+	element_hash(&ccf, key, len, &i1, &fingerprint);
+	size_t   i2 = alt_index(&ccf, i1, fingerprint);
+	size_t   buckets[2] = { i1, i2 };
+
+	for (int i = 0; i < ((i1 == i2) ? 1 : 2); i++) {
+		uint16_t *bucket = ccf.entries + buckets[i] * ccf.bucket_size;
+
+		for (size_t b = 0; b < ccf.bucket_size; b++) {
+			if (bucket[b] != 0 && entry_fingerprint(bucket[b]) == fingerprint) {
+				count += entry_count(bucket[b]);
+			}
+		}
+	}
+
+	for (size_t s = 0; s < ccf.stash_count; s++) {
+		if ((ccf.stash[s].index == i1 || ccf.stash[s].index == i2) &&
+			entry_fingerprint(ccf.stash[s].entry) == fingerprint) {
+			count += entry_count(ccf.stash[s].entry);
+		}
+	}
+
+	return count;
+}
+
+/* ccuckoo_count_string() - helper function to count string elements
+ *
+ * Args:
+ *     ccf - filter to use
+ *     key - string to count
+ *
+ * Returns:
+ *     approximate count of 'key' in the filter
+ */
+size_t ccuckoo_count_string(ccuckoofilter ccf, char *key) {
+	return ccuckoo_count(ccf, key, strlen(key));
+}
+
+/* ccuckoo_lookup() - check if an element is likely in the filter
+ *
+ * Args:
+ *     ccf - filter to use
+ *     key - element to look up
+ *     len - length of element in bytes
+ *
+ * Returns:
+ *     true if element is probably in the filter
+ *     false if element is definitely not in the filter
+ */
+bool ccuckoo_lookup(ccuckoofilter ccf, void *key, size_t len) {
+	size_t   i1;
+	uint16_t fingerprint;
+
+	element_hash(&ccf, key, len, &i1, &fingerprint);
+
+	return find_entry(&ccf, i1, alt_index(&ccf, i1, fingerprint), fingerprint, false) != NULL;
+}
+
+/* ccuckoo_lookup_string() - helper function to look up string elements
+ *
+ * Args:
+ *     ccf - filter to use
+ *     key - string to look up
+ *
+ * Returns:
+ *     true if element is probably in the filter
+ *     false if element is definitely not in the filter
+ */
+bool ccuckoo_lookup_string(ccuckoofilter ccf, char *key) {
+	return ccuckoo_lookup(ccf, key, strlen(key));
+}
+
+/* ccuckoo_remove() - remove one occurrence of an element
+ *
+ * Args:
+ *     ccf - filter to remove element from
+ *     key - element to remove
+ *     len - length of element in bytes
+ *
+ * Returns:
+ *     true if an occurrence was removed
+ *     false if element was not found
+ */
+bool ccuckoo_remove(ccuckoofilter *ccf, void *key, size_t len) {
+	size_t   i1;
+	uint16_t fingerprint;
+
+	element_hash(ccf, key, len, &i1, &fingerprint);
+	uint16_t *entry = find_entry(ccf, i1, alt_index(ccf, i1, fingerprint), fingerprint, false);
+
+	if (entry == NULL) {
+		return false;
+	}
+
+	*entry -= 1;
+	if (entry_count(*entry) != 0) {
+		return true;
+	}
+
+	// the entry is empty; free its slot
+	if (entry >= ccf->entries && entry < ccf->entries + ccf->num_buckets * ccf->bucket_size) {
+		*entry     = 0;
+		ccf->used -= 1;
+
+		if (ccf->stash_count > 0) {
+			core_stash_drain(ccf, 0);
+		}
+	} else {
+		ccuckoovictim *victim = (ccuckoovictim *)((uint8_t *)entry - offsetof(ccuckoovictim, entry));
+		*victim = ccf->stash[--ccf->stash_count];
+	}
+
+	return true;
+}
+
+/* ccuckoo_remove_string() - helper function to remove string elements
+ *
+ * Args:
+ *     ccf - filter to remove element from
+ *     key - string to remove
+ *
+ * Returns:
+ *     true if an occurrence was removed
+ *     false if element was not found
+ */
+bool ccuckoo_remove_string(ccuckoofilter *ccf, char *key) {
+	return ccuckoo_remove(ccf, key, strlen(key));
+}
@@ -0,0 +1,56 @@
+/* ccuckoo.h
+ */
+#ifndef CCUCKOO_H
+#define CCUCKOO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* CCUCKOO_FINGERPRINT_BITS, CCUCKOO_COUNTER_BITS -- each 16 bit entry holds
+ *     a 12 bit fingerprint and a 4 bit counter
+ */
+#define CCUCKOO_FINGERPRINT_BITS 12
+#define CCUCKOO_COUNTER_BITS     4
+#define CCUCKOO_COUNTER_MAX      ((1 << CCUCKOO_COUNTER_BITS) - 1)
+
+/* CCUCKOO_STASH_SIZE -- number of entries the victim stash can hold
+ */
+#define CCUCKOO_STASH_SIZE 8
+
+/* ccuckoovictim -- an entry that couldn't be placed in a bucket, and one of
+ *                  the two buckets it belongs in.
+ */
+typedef struct {
+	size_t        index;
+	uint16_t      entry;
+} ccuckoovictim;
+
+/* ccuckoofilter -- counting cuckoo filter structure
+ */
+typedef struct {
+	uint16_t      *entries;          /* fingerprint << 4 | counter, 0 if empty */
+	size_t         num_buckets;
+	size_t         bucket_size;      /* 2, 4, or 8 */
+	size_t         max_kicks;
+	size_t         used;             /* number of entries in buckets */
+	uint32_t       prng_state;       /* xorshift state */
+	size_t         stash_count;      /* number of entries in stash */
+	ccuckoovictim  stash[CCUCKOO_STASH_SIZE]; /* entries with no room in their buckets */
+} ccuckoofilter;
+
+/* function definitions
+ */
+bool   ccuckoo_init(ccuckoofilter *, size_t, size_t, size_t);
+void   ccuckoo_destroy(ccuckoofilter);
+size_t ccuckoo_memory(ccuckoofilter);
+double ccuckoo_load_factor(ccuckoofilter);
+bool   ccuckoo_add(ccuckoofilter *, void *, size_t);
+bool   ccuckoo_add_string(ccuckoofilter *, char *);
+size_t ccuckoo_count(ccuckoofilter, void *, size_t);
+size_t ccuckoo_count_string(ccuckoofilter, char *);
+bool   ccuckoo_lookup(ccuckoofilter, void *, size_t);
+bool   ccuckoo_lookup_string(ccuckoofilter, char *);
+bool   ccuckoo_remove(ccuckoofilter *, void *, size_t);
+bool   ccuckoo_remove_string(ccuckoofilter *, char *);
+
+#endif /* CCUCKOO_H */
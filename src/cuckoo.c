@@ -1,77 +1,528 @@
 /* cuckoo.c
- *
- * TODO: counting cuckoo filter
- * TODO: time-decaying cuckoo filter
- * TODO: function documentation
  */
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdint.h>
-#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 
-#include "cuckoo.h"
-#include "mmh3.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
+#if defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CUCKOO_X86
+#endif
 
-// TODO: move to .c/.h so xorshift32 can be used elsewhere
-// TODO: xorshift64
-static uint32_t seed_xorshift32() {
-	uint32_t        seed;
-	struct timespec ts;
+#include "cuckoo.h"
+#include "cuckoocore.h"
+#include "xorshift.h"
 
-	clock_gettime(CLOCK_MONOTONIC, &ts);
+/* CUCKOO_PATH_RETRIES -- number of times a CUCKOO_CONCURRENT insert looks
+ *                        for an eviction path before giving up, when other
+ *                        threads keep changing the path.
+ */
+#define CUCKOO_PATH_RETRIES 16
 
-	seed = (uint32_t)(ts.tv_sec ^ ts.tv_nsec);
+/* CUCKOO_BATCH -- number of elements hashed and prefetched at a time by the
+ *                 batch functions.
+ */
+#define CUCKOO_BATCH 16
 
-	return seed;
+/* bucket_bytes() - size of a bucket of packed fingerprints, in bytes
+ */
+static size_t bucket_bytes(size_t bucket_size, size_t fingerprint_bits) {
+	return bucket_size * fingerprint_bits / 8;
 }
 
-static uint32_t xorshift32(uint32_t *state) {
-	uint32_t x = *state;
-	x ^= x << 13;
-	x ^= x >> 17;
-	x ^= x << 5;
-	*state = x;
+/* valid_geometry() - check that bucket size and fingerprint width are
+ *                    supported
+ */
+static bool valid_geometry(size_t bucket_size, size_t fingerprint_bits) {
+	if (bucket_size != 2 && bucket_size != 4 && bucket_size != 8) {
+		return false;
+	}
+
+	return fingerprint_bits == 8 || fingerprint_bits == 12 || fingerprint_bits == 16;
+}
 
-	return x;
+/* stripe_count() - number of version counters used with CUCKOO_CONCURRENT
+ */
+static size_t stripe_count(size_t num_buckets) {
+	return (num_buckets < CUCKOO_STRIPES) ? num_buckets : CUCKOO_STRIPES;
 }
 
+/* cuckoo_init() - initialize a cuckoo filter with 16 bit fingerprints
+ *
+ * Args:
+ *     cf          - filter to initialize
+ *     num_buckets - number of buckets
+ *     bucket_size - number of fingerprints per bucket: 2, 4, or 8
+ *     max_kicks   - maximum number of evictions attempted per insert
+ *
+ * Returns:
+ *     true on success
+ *     false if parameters are invalid or unable to allocate memory
+ */
 bool cuckoo_init(cuckoofilter *cf, size_t num_buckets, size_t bucket_size,
 				 size_t max_kicks) {
+	return cuckoo_init_ex(cf, num_buckets, bucket_size, max_kicks, CUCKOO_FINGERPRINT_DEFAULT, 0);
+}
+
+/* cuckoo_init_ex() - initialize a cuckoo filter with a given fingerprint
+ *                    width
+ *
+ * Narrower fingerprints use less memory at the cost of a higher false
+ * positive rate: roughly 2 * bucket_size / 2^fingerprint_bits.
+ *
+ * Args:
+ *     cf               - filter to initialize
+ *     num_buckets      - number of buckets
+ *     bucket_size      - number of fingerprints per bucket: 2, 4, or 8
+ *     max_kicks        - maximum number of evictions attempted per insert.
+ *                        with CUCKOO_BFS, the maximum number of buckets
+ *                        searched for an eviction path.
+ *     fingerprint_bits - width of fingerprints: 8, 12, or 16
+ *     flags            - 0, or CUCKOO_BFS to find the shortest eviction
+ *                        path before moving anything, rather than evicting
+ *                        at random. this bounds insert latency and lets
+ *                        the filter reach a higher load.
+ *                        CUCKOO_CONCURRENT to allow threads to add, look
+ *                        up, and remove concurrently. this implies
+ *                        CUCKOO_BFS, and doesn't use the stash: a failed
+ *                        insert leaves the filter as it was. merging,
+ *                        saving, and loading still need exclusive access.
+ *
+ * Returns:
+ *     true on success
+ *     false if parameters are invalid or unable to allocate memory
+ */
+bool cuckoo_init_ex(cuckoofilter *cf, size_t num_buckets, size_t bucket_size,
+					size_t max_kicks, size_t fingerprint_bits, int flags) {
+	if (num_buckets == 0 || !valid_geometry(bucket_size, fingerprint_bits)) {
+		return false;
+	}
+
 	cf->num_buckets      = num_buckets;
 	cf->bucket_size      = bucket_size;
+	cf->fingerprint_bits = fingerprint_bits;
+	cf->bucket_bytes     = bucket_bytes(bucket_size, fingerprint_bits);
 	cf->max_kicks        = max_kicks;
+	cf->flags            = flags;
 	cf->prng_state       = seed_xorshift32();
 	cf->total_insertions = 0;
 	cf->evictions        = 0;
+	cf->stash_count      = 0;
+	cf->stripes          = 0;
+	cf->versions         = NULL;
+	cf->mapping          = NULL;
+	cf->mapping_size     = 0;
+	cf->mapping_flags    = 0;
 
-	cf->buckets          = (cuckoobucket *)calloc(num_buckets * bucket_size, sizeof(cuckoobucket));
+	cf->buckets          = calloc(num_buckets, cf->bucket_bytes);
 	if (cf->buckets == NULL) {
 		return false;
 	}
 
-	cf->bucket_insertions = calloc(num_buckets, sizeof(size_t));
-	if (cf->bucket_insertions == NULL) {
-		free(cf->buckets);
-		return false;
+	if (flags & CUCKOO_CONCURRENT) {
+		cf->stripes  = stripe_count(num_buckets);
+		cf->versions = calloc(cf->stripes, sizeof(uint32_t));
+		if (cf->versions == NULL) {
+			free(cf->buckets);
+			return false;
+		}
 	}
 
 	return true;
 }
 
+/* cuckoo_destroy() - free memory allocated by cuckoo_init() or
+ *                    cuckoo_load(), or unmap a filter mapped by cuckoo_map()
+ *
+ * Args:
+ *     cf - filter to destroy
+ *
+ * Returns:
+ *     Nothing
+ */
 void cuckoo_destroy(cuckoofilter cf) {
-	free(cf.bucket_insertions);
-	free(cf.buckets);
+	if (cf.mapping != NULL) {
+		munmap(cf.mapping, cf.mapping_size);
+	} else {
+		free(cf.buckets);
+	}
+
+	free(cf.versions);
+}
+
+/* cuckoo_memory() - number of bytes used by a filter's buckets
+ *
+ * Args:
+ *     cf - filter to check
+ *
+ * Returns:
+ *     size of all buckets in bytes
+ */
+size_t cuckoo_memory(cuckoofilter cf) {
+	return cf.num_buckets * cf.bucket_bytes;
+}
+
+/* get_fingerprint(), set_fingerprint() -- helper functions used to handle
+ *     different fingerprint widths. 12 bit fingerprints are packed two per
+ *     three bytes; bucket sizes are even, so pairs never span buckets.
+ */
+static inline uint16_t get_fingerprint(const cuckoofilter *cf, size_t bucket, size_t slot) {
+	const uint8_t *p;
+
+	switch (cf->fingerprint_bits) {
+	case 8:
+		return cf->buckets[bucket * cf->bucket_size + slot];
+	case 12:
+		p = cf->buckets + bucket * cf->bucket_bytes + (slot / 2) * 3;
+		if (slot % 2 == 0) {
+			return p[0] | ((p[1] & 0x0f) << 8);
+		}
+		return (p[1] >> 4) | (p[2] << 4);
+	case 16:
+		return ((uint16_t *)cf->buckets)[bucket * cf->bucket_size + slot];
+	default:
+		return 0; // shouldn't get here
+	}
+}
+
+static inline void set_fingerprint(cuckoofilter *cf, size_t bucket, size_t slot, uint16_t fingerprint) {
+	uint8_t *p;
+
+	switch (cf->fingerprint_bits) {
+	case 8:
+		cf->buckets[bucket * cf->bucket_size + slot] = fingerprint;
+		break;
+	case 12:
+		p = cf->buckets + bucket * cf->bucket_bytes + (slot / 2) * 3;
+		if (slot % 2 == 0) {
+			p[0] = fingerprint & 0xff;
+			p[1] = (p[1] & 0xf0) | ((fingerprint >> 8) & 0x0f);
+		} else {
+			p[1] = (p[1] & 0x0f) | ((fingerprint & 0x0f) << 4);
+			p[2] = fingerprint >> 4;
+		}
+		break;
+	case 16:
+		((uint16_t *)cf->buckets)[bucket * cf->bucket_size + slot] = fingerprint;
+		break;
+	default:
+		return; // shouldn't get here
+	}
+}
+
+/* bucket_match_scalar() - bitmask of slots in a bucket holding 'fingerprint'
+ */
+static unsigned bucket_match_scalar(const cuckoofilter *cf, size_t bucket, uint16_t fingerprint) {
+	unsigned mask = 0;
+
+	for (size_t b = 0; b < cf->bucket_size; b++) {
+		if (get_fingerprint(cf, bucket, b) == fingerprint) {
+			mask |= 1U << b;
+		}
+	}
+
+	return mask;
+}
+
+#ifdef __SSE2__
+/* load_bucket() - load a bucket of 8 or 16 bit fingerprints into the low
+ *                 bytes of a register. the remaining bytes are zero.
+ */
+static inline __m128i load_bucket(const cuckoofilter *cf, size_t bucket) {
+	const uint8_t *p = cf->buckets + bucket * cf->bucket_bytes;
+	uint32_t       v = 0;
+
+	switch (cf->bucket_bytes) {
+	case 16:
+		return _mm_loadu_si128((const __m128i *)p);
+	case 8:
+		return _mm_loadl_epi64((const __m128i *)p);
+	default: // 2 or 4 bytes
+		memcpy(&v, p, cf->bucket_bytes);
+		return _mm_cvtsi32_si128(v);
+	}
+}
+
+/* match_mask() - compare each lane of 'bucket' against 'fingerprint',
+ *                returning one bit per lane.
+ */
+static inline unsigned match_mask(const cuckoofilter *cf, __m128i bucket, uint16_t fingerprint) {
+	if (cf->fingerprint_bits == 8) {
+		return _mm_movemask_epi8(_mm_cmpeq_epi8(bucket, _mm_set1_epi8(fingerprint)));
+	}
+
+	// narrow 16 bit lane results to bytes so each slot is one mask bit
+	__m128i eq = _mm_cmpeq_epi16(bucket, _mm_set1_epi16(fingerprint));
+
+	return _mm_movemask_epi8(_mm_packs_epi16(eq, _mm_setzero_si128()));
+}
+
+static unsigned bucket_match_sse2(const cuckoofilter *cf, size_t bucket, uint16_t fingerprint) {
+	// lanes past the end of the bucket are zero, and would match empty slots
+	return match_mask(cf, load_bucket(cf, bucket), fingerprint) & ((1U << cf->bucket_size) - 1);
+}
+
+/* pair_contains_sse2() - check both candidate buckets at once. buckets of
+ *                        up to 8 bytes share a register; fingerprints are
+ *                        never 0, so zeroed lanes can't match.
+ */
+static bool pair_contains_sse2(const cuckoofilter *cf, size_t i1, size_t i2, uint16_t fingerprint) {
+	if (cf->bucket_bytes == 16) {
+		return (match_mask(cf, load_bucket(cf, i1), fingerprint) |
+				match_mask(cf, load_bucket(cf, i2), fingerprint)) != 0;
+	}
+
+	__m128i both = _mm_unpacklo_epi64(load_bucket(cf, i1), load_bucket(cf, i2));
+
+	return match_mask(cf, both, fingerprint) != 0;
+}
+#endif /* __SSE2__ */
+
+#ifdef CUCKOO_X86
+/* pair_contains_avx2() - check two buckets of eight 16 bit fingerprints in
+ *                        one 256 bit compare
+ */
+__attribute__((target("avx2")))
+static bool pair_contains_avx2(const cuckoofilter *cf, size_t i1, size_t i2, uint16_t fingerprint) {
+	const __m128i *p1   = (const __m128i *)(cf->buckets + i1 * cf->bucket_bytes);
+	const __m128i *p2   = (const __m128i *)(cf->buckets + i2 * cf->bucket_bytes);
+	__m256i        both = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(p1)), _mm_loadu_si128(p2), 1);
+
+	return _mm256_movemask_epi8(_mm256_cmpeq_epi16(both, _mm256_set1_epi16(fingerprint))) != 0;
+}
+#endif /* CUCKOO_X86 */
+
+#ifdef __SSE2__
+/* pair_probe -- kernel used for checking a pair of 16 byte buckets, chosen
+ *               at runtime by the CPU's features.
+ */
+typedef bool (*pair_probe_t)(const cuckoofilter *, size_t, size_t, uint16_t);
+static pair_probe_t pair_probe = NULL;
+
+static pair_probe_t select_pair_probe() {
+	pair_probe_t probe = __atomic_load_n(&pair_probe, __ATOMIC_RELAXED);
+
+	if (probe == NULL) {
+#ifdef CUCKOO_X86
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) {
+			probe = pair_contains_avx2;
+		}
+#endif
+		if (probe == NULL) {
+			probe = pair_contains_sse2;
+		}
+
+		__atomic_store_n(&pair_probe, probe, __ATOMIC_RELAXED);
+	}
+
+	return probe;
+}
+#endif /* __SSE2__ */
+
+/* bucket_match() - bitmask of slots in a bucket holding 'fingerprint'. use
+ *                  0 to find empty slots.
+ */
+static inline unsigned bucket_match(const cuckoofilter *cf, size_t bucket, uint16_t fingerprint) {
+#ifdef __SSE2__
+	if (cf->fingerprint_bits != 12) {
+		return bucket_match_sse2(cf, bucket, fingerprint);
+	}
+#endif
+
+	return bucket_match_scalar(cf, bucket, fingerprint);
+}
+
+/* pair_contains() - check if either candidate bucket holds 'fingerprint'
+ */
+static inline bool pair_contains(const cuckoofilter *cf, size_t i1, size_t i2, uint16_t fingerprint) {
+#ifdef __SSE2__
+	if (cf->fingerprint_bits != 12) {
+		if (cf->bucket_bytes == 16) {
+			return select_pair_probe()(cf, i1, i2, fingerprint);
+		}
+
+		return pair_contains_sse2(cf, i1, i2, fingerprint);
+	}
+#endif
+
+	return (bucket_match_scalar(cf, i1, fingerprint) |
+			bucket_match_scalar(cf, i2, fingerprint)) != 0;
+}
+
+/* element_hash(), alt_index() - a filter's view of cuckoo_hash() and
+ *     cuckoo_alt_index(), shared with the other cuckoo filters
+ */
+static inline void element_hash(const cuckoofilter *cf, void *key, size_t len, size_t *i1, uint16_t *fingerprint) {
+	cuckoo_hash(key, len, cf->num_buckets, cf->fingerprint_bits, i1, fingerprint);
+}
+
+static inline size_t alt_index(const cuckoofilter *cf, size_t index, uint16_t fingerprint) {
+	return cuckoo_alt_index(cf->num_buckets, index, fingerprint);
+}
+
+/* stripe_lock(), stripe_unlock() -- with CUCKOO_CONCURRENT, each bucket is
+ *     guarded by a stripe's version counter, which writers make odd while
+ *     they change the stripe's buckets and even again afterwards. readers
+ *     take no locks; they retry if a version changed while they looked.
+ */
+static inline void cpu_relax() {
+#ifdef CUCKOO_X86
+	_mm_pause();
+#endif
+}
+
+static void stripe_lock(uint32_t *version) {
+	for (;;) {
+		uint32_t v = __atomic_load_n(version, __ATOMIC_RELAXED);
+
+		if ((v & 1) == 0 &&
+			__atomic_compare_exchange_n(version, &v, v + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			// keep bucket writes from becoming visible before the odd version
+			__atomic_thread_fence(__ATOMIC_RELEASE);
+			return;
+		}
+
+		cpu_relax();
+	}
+}
+
+static void stripe_unlock(uint32_t *version) {
+	__atomic_fetch_add(version, 1, __ATOMIC_RELEASE);
+}
+
+/* lock_pair(), unlock_pair() - lock the stripes guarding two buckets, in
+ *                              address order so writers can't deadlock.
+ *                              these do nothing without CUCKOO_CONCURRENT.
+ */
+static void lock_pair(const cuckoofilter *cf, size_t a, size_t b) {
+	if (!(cf->flags & CUCKOO_CONCURRENT)) {
+		return;
+	}
+
+	uint32_t *first  = &cf->versions[a % cf->stripes];
+	uint32_t *second = &cf->versions[b % cf->stripes];
+
+	if (first > second) {
+		uint32_t *tmp = first;
+		first  = second;
+		second = tmp;
+	}
+
+	stripe_lock(first);
+	if (second != first) {
+		stripe_lock(second);
+	}
+}
+
+static void unlock_pair(const cuckoofilter *cf, size_t a, size_t b) {
+	if (!(cf->flags & CUCKOO_CONCURRENT)) {
+		return;
+	}
+
+	uint32_t *first  = &cf->versions[a % cf->stripes];
+	uint32_t *second = &cf->versions[b % cf->stripes];
+
+	stripe_unlock(first);
+	if (second != first) {
+		stripe_unlock(second);
+	}
+}
+
+/* count_insertions() - adjust the number of stored fingerprints
+ */
+static inline void count_insertions(cuckoofilter *cf, int delta) {
+	if (cf->flags & CUCKOO_CONCURRENT) {
+		__atomic_fetch_add(&cf->total_insertions, delta, __ATOMIC_RELAXED);
+	} else {
+		cf->total_insertions += delta;
+	}
+}
+
+static bool bucket_add(cuckoofilter *cf, size_t bucket_index, uint16_t fingerprint) {
+	unsigned empty = bucket_match(cf, bucket_index, 0);
+
+	if (empty == 0) {
+		return false;
+	}
+
+	set_fingerprint(cf, bucket_index, __builtin_ctz(empty), fingerprint);
+	count_insertions(cf, 1);
+
+	return true;
+}
+
+/* stash_add() - keep a fingerprint that has no room in either of its
+ *               buckets in the victim stash
+ */
+static bool stash_add(cuckoofilter *cf, size_t index, uint16_t fingerprint) {
+	if (cf->stash_count == CUCKOO_STASH_SIZE) {
+		return false;
+	}
+
+	cf->stash[cf->stash_count++] = (cuckoovictim){ index, fingerprint };
+
+	return true;
+}
+
+/* stash_find() - position of a fingerprint belonging to buckets i1 and i2
+ *                in the victim stash, or -1 if it isn't there
+ */
+static int stash_find(const cuckoofilter *cf, size_t i1, size_t i2, uint16_t fingerprint) {
+	for (size_t s = 0; s < cf->stash_count; s++) {
+		if (cf->stash[s].fingerprint == fingerprint &&
+			(cf->stash[s].index == i1 || cf->stash[s].index == i2)) {
+			return s;
+		}
+	}
+
+	return -1;
 }
 
-static bool cuckoo_add_fingerprint(cuckoofilter cf, size_t bucket_index, size_t offset, uint16_t fingerprint) {
-	for (size_t b = 0; b < cf.bucket_size; b++) {
-		if (cf.buckets[offset + b].fingerprint == 0) {
-			cf.buckets[offset + b].fingerprint = fingerprint;
-			cf.bucket_insertions[bucket_index] += 1;
-			cf.total_insertions += 1;
+/* stash_drain() - move stashed fingerprints back into their buckets where
+ *                 there is room. no evictions are attempted.
+ */
+static void stash_drain(cuckoofilter *cf) {
+	for (size_t s = 0; s < cf->stash_count;) {
+		size_t   index       = cf->stash[s].index;
+		uint16_t fingerprint = cf->stash[s].fingerprint;
+
+		if (bucket_add(cf, index, fingerprint) ||
+			bucket_add(cf, alt_index(cf, index, fingerprint), fingerprint)) {
+			cf->stash[s] = cf->stash[--cf->stash_count];
+		} else {
+			s++;
+		}
+	}
+}
+
+/* bfs_node -- a bucket reached while searching for an eviction path, and
+ *             the slot and fingerprint of its parent that would move into
+ *             it.
+ */
+typedef struct {
+	size_t   bucket;
+	uint32_t parent;
+	uint16_t fingerprint;
+	uint8_t  slot;
+} bfs_node;
+
+/* on_path() - check if 'bucket' is on the path from a root to node 'n'.
+ *             moving a fingerprint out of a bucket twice along one path
+ *             would move the wrong fingerprint the second time.
+ */
+static bool on_path(const bfs_node *nodes, uint32_t n, size_t bucket) {
+	for (; n != UINT32_MAX; n = nodes[n].parent) {
+		if (nodes[n].bucket == bucket) {
 			return true;
 		}
 	}
@@ -79,213 +530,957 @@ static bool cuckoo_add_fingerprint(cuckoofilter cf, size_t bucket_index, size_t
 	return false;
 }
 
-bool cuckoo_add(cuckoofilter cf, void *key, size_t len) {
-	uint32_t hash          = mmh3_32(key, len, 0);
-	uint16_t fingerprint   = (uint16_t)(hash & 0xffff); // lower 16 bits
-	size_t   i1            = hash % cf.num_buckets;
-	size_t   i2            = (i1 ^ (fingerprint >> 1)) % cf.num_buckets;
-	size_t   i1_offset     = i1 * cf.bucket_size;
-	size_t   i2_offset     = i2 * cf.bucket_size;
+/* bfs_search() - search breadth-first from both candidate buckets for the
+ *                nearest bucket with an empty slot. nothing is moved.
+ *
+ * Returns:
+ *     true and sets 'end' to the node whose bucket has an empty slot, and
+ *     'to_slot' to that slot, if a path was found within max_kicks buckets
+ *     false otherwise
+ */
+static bool bfs_search(const cuckoofilter *cf, size_t i1, size_t i2, bfs_node *nodes, uint32_t *end, size_t *to_slot) {
+	size_t limit = (cf->max_kicks < CUCKOO_BFS_MAX_NODES) ? cf->max_kicks : CUCKOO_BFS_MAX_NODES;
+	size_t head  = 0;
+	size_t tail  = 0;
+
+	if (limit < 2) {
+		return false;
+	}
+
+	nodes[tail++] = (bfs_node){ i1, UINT32_MAX, 0, 0 };
+	nodes[tail++] = (bfs_node){ i2, UINT32_MAX, 0, 0 };
+
+	for (; head < tail; head++) {
+		size_t bucket = nodes[head].bucket;
 
-	if (cuckoo_add_fingerprint(cf, i1, i1_offset, fingerprint) ||
-		cuckoo_add_fingerprint(cf, i2, i2_offset, fingerprint)) {
+		for (size_t b = 0; b < cf->bucket_size; b++) {
+			uint16_t fingerprint = get_fingerprint(cf, bucket, b);
+
+			// only with CUCKOO_CONCURRENT: the slot was emptied since
+			if (fingerprint == 0) {
+				*end     = head;
+				*to_slot = b;
+				return true;
+			}
+
+			size_t   alt   = alt_index(cf, bucket, fingerprint);
+			unsigned empty = bucket_match(cf, alt, 0);
+
+			if (empty != 0) {
+				nodes[tail] = (bfs_node){ alt, head, fingerprint, b };
+				*end        = tail;
+				*to_slot    = __builtin_ctz(empty);
+				return true;
+			}
+
+			if (tail < limit && !on_path(nodes, head, alt)) {
+				nodes[tail++] = (bfs_node){ alt, head, fingerprint, b };
+			}
+		}
+	}
+
+	return false;
+}
+
+/* move_fingerprint() - move a fingerprint between its buckets, provided it
+ *                      is still where it was found and its new slot is
+ *                      still empty. with CUCKOO_CONCURRENT, both buckets
+ *                      are locked so readers never miss it.
+ */
+static bool move_fingerprint(cuckoofilter *cf, size_t from, size_t from_slot, size_t to, size_t to_slot, uint16_t fingerprint) {
+	bool valid;
+
+	lock_pair(cf, from, to);
+
+	valid = get_fingerprint(cf, from, from_slot) == fingerprint &&
+			get_fingerprint(cf, to, to_slot) == 0;
+	if (valid) {
+		set_fingerprint(cf, to, to_slot, fingerprint);
+		set_fingerprint(cf, from, from_slot, 0);
+	}
+
+	unlock_pair(cf, from, to);
+
+	return valid;
+}
+
+/* bfs_execute() - walk a path found by bfs_search() back from its end,
+ *                 moving each fingerprint into the slot freed ahead of it.
+ *
+ * Returns:
+ *     true and sets 'bucket' and 'slot' to the freed slot in one of the
+ *     candidate buckets
+ *     false if another thread changed the path part way. every move made
+ *           still leaves fingerprints in one of their buckets.
+ */
+static bool bfs_execute(cuckoofilter *cf, const bfs_node *nodes, uint32_t n, size_t *bucket, size_t *slot) {
+	size_t to_slot = *slot;
+
+	for (; nodes[n].parent != UINT32_MAX; n = nodes[n].parent) {
+		if (!move_fingerprint(cf, nodes[nodes[n].parent].bucket, nodes[n].slot,
+							  nodes[n].bucket, to_slot, nodes[n].fingerprint)) {
+			return false;
+		}
+
+		to_slot = nodes[n].slot;
+	}
+
+	*bucket = nodes[n].bucket;
+	*slot   = to_slot;
+
+	return true;
+}
+
+/* cuckoo_add_bfs() - make room for a fingerprint by moving fingerprints
+ *                    along the shortest eviction path to an empty slot.
+ *                    nothing moves unless a path is found.
+ */
+static bool cuckoo_add_bfs(cuckoofilter *cf, size_t i1, size_t i2, uint16_t fingerprint) {
+	bfs_node nodes[CUCKOO_BFS_MAX_NODES + 1];
+	uint32_t end;
+	size_t   bucket;
+	size_t   slot;
+
+	if (!bfs_search(cf, i1, i2, nodes, &end, &slot) ||
+		!bfs_execute(cf, nodes, end, &bucket, &slot)) {
+		return false;
+	}
+
+	set_fingerprint(cf, bucket, slot, fingerprint);
+	count_insertions(cf, 1);
+
+	return true;
+}
+
+/* add_concurrent() - add a fingerprint to a CUCKOO_CONCURRENT filter. only
+ *                    the two buckets being changed are locked at any time,
+ *                    so inserts on other stripes proceed in parallel. if
+ *                    other threads keep taking the room made, this gives up
+ *                    after CUCKOO_PATH_RETRIES attempts.
+ */
+static bool add_concurrent(cuckoofilter *cf, size_t i1, uint16_t fingerprint) {
+	bfs_node nodes[CUCKOO_BFS_MAX_NODES + 1];
+	size_t   i2 = alt_index(cf, i1, fingerprint);
+
+	for (int attempt = 0; attempt < CUCKOO_PATH_RETRIES; attempt++) {
+		uint32_t end;
+		size_t   bucket;
+		size_t   slot;
+		bool     added;
+
+		lock_pair(cf, i1, i2);
+		added = bucket_add(cf, i1, fingerprint) || bucket_add(cf, i2, fingerprint);
+		unlock_pair(cf, i1, i2);
+
+		if (added) {
+			return true;
+		}
+
+		if (!bfs_search(cf, i1, i2, nodes, &end, &slot)) {
+			return false;
+		}
+
+		// whether or not the whole path moved, try adding again
+		bfs_execute(cf, nodes, end, &bucket, &slot);
+	}
+
+	return false;
+}
+
+/* cuckoo_add() - add an element to a cuckoo filter
+ *
+ * Args:
+ *     cf  - filter to add element to
+ *     key - element to add
+ *     len - length of element in bytes
+ *
+ * When no room can be made, the fingerprint left over is kept in a small
+ * victim stash, which lookups and removals also check. Stashed fingerprints
+ * are moved back into buckets as room frees up.
+ *
+ * Returns:
+ *     true if element was added
+ *     false if no room could be made and the stash is full. nothing is
+ *           lost; the filter is left as it was.
+ */
+bool cuckoo_add(cuckoofilter *cf, void *key, size_t len) {
+	size_t   i1;
+	uint16_t fingerprint;
+
+	element_hash(cf, key, len, &i1, &fingerprint);
+
+	return cuckoo_add_fingerprint(cf, i1, fingerprint);
+}
+
+/* cuckoo_add_fingerprint() - add a fingerprint to one of its buckets. this
+ *                            lets fingerprints be moved between filters of
+ *                            the same geometry without the original keys.
+ *
+ * Args:
+ *     cf          - filter to add fingerprint to
+ *     i1          - either of the fingerprint's buckets
+ *     fingerprint - fingerprint to add
+ *
+ * Returns:
+ *     true if fingerprint was added
+ *     false if no room could be made and the stash is full
+ */
+bool cuckoo_add_fingerprint(cuckoofilter *cf, size_t i1, uint16_t fingerprint) {
+	if (cf->flags & CUCKOO_CONCURRENT) {
+		return add_concurrent(cf, i1, fingerprint);
+	}
+
+	if (cf->stash_count > 0) {
+		stash_drain(cf);
+	}
+
+	size_t   i2 = alt_index(cf, i1, fingerprint);
+
+	if (bucket_add(cf, i1, fingerprint) ||
+		bucket_add(cf, i2, fingerprint)) {
 		return true;
 	}
 
+	// a random walk always ends holding a victim, so only start one if
+	// the stash has room for it
+	if (cf->stash_count == CUCKOO_STASH_SIZE) {
+		cf->evictions += 1;
+		return false;
+	}
+
+	if (cf->flags & CUCKOO_BFS) {
+		if (cuckoo_add_bfs(cf, i1, i2, fingerprint)) {
+			return true;
+		}
+
+		return stash_add(cf, i1, fingerprint);
+	}
+
 	// Eviction
-	size_t index        = (xorshift32(&cf.prng_state) % 2) ? i1 : i2;
-	size_t index_offset = index * cf.bucket_size;
+	size_t index = (xorshift32(&cf->prng_state) % 2) ? i1 : i2;
 
-	for (size_t kick = 0; kick < cf.max_kicks; kick++) {
-		size_t b = xorshift32(&cf.prng_state) % cf.bucket_size;
-		uint32_t evicted = cf.buckets[index_offset + b].fingerprint;
-		cf.buckets[index_offset + b].fingerprint = fingerprint;
+	for (size_t kick = 0; kick < cf->max_kicks; kick++) {
+		size_t   b       = xorshift32(&cf->prng_state) % cf->bucket_size;
+		uint16_t evicted = get_fingerprint(cf, index, b);
+		set_fingerprint(cf, index, b, fingerprint);
 		fingerprint = evicted;
 
-		if (cf.bucket_insertions[index] > 0) {
-			cf.bucket_insertions[index] -= 1;
-		}
-
 		// re-insert into new bucket
-		index = (index ^ fingerprint) % cf.num_buckets;
-		size_t new_index_offset = index * cf.bucket_size;
-		if (cuckoo_add_fingerprint(cf, index, new_index_offset, fingerprint)) {
+		index = alt_index(cf, index, fingerprint);
+		if (bucket_add(cf, index, fingerprint)) {
 			return true;
 		}
 	}
 
-	cf.evictions += 1;
-	return false; // max kicks reached; insertion failed.
+	// max kicks reached; keep the last victim rather than losing it
+	return stash_add(cf, index, fingerprint);
 }
 
-bool cuckoo_add_string(cuckoofilter cf, char *key) {
+/* cuckoo_fingerprint() - compute an element's fingerprint and primary
+ *                        bucket, for use with the *_fingerprint functions.
+ *                        filters of the same geometry give the same result.
+ *
+ * Args:
+ *     cf          - filter to hash for
+ *     key         - element to hash
+ *     len         - length of element in bytes
+ *     index       - set to the element's primary bucket
+ *     fingerprint - set to the element's fingerprint
+ *
+ * Returns:
+ *     Nothing
+ */
+void cuckoo_fingerprint(cuckoofilter cf, void *key, size_t len, size_t *index, uint16_t *fingerprint) {
+	element_hash(&cf, key, len, index, fingerprint);
+}
+
+/* cuckoo_add_string() - helper function to add string elements
+ *
+ * Args:
+ *     cf  - filter to add element to
+ *     key - string to add
+ *
+ * Returns:
+ *     true if element was added
+ *     false if no room could be made
+ */
+bool cuckoo_add_string(cuckoofilter *cf, char *key) {
 	return cuckoo_add(cf, key, strlen(key));
 }
 
+/* cuckoo_lookup() - check if an element is likely in a cuckoo filter
+ *
+ * Args:
+ *     cf  - filter to use
+ *     key - element to look up
+ *     len - length of element in bytes
+ *
+ * Returns:
+ *     true if element is probably in the filter
+ *     false if element is definitely not in the filter
+ */
 bool cuckoo_lookup(cuckoofilter cf, void *key, size_t len) {
 	if (cf.buckets == NULL) { // filter not initialized
 		return false;
 	}
-	uint32_t hash        = mmh3_32(key, len, 0);
-	uint16_t fingerprint = (uint16_t)(hash & 0xffff);
-	size_t   i1          = hash % cf.num_buckets;
-	size_t   i2          = (i1 ^ (fingerprint >> 1)) % cf.num_buckets;
 
-	size_t   i1_offset   = i1 * cf.bucket_size;
-	size_t   i2_offset   = i2 * cf.bucket_size;
+	size_t   i1;
+	uint16_t fingerprint;
 
-	for (size_t b = 0; b < cf.bucket_size; b++) {
-		if (cf.buckets[i1_offset + b].fingerprint == fingerprint ||
-			cf.buckets[i2_offset + b].fingerprint == fingerprint) {
-			return true;
+	element_hash(&cf, key, len, &i1, &fingerprint);
+
+	return cuckoo_lookup_fingerprint(cf, i1, fingerprint);
+}
+
+/* lookup_concurrent() - check both buckets of a CUCKOO_CONCURRENT filter
+ *                       without locking. the buckets may be read while a
+ *                       writer changes them, so the result only stands if
+ *                       neither stripe's version changed meanwhile.
+ */
+static bool lookup_concurrent(const cuckoofilter *cf, size_t i1, size_t i2, uint16_t fingerprint) {
+	uint32_t *s1 = &cf->versions[i1 % cf->stripes];
+	uint32_t *s2 = &cf->versions[i2 % cf->stripes];
+
+	for (;;) {
+		uint32_t v1 = __atomic_load_n(s1, __ATOMIC_ACQUIRE);
+		uint32_t v2 = __atomic_load_n(s2, __ATOMIC_ACQUIRE);
+
+		if ((v1 | v2) & 1) {
+			cpu_relax();
+			continue;
+		}
+
+		bool found = pair_contains(cf, i1, i2, fingerprint);
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(s1, __ATOMIC_RELAXED) == v1 &&
+			__atomic_load_n(s2, __ATOMIC_RELAXED) == v2) {
+			return found;
 		}
 	}
+}
 
-	return false;
+/* lookup_pair() - check a fingerprint's buckets, and the stash
+ */
+static bool lookup_pair(const cuckoofilter *cf, size_t i1, size_t i2, uint16_t fingerprint) {
+	if (cf->flags & CUCKOO_CONCURRENT) {
+		return lookup_concurrent(cf, i1, i2, fingerprint);
+	}
+
+	if (pair_contains(cf, i1, i2, fingerprint)) {
+		return true;
+	}
+
+	return cf->stash_count > 0 && stash_find(cf, i1, i2, fingerprint) >= 0;
+}
+
+/* cuckoo_lookup_fingerprint() - check if either of a fingerprint's buckets,
+ *                               or the stash, holds it
+ *
+ * Args:
+ *     cf          - filter to use
+ *     i1          - either of the fingerprint's buckets
+ *     fingerprint - fingerprint to look up
+ *
+ * Returns:
+ *     true if fingerprint is in the filter
+ *     false if fingerprint is not in the filter
+ */
+bool cuckoo_lookup_fingerprint(cuckoofilter cf, size_t i1, uint16_t fingerprint) {
+	return lookup_pair(&cf, i1, alt_index(&cf, i1, fingerprint), fingerprint);
 }
 
+/* cuckoo_lookup_string() - helper function to look up string elements
+ *
+ * Args:
+ *     cf  - filter to use
+ *     key - string to look up
+ *
+ * Returns:
+ *     true if element is probably in the filter
+ *     false if element is definitely not in the filter
+ */
 bool cuckoo_lookup_string(cuckoofilter cf, char *key) {
 	return cuckoo_lookup(cf, key, strlen(key));
 }
 
-static bool cuckoo_remove_fingerprint(cuckoofilter cf, size_t bucket_index, size_t offset, uint16_t fingerprint) {
-	for (size_t b = 0; b < cf.bucket_size; b++) {
-		if (cf.buckets[offset + b].fingerprint == fingerprint) {
-			cf.buckets[offset + b].fingerprint = 0;
+/* prefetch_bucket() - start loading a bucket into cache. buckets of packed
+ *                     12 bit fingerprints may straddle two cache lines.
+ */
+static inline void prefetch_bucket(const cuckoofilter *cf, size_t bucket, int rw) {
+	const uint8_t *p = cf->buckets + bucket * cf->bucket_bytes;
 
-			if (cf.bucket_insertions[bucket_index] > 0) {
-				cf.bucket_insertions[bucket_index] -= 1;
-			}
+	if (rw) {
+		__builtin_prefetch(p, 1);
+		__builtin_prefetch(p + cf->bucket_bytes - 1, 1);
+	} else {
+		__builtin_prefetch(p, 0);
+		__builtin_prefetch(p + cf->bucket_bytes - 1, 0);
+	}
+}
 
-			if (cf.total_insertions > 0) {
-				cf.total_insertions -= 1;
-			}
+/* cuckoo_lookup_batch() - check if each of several elements is likely in a
+ *                         cuckoo filter
+ *
+ * Elements are hashed a batch at a time, and both candidate buckets of each
+ * prefetched before any are probed, so cache misses on filters larger than
+ * the CPU's caches overlap rather than being paid two at a time.
+ *
+ * Args:
+ *     cf      - filter to use
+ *     keys    - array of elements to look up
+ *     lens    - length of each element in bytes
+ *     count   - number of elements
+ *     results - array of 'count' values, set to the result of each lookup
+ *
+ * Returns:
+ *     Nothing
+ */
+void cuckoo_lookup_batch(cuckoofilter cf, void **keys, const size_t *lens, const size_t count, bool *results) {
+	size_t   i1[CUCKOO_BATCH];
+	size_t   i2[CUCKOO_BATCH];
+	uint16_t fingerprints[CUCKOO_BATCH];
 
-			return true;
+	for (size_t start = 0; start < count; start += CUCKOO_BATCH) {
+		size_t n = (count - start < CUCKOO_BATCH) ? count - start : CUCKOO_BATCH;
+
+		for (size_t e = 0; e < n; e++) {
+			element_hash(&cf, keys[start + e], lens[start + e], &i1[e], &fingerprints[e]);
+			i2[e] = alt_index(&cf, i1[e], fingerprints[e]);
+			prefetch_bucket(&cf, i1[e], 0);
+			prefetch_bucket(&cf, i2[e], 0);
+		}
+
+		for (size_t e = 0; e < n; e++) {
+			results[start + e] = lookup_pair(&cf, i1[e], i2[e], fingerprints[e]);
 		}
 	}
+}
 
-	return false;
+/* cuckoo_add_batch() - add several elements to a cuckoo filter, hashing and
+ *                      prefetching a batch at a time as cuckoo_lookup_batch()
+ *                      does. evictions still touch buckets one at a time.
+ *
+ * Args:
+ *     cf      - filter to add elements to
+ *     keys    - array of elements to add
+ *     lens    - length of each element in bytes
+ *     count   - number of elements
+ *     results - array of 'count' values, set to the result of each add.
+ *               may be NULL.
+ *
+ * Returns:
+ *     number of elements added
+ */
+size_t cuckoo_add_batch(cuckoofilter *cf, void **keys, const size_t *lens, const size_t count, bool *results) {
+	size_t   i1[CUCKOO_BATCH];
+	uint16_t fingerprints[CUCKOO_BATCH];
+	size_t   added = 0;
+
+	for (size_t start = 0; start < count; start += CUCKOO_BATCH) {
+		size_t n = (count - start < CUCKOO_BATCH) ? count - start : CUCKOO_BATCH;
+
+		for (size_t e = 0; e < n; e++) {
+			element_hash(cf, keys[start + e], lens[start + e], &i1[e], &fingerprints[e]);
+			prefetch_bucket(cf, i1[e], 1);
+			prefetch_bucket(cf, alt_index(cf, i1[e], fingerprints[e]), 1);
+		}
+
+		for (size_t e = 0; e < n; e++) {
+			bool result = cuckoo_add_fingerprint(cf, i1[e], fingerprints[e]);
+
+			if (results != NULL) {
+				results[start + e] = result;
+			}
+			added += result;
+		}
+	}
+
+	return added;
 }
 
-bool cuckoo_remove(cuckoofilter cf, void *key, size_t len) {
-	uint32_t hash        = mmh3_32(key, len, 0);
-	uint16_t fingerprint = (uint16_t)(hash & 0xffff);
-	size_t   i1          = hash % cf.num_buckets;
-	size_t   i2          = (i1 ^ (fingerprint >> 1)) % cf.num_buckets;
+static bool bucket_remove(cuckoofilter *cf, size_t bucket_index, uint16_t fingerprint) {
+	unsigned match = bucket_match(cf, bucket_index, fingerprint);
 
-	size_t   i1_offset   = i1 * cf.bucket_size;
-	size_t   i2_offset   = i2 * cf.bucket_size;
+	if (match == 0) {
+		return false;
+	}
+
+	set_fingerprint(cf, bucket_index, __builtin_ctz(match), 0);
+
+	if (cf->total_insertions > 0) {
+		count_insertions(cf, -1);
+	}
+
+	return true;
+}
+
+/* cuckoo_remove() - remove an element from a cuckoo filter. only remove
+ *                   elements that were added; removing others may remove
+ *                   a matching fingerprint belonging to another element.
+ *
+ * Args:
+ *     cf  - filter to remove element from
+ *     key - element to remove
+ *     len - length of element in bytes
+ *
+ * Returns:
+ *     true if a matching fingerprint was removed
+ *     false if element was not found
+ */
+bool cuckoo_remove(cuckoofilter *cf, void *key, size_t len) {
+	size_t   i1;
+	uint16_t fingerprint;
+
+	element_hash(cf, key, len, &i1, &fingerprint);
+
+	return cuckoo_remove_fingerprint(cf, i1, fingerprint);
+}
+
+/* cuckoo_remove_fingerprint() - remove a fingerprint from either of its
+ *                               buckets, or the stash
+ *
+ * Args:
+ *     cf          - filter to remove fingerprint from
+ *     i1          - either of the fingerprint's buckets
+ *     fingerprint - fingerprint to remove
+ *
+ * Returns:
+ *     true if fingerprint was removed
+ *     false if fingerprint was not found
+ */
+bool cuckoo_remove_fingerprint(cuckoofilter *cf, size_t i1, uint16_t fingerprint) {
+	size_t   i2 = alt_index(cf, i1, fingerprint);
+
+	if (cf->flags & CUCKOO_CONCURRENT) {
+		bool removed;
+
+		lock_pair(cf, i1, i2);
+		removed = bucket_remove(cf, i1, fingerprint) || bucket_remove(cf, i2, fingerprint);
+		unlock_pair(cf, i1, i2);
+
+		return removed;
+	}
+
+	if (bucket_remove(cf, i1, fingerprint) ||
+		bucket_remove(cf, i2, fingerprint)) {
+		if (cf->stash_count > 0) {
+			stash_drain(cf);
+		}
 
-	if (cuckoo_remove_fingerprint(cf, i1, i1_offset, fingerprint) ||
-		cuckoo_remove_fingerprint(cf, i2, i2_offset, fingerprint)) {
 		return true;
 	}
 
+	if (cf->stash_count > 0) {
+		int s = stash_find(cf, i1, i2, fingerprint);
+		if (s >= 0) {
+			cf->stash[s] = cf->stash[--cf->stash_count];
+			return true;
+		}
+	}
+
 	return false; // probably not in cuckoo filter; remove failed.
 }
 
-bool cuckoo_remove_string(cuckoofilter cf, char *key) {
+/* cuckoo_remove_string() - helper function to remove string elements
+ *
+ * Args:
+ *     cf  - filter to remove element from
+ *     key - string to remove
+ *
+ * Returns:
+ *     true if a matching fingerprint was removed
+ *     false if element was not found
+ */
+bool cuckoo_remove_string(cuckoofilter *cf, char *key) {
 	return cuckoo_remove(cf, key, strlen(key));
 }
 
+/* cuckoo_merge() - move every fingerprint from one filter into another of
+ *                  the same geometry
+ *
+ * Args:
+ *     dst - filter to move fingerprints into
+ *     src - filter to move fingerprints out of
+ *
+ * Returns:
+ *     true if 'src' is now empty
+ *     false if the geometries differ or 'dst' ran out of room. fingerprints
+ *           that weren't moved remain in 'src'.
+ */
+bool cuckoo_merge(cuckoofilter *dst, cuckoofilter *src) {
+	if (dst->num_buckets != src->num_buckets ||
+		dst->fingerprint_bits != src->fingerprint_bits) {
+		return false;
+	}
+
+	while (src->stash_count > 0) {
+		cuckoovictim *victim = &src->stash[src->stash_count - 1];
+		if (!cuckoo_add_fingerprint(dst, victim->index, victim->fingerprint)) {
+			return false;
+		}
+		src->stash_count--;
+	}
+
+	for (size_t bucket = 0; bucket < src->num_buckets; bucket++) {
+		for (size_t b = 0; b < src->bucket_size; b++) {
+			uint16_t fingerprint = get_fingerprint(src, bucket, b);
+			if (fingerprint == 0) {
+				continue;
+			}
+
+			if (!cuckoo_add_fingerprint(dst, bucket, fingerprint)) {
+				return false;
+			}
+
+			set_fingerprint(src, bucket, b, 0);
+			src->total_insertions -= 1;
+		}
+	}
+
+	return true;
+}
+
+/* cuckoo_load_factor() - percentage of slots holding a fingerprint
+ *
+ * Args:
+ *     cf - filter to check
+ *
+ * Returns:
+ *     load factor, 0.0 through 100.0
+ */
 double cuckoo_load_factor(cuckoofilter cf) {
 	size_t capacity = cf.num_buckets * cf.bucket_size;
 	return ((double)cf.total_insertions / (double)capacity) * 100.0;
 }
 
+/* put_le(), get_le() -- store and fetch little-endian integers of 'bytes'
+ *     bytes, so files are the same on every host
+ */
+static void put_le(uint8_t *p, uint64_t value, int bytes) {
+	for (int i = 0; i < bytes; i++) {
+		p[i] = value >> (8 * i);
+	}
+}
+
+static uint64_t get_le(const uint8_t *p, int bytes) {
+	uint64_t value = 0;
 
-bool cuckoo_save(cuckoofilter cf, const char *path) {
-	FILE *fp;
+	for (int i = 0; i < bytes; i++) {
+		value |= (uint64_t)p[i] << (8 * i);
+	}
 
-	fp = fopen(path, "wb");
-	if (fp == NULL) {
+	return value;
+}
+
+/* swap_fingerprints() - byte swap a loaded filter's 16 bit fingerprints
+ *                       from the little-endian file order to host order. 8
+ *                       and 12 bit fingerprints are stored a byte at a time
+ *                       already.
+ */
+static void swap_fingerprints(cuckoofilter *cf) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	uint16_t *fingerprints = (uint16_t *)cf->buckets;
+
+	if (cf->fingerprint_bits != 16) {
+		return;
+	}
+
+	for (size_t i = 0; i < cf->num_buckets * cf->bucket_size; i++) {
+		fingerprints[i] = __builtin_bswap16(fingerprints[i]);
+	}
+#else
+	(void)cf;
+#endif
+}
+
+/* write_buckets() - write a filter's buckets in file order. 16 bit
+ *                   fingerprints on big-endian hosts are swapped a chunk at
+ *                   a time into a separate buffer, leaving the live buckets
+ *                   untouched for concurrent lookups.
+ *
+ * Returns:
+ *     true if every bucket was written
+ *     false otherwise
+ */
+static bool write_buckets(const cuckoofilter *cf, FILE *fp) {
+	uint16_t chunk[4096];
+	size_t   total = cf->num_buckets * cf->bucket_size;
+
+	if (__BYTE_ORDER__ != __ORDER_BIG_ENDIAN__ || cf->fingerprint_bits != 16) {
+		return fwrite(cf->buckets, cf->bucket_bytes, cf->num_buckets, fp) == cf->num_buckets;
+	}
+
+	for (size_t start = 0; start < total; start += 4096) {
+		size_t n = (total - start < 4096) ? total - start : 4096;
+
+		for (size_t i = 0; i < n; i++) {
+			chunk[i] = __builtin_bswap16(((const uint16_t *)cf->buckets)[start + i]);
+		}
+
+		if (fwrite(chunk, sizeof(uint16_t), n, fp) != n) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* encode_header() - write a filter's file header. see cuckoo.h for the
+ *                   layout.
+ */
+static void encode_header(const cuckoofilter *cf, uint8_t *header) {
+	memcpy(header, CUCKOO_FILE_MAGIC, 8);
+	put_le(header + 8,  CUCKOO_FILE_VERSION, 4);
+	put_le(header + 12, CUCKOO_FILE_ALIGN, 4);
+	put_le(header + 16, cf->num_buckets, 8);
+	put_le(header + 24, cf->bucket_size, 4);
+	put_le(header + 28, cf->fingerprint_bits, 4);
+	put_le(header + 32, cf->max_kicks, 8);
+	put_le(header + 40, cf->flags, 4);
+	put_le(header + 44, cf->stash_count, 4);
+	put_le(header + 48, cf->total_insertions, 8);
+	put_le(header + 56, cf->evictions, 8);
+
+	for (size_t s = 0; s < CUCKOO_STASH_SIZE; s++) {
+		uint8_t *victim = header + 64 + s * 16;
+
+		put_le(victim, (s < cf->stash_count) ? cf->stash[s].index : 0, 8);
+		put_le(victim + 8, (s < cf->stash_count) ? cf->stash[s].fingerprint : 0, 8);
+	}
+}
+
+/* decode_header() - read and validate a file header, filling in every
+ *                   field of 'cf' but the buckets
+ *
+ * Returns:
+ *     true if the header is valid for a file of 'file_size' bytes
+ *     false otherwise
+ */
+static bool decode_header(const uint8_t *header, uint64_t file_size, cuckoofilter *cf) {
+	if (file_size < CUCKOO_FILE_ALIGN ||
+		memcmp(header, CUCKOO_FILE_MAGIC, 8) != 0 ||
+		get_le(header + 8, 4) != CUCKOO_FILE_VERSION ||
+		get_le(header + 12, 4) != CUCKOO_FILE_ALIGN) {
 		return false;
 	}
 
-	// Write cuckoofilter struct as the file's header
-	// TODO this may cause issues on systems with different datatypes
-	//      endianness, or compilers that add padding to structs. this
-	//      needs to be revisited at some point and tested on different
-	//      systems. this should also be checked on other data strucures
-	//      _save and _load functions.
-	if (fwrite(&cf, sizeof(cuckoofilter), 1, fp) != 1) {
-		fclose(fp);
+	memset(cf, 0, sizeof(cuckoofilter));
+	cf->num_buckets      = get_le(header + 16, 8);
+	cf->bucket_size      = get_le(header + 24, 4);
+	cf->fingerprint_bits = get_le(header + 28, 4);
+	cf->max_kicks        = get_le(header + 32, 8);
+	cf->flags            = get_le(header + 40, 4);
+	cf->stash_count      = get_le(header + 44, 4);
+	cf->total_insertions = get_le(header + 48, 8);
+	cf->evictions        = get_le(header + 56, 8);
+
+	if (cf->num_buckets == 0 ||
+		cf->stash_count > CUCKOO_STASH_SIZE ||
+		!valid_geometry(cf->bucket_size, cf->fingerprint_bits)) {
 		return false;
 	}
 
-	// save buckets and bucket_insertions
-	if (fwrite(cf.buckets, sizeof(cuckoobucket), cf.num_buckets * cf.bucket_size, fp) != (cf.num_buckets * cf.bucket_size) ||
-		fwrite(cf.bucket_insertions, sizeof(size_t), cf.num_buckets, fp) != cf.num_buckets) {
-		fclose(fp);
+	cf->bucket_bytes = bucket_bytes(cf->bucket_size, cf->fingerprint_bits);
+	if (cf->num_buckets > (file_size - CUCKOO_FILE_ALIGN) / cf->bucket_bytes ||
+		CUCKOO_FILE_ALIGN + cf->num_buckets * cf->bucket_bytes != file_size) {
 		return false;
 	}
 
-	fclose(fp);
+	for (size_t s = 0; s < cf->stash_count; s++) {
+		const uint8_t *victim = header + 64 + s * 16;
+
+		cf->stash[s].index       = get_le(victim, 8);
+		cf->stash[s].fingerprint = get_le(victim + 8, 8);
+		if (cf->stash[s].index >= cf->num_buckets) {
+			return false;
+		}
+	}
+
 	return true;
 }
 
+/* attach() - set up the parts of a loaded filter that aren't saved
+ */
+static bool attach(cuckoofilter *cf) {
+	cf->prng_state = seed_xorshift32();
+	cf->stripes    = 0;
+	cf->versions   = NULL;
+
+	if (cf->flags & CUCKOO_CONCURRENT) {
+		cf->stripes  = stripe_count(cf->num_buckets);
+		cf->versions = calloc(cf->stripes, sizeof(uint32_t));
+		if (cf->versions == NULL) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* cuckoo_save() - save a cuckoo filter to disk in a portable format: a
+ *                 versioned little-endian header, with the buckets
+ *                 following at CUCKOO_FILE_ALIGN so the file can be mapped
+ *                 with cuckoo_map().
+ *
+ * Args:
+ *     cf   - filter to save
+ *     path - path to save filter
+ *
+ * Returns:
+ *     true on success
+ *     false if unable to write the file
+ */
+bool cuckoo_save(cuckoofilter cf, const char *path) {
+	FILE    *fp;
+	uint8_t  header[CUCKOO_FILE_ALIGN] = { 0 };
+	bool     written;
+
+	fp = fopen(path, "wb");
+	if (fp == NULL) {
+		return false;
+	}
+
+	encode_header(&cf, header);
+
+	written = fwrite(header, sizeof(header), 1, fp) == 1 &&
+			  write_buckets(&cf, fp);
+
+	if (fclose(fp) != 0) {
+		return false;
+	}
+
+	return written;
+}
+
+/* cuckoo_load() - load a cuckoo filter saved by cuckoo_save() into memory
+ *
+ * Args:
+ *     cf   - filter structure to populate
+ *     path - path to saved filter
+ *
+ * Returns:
+ *     true on success
+ *     false if the file can't be read or is invalid, or out of memory
+ */
 bool cuckoo_load(cuckoofilter *cf, const char *path) {
-	FILE        *fp;
-	struct stat  sb;
+	FILE         *fp;
+	struct stat   sb;
+	uint8_t       header[CUCKOO_FILE_ALIGN];
+	cuckoofilter  cfb;
 
 	fp = fopen(path, "rb");
 	if (fp == NULL) {
 		return false;
 	}
 
-	cuckoofilter cfb;
-	// read file header
-	if (fread(&cfb, sizeof(cuckoofilter), 1, fp) != 1) {
+	if (fstat(fileno(fp), &sb) != 0 ||
+		fread(header, sizeof(header), 1, fp) != 1 ||
+		!decode_header(header, sb.st_size, &cfb)) {
 		fclose(fp);
 		return false;
 	}
 
-	cf->num_buckets      = cfb.num_buckets;
-	cf->bucket_size      = cfb.bucket_size;
-	cf->max_kicks        = cfb.max_kicks;
-	cf->total_insertions = cfb.total_insertions;
-	cf->evictions        = cfb.evictions;
-	cf->prng_state       = cfb.prng_state;
-
-	// sanity checks
-	if (fstat(fileno(fp), &sb) != 0) {
+	cfb.buckets = malloc(cfb.num_buckets * cfb.bucket_bytes);
+	if (cfb.buckets == NULL) {
 		fclose(fp);
 		return false;
 	}
 
-	size_t expected_filesize =  sizeof(cuckoofilter) +
-		   (cf->num_buckets * cf->bucket_size * sizeof(cuckoobucket)) +
-		   (cf->num_buckets * sizeof(size_t));
-	if (expected_filesize != sb.st_size) {
+	if (fread(cfb.buckets, cfb.bucket_bytes, cfb.num_buckets, fp) != cfb.num_buckets ||
+		!attach(&cfb)) {
+		free(cfb.buckets);
 		fclose(fp);
 		return false;
 	}
 
-	// re-populate bucket data
-	cfb.buckets = (cuckoobucket *)calloc(cf->num_buckets * cf->bucket_size, sizeof(cuckoobucket));
-	if (cf->buckets == NULL) {
-		fclose(fp);
+	swap_fingerprints(&cfb);
+	*cf = cfb;
+
+	fclose(fp);
+	return true;
+}
+
+/* cuckoo_map() - map a filter saved by cuckoo_save() into memory, rather
+ *                than reading it. pages are loaded as lookups touch them,
+ *                so even very large filters are ready immediately.
+ *
+ * With CUCKOO_MAP_SHARED, changes to the buckets are written back to the
+ * file and seen by every process mapping it. Counters and the stash live in
+ * the cuckoofilter structure; use cuckoo_sync() to write them to the file.
+ * Other processes only read them when mapping. Only one process should
+ * change a shared filter at a time; CUCKOO_CONCURRENT only coordinates
+ * threads within a process.
+ *
+ * Args:
+ *     cf    - filter structure to populate
+ *     path  - path to saved filter
+ *     flags - CUCKOO_MAP_PRIVATE to keep changes private to this process
+ *             (copy-on-write), or CUCKOO_MAP_SHARED to write them to the
+ *             file
+ *
+ * Returns:
+ *     true on success
+ *     false if the file can't be mapped or is invalid, or on big-endian
+ *           hosts with 16 bit fingerprints, which need to be loaded
+ */
+bool cuckoo_map(cuckoofilter *cf, const char *path, int flags) {
+	bool          shared = flags & CUCKOO_MAP_SHARED;
+	struct stat   sb;
+	cuckoofilter  cfb;
+	uint8_t      *mapping;
+	int           fd;
+
+	fd = open(path, shared ? O_RDWR : O_RDONLY);
+	if (fd < 0) {
 		return false;
 	}
-	cf->buckets = cfb.buckets;
 
-	cfb.bucket_insertions = (size_t *)calloc(cf->num_buckets, sizeof(size_t));
-	if (cf->bucket_insertions == NULL) {
-		free(cf->buckets);
-		fclose(fp);
+	if (fstat(fd, &sb) != 0 || sb.st_size < CUCKOO_FILE_ALIGN) {
+		close(fd);
 		return false;
 	}
-	cf->bucket_insertions = cfb.bucket_insertions;
 
-	if (fread(cf->buckets, sizeof(cuckoobucket), cf->num_buckets * cf->bucket_size, fp) != (cf->num_buckets * cf->bucket_size) ||
-		fread(cf->bucket_insertions, sizeof(size_t), cf->num_buckets, fp) != cf->num_buckets) {
-		free(cf->buckets);
-		free(cf->bucket_insertions);
-		fclose(fp);
+	mapping = mmap(NULL, sb.st_size, PROT_READ | PROT_WRITE,
+				   shared ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
 		return false;
 	}
 
-	fclose(fp);
+	if (!decode_header(mapping, sb.st_size, &cfb) ||
+		(__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__ && cfb.fingerprint_bits == 16) ||
+		!attach(&cfb)) {
+		munmap(mapping, sb.st_size);
+		return false;
+	}
+
+	cfb.buckets       = mapping + CUCKOO_FILE_ALIGN;
+	cfb.mapping       = mapping;
+	cfb.mapping_size  = sb.st_size;
+	cfb.mapping_flags = flags;
+	*cf = cfb;
+
 	return true;
 }
+
+/* cuckoo_sync() - write a mapped filter's header to its file, and flush
+ *                 changes to disk
+ *
+ * Args:
+ *     cf - filter mapped with cuckoo_map() and CUCKOO_MAP_SHARED
+ *
+ * Returns:
+ *     true on success
+ *     false if the filter isn't mapped, its mapping is private, so nothing
+ *           would reach the file, or msync() fails
+ */
+bool cuckoo_sync(cuckoofilter cf) {
+	if (cf.mapping == NULL || !(cf.mapping_flags & CUCKOO_MAP_SHARED)) {
+		return false;
+	}
+
+	encode_header(&cf, cf.mapping);
+
+	return msync(cf.mapping, cf.mapping_size, MS_SYNC) == 0;
+}
@@ -6,37 +6,114 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-/* cuckoobucket -- typedef for cuckoo filter bucket
+/* CUCKOO_FINGERPRINT_DEFAULT -- fingerprint width used by cuckoo_init()
+ */
+#define CUCKOO_FINGERPRINT_DEFAULT 16
+
+/* flags for cuckoo_init_ex()
+ */
+#define CUCKOO_BFS        0x01 /* search breadth-first for the shortest eviction path */
+#define CUCKOO_CONCURRENT 0x02 /* allow use from multiple threads at once */
+
+/* CUCKOO_BFS_MAX_NODES -- upper bound on buckets visited by one BFS search
+ */
+#define CUCKOO_BFS_MAX_NODES 2048
+
+/* CUCKOO_STRIPES -- maximum number of version counters guarding buckets
+ *                   with CUCKOO_CONCURRENT. bucket i is guarded by counter
+ *                   i % stripes.
+ */
+#define CUCKOO_STRIPES 1024
+
+/* CUCKOO_STASH_SIZE -- number of fingerprints the victim stash can hold
+ */
+#define CUCKOO_STASH_SIZE 8
+
+/* flags for cuckoo_map()
+ */
+#define CUCKOO_MAP_PRIVATE 0x00 /* changes are copy-on-write, private to the process */
+#define CUCKOO_MAP_SHARED  0x01 /* changes are written to the file */
+
+/* cuckoo file format, written by cuckoo_save(). integers are little-endian.
+ *
+ *     offset  size  field
+ *          0     8  CUCKOO_FILE_MAGIC
+ *          8     4  CUCKOO_FILE_VERSION
+ *         12     4  offset of buckets, CUCKOO_FILE_ALIGN
+ *         16     8  num_buckets
+ *         24     4  bucket_size
+ *         28     4  fingerprint_bits
+ *         32     8  max_kicks
+ *         40     4  flags
+ *         44     4  stash_count
+ *         48     8  total_insertions
+ *         56     8  evictions
+ *         64   128  stash: CUCKOO_STASH_SIZE pairs of 8 byte index and
+ *                   8 byte fingerprint
+ *       4096        buckets, as laid out in memory. 16 bit fingerprints are
+ *                   little-endian.
+ *
+ * Buckets start on a page boundary, so a mapped file can be used in place.
+ */
+#define CUCKOO_FILE_MAGIC   "CUCKOOFL"
+#define CUCKOO_FILE_VERSION 1
+#define CUCKOO_FILE_ALIGN   4096
+
+/* cuckoovictim -- a fingerprint that couldn't be placed in a bucket, and
+ *                 one of the two buckets it belongs in.
  */
 typedef struct {
-	uint32_t fingerprint;
-} cuckoobucket;
+	size_t        index;
+	uint16_t      fingerprint;
+} cuckoovictim;
 
-/* cuckoofilter -- cuckoo filter structure
+/* cuckoofilter -- cuckoo filter structure. fingerprints are packed
+ *                 'fingerprint_bits' wide, 'bucket_size' per bucket, with
+ *                 no per-bucket metadata. 0 marks an empty slot.
  */
 typedef struct {
-	cuckoobucket *buckets;
+	uint8_t      *buckets;           /* packed fingerprints */
 	size_t        num_buckets;
 	size_t        bucket_size;       /* 2, 4, or 8 */
-	size_t        max_kicks;
+	size_t        fingerprint_bits;  /* 8, 12, or 16 */
+	size_t        bucket_bytes;      /* size of one bucket in bytes */
+	size_t        max_kicks;         /* evictions, or buckets searched with CUCKOO_BFS */
+	int           flags;             /* CUCKOO_* flags passed at initialization */
 	size_t        total_insertions;  /* insertion counter */
-	size_t       *bucket_insertions; /* insertion counters per bucket */
 	size_t        evictions;         /* eviction counter */
 	uint32_t      prng_state;        /* xorshift state */
+	size_t        stash_count;       /* number of fingerprints in stash */
+	cuckoovictim  stash[CUCKOO_STASH_SIZE]; /* fingerprints with no room in their buckets */
+	size_t        stripes;           /* number of version counters */
+	uint32_t     *versions;          /* stripe versions, odd while locked */
+	void         *mapping;           /* file mapped by cuckoo_map(), or NULL */
+	size_t        mapping_size;      /* size of mapping in bytes */
+	int           mapping_flags;     /* CUCKOO_MAP_* flags passed to cuckoo_map() */
 } cuckoofilter;
 
 /* function definitions
  */
 bool cuckoo_init(cuckoofilter *, size_t, size_t, size_t);
+bool cuckoo_init_ex(cuckoofilter *, size_t, size_t, size_t, size_t, int);
 void cuckoo_destroy(cuckoofilter);
-bool cuckoo_add(cuckoofilter, void *, size_t);
-bool cuckoo_add_string(cuckoofilter, char *);
+size_t cuckoo_memory(cuckoofilter);
+bool cuckoo_add(cuckoofilter *, void *, size_t);
+bool cuckoo_add_string(cuckoofilter *, char *);
 bool cuckoo_lookup(cuckoofilter, void *, size_t);
 bool cuckoo_lookup_string(cuckoofilter, char *);
-bool cuckoo_remove(cuckoofilter, void *, size_t);
-bool cuckoo_remove_string(cuckoofilter, char *);
+void cuckoo_lookup_batch(cuckoofilter, void **, const size_t *, const size_t, bool *);
+size_t cuckoo_add_batch(cuckoofilter *, void **, const size_t *, const size_t, bool *);
+bool cuckoo_remove(cuckoofilter *, void *, size_t);
+bool cuckoo_remove_string(cuckoofilter *, char *);
+void cuckoo_fingerprint(cuckoofilter, void *, size_t, size_t *, uint16_t *);
+bool cuckoo_add_fingerprint(cuckoofilter *, size_t, uint16_t);
+bool cuckoo_lookup_fingerprint(cuckoofilter, size_t, uint16_t);
+bool cuckoo_remove_fingerprint(cuckoofilter *, size_t, uint16_t);
+bool cuckoo_merge(cuckoofilter *, cuckoofilter *);
 double cuckoo_load_factor(cuckoofilter);
 bool cuckoo_save(cuckoofilter, const char *);
 bool cuckoo_load(cuckoofilter *, const char *);
+bool cuckoo_map(cuckoofilter *, const char *, int);
+bool cuckoo_sync(cuckoofilter);
 
 #endif /* CUCKOO_H */
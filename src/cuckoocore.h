@@ -0,0 +1,153 @@
+/* cuckoocore.h -- hashing, bucket, stash, and eviction code shared by the
+ *                 cuckoo filters. not installed.
+ *
+ * cuckoo_hash() and cuckoo_alt_index() are used by every cuckoo filter, so
+ * elements hash the same way in each.
+ *
+ * Filters storing whole entries, a fingerprint packed with per-entry data
+ * in a flat array of integers, also share their bucket, stash, and
+ * eviction code. Define these before including this header to generate
+ * core_bucket_add(), core_stash_drain(), and core_insert() for an entry
+ * type:
+ *
+ *     CORE_ENTRY                     - integer type of an entry, 0 if empty
+ *     CORE_FILTER                    - filter type, with entries,
+ *                                      num_buckets, bucket_size,
+ *                                      prng_state, stash_count, and stash
+ *     CORE_STASH_SIZE                - capacity of the filter's stash
+ *     CORE_MAX_KICKS(filter)         - evictions attempted per insert
+ *     CORE_FINGERPRINT(entry)        - fingerprint held by an entry
+ *     CORE_VACANT(filter, entry, now) - true if a slot holding 'entry' may
+ *                                      be reused, or a stashed 'entry'
+ *                                      dropped
+ *     CORE_STORED(filter)            - a bucket gained an entry
+ *
+ * 'now' is passed through to CORE_VACANT, for filters whose entries expire.
+ * Others pass 0.
+ */
+#ifndef CUCKOOCORE_H
+#define CUCKOOCORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "mmh3.h"
+#include "xorshift.h"
+
+/* cuckoo_hash() - compute an element's fingerprint and primary bucket.
+ *                 fingerprints are never 0, which marks an empty slot.
+ *
+ * Args:
+ *     key              - element to hash
+ *     len              - length of element in bytes
+ *     num_buckets      - number of buckets
+ *     fingerprint_bits - fingerprint width, at most 16
+ *     i1               - set to the element's primary bucket
+ *     fingerprint      - set to the element's fingerprint
+ *
+ * Returns:
+ *     Nothing
+ */
+static inline void cuckoo_hash(void *key, size_t len, size_t num_buckets, size_t fingerprint_bits, size_t *i1, uint16_t *fingerprint) {
+	uint64_t hash[2];
+
+	mmh3_128(key, len, 0, hash);
+
+	*i1          = hash[0] % num_buckets;
+	*fingerprint = hash[1] & ((1U << fingerprint_bits) - 1);
+	if (*fingerprint == 0) {
+		*fingerprint = 1;
+	}
+}
+
+/* cuckoo_alt_index() - the other bucket a fingerprint may live in. this is
+ *                      its own inverse for any number of buckets, so a
+ *                      fingerprint can be moved between its buckets without
+ *                      knowing the original key.
+ */
+static inline size_t cuckoo_alt_index(size_t num_buckets, size_t index, uint16_t fingerprint) {
+	size_t h = ((uint64_t)fingerprint * 0x5bd1e995) % num_buckets;
+
+	return (h + num_buckets - index) % num_buckets;
+}
+
+#endif /* CUCKOOCORE_H */
+
+#ifdef CORE_ENTRY
+/* core_bucket_add() - place an entry in the first vacant slot of a bucket
+ */
+static bool core_bucket_add(CORE_FILTER *filter, size_t index, CORE_ENTRY entry, int64_t now) {
+	CORE_ENTRY *bucket = filter->entries + index * filter->bucket_size;
+
+	for (size_t b = 0; b < filter->bucket_size; b++) {
+		if (CORE_VACANT(filter, bucket[b], now)) {
+			bucket[b] = entry;
+			CORE_STORED(filter);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* core_stash_drain() - drop vacant entries from the stash, and move the
+ *                      rest back into their buckets where there is room.
+ *                      no evictions are attempted.
+ */
+static void core_stash_drain(CORE_FILTER *filter, int64_t now) {
+	for (size_t s = 0; s < filter->stash_count;) {
+		size_t     index = filter->stash[s].index;
+		CORE_ENTRY entry = filter->stash[s].entry;
+
+		if (CORE_VACANT(filter, entry, now) ||
+			core_bucket_add(filter, index, entry, now) ||
+			core_bucket_add(filter, cuckoo_alt_index(filter->num_buckets, index, CORE_FINGERPRINT(entry)), entry, now)) {
+			filter->stash[s] = filter->stash[--filter->stash_count];
+		} else {
+			s++;
+		}
+	}
+}
+
+/* core_insert() - place a new entry in one of its buckets, evicting along
+ *                 a random walk if both are full. the last victim goes to
+ *                 the stash, so a walk is only started if it has room.
+ *
+ * Returns:
+ *     true if the entry was placed
+ *     false if both buckets are full and the stash is too. the filter is
+ *           left as it was.
+ */
+static bool core_insert(CORE_FILTER *filter, size_t i1, size_t i2, CORE_ENTRY entry, int64_t now) {
+	if (core_bucket_add(filter, i1, entry, now) || core_bucket_add(filter, i2, entry, now)) {
+		return true;
+	}
+
+	if (filter->stash_count == CORE_STASH_SIZE) {
+		return false;
+	}
+
+	size_t index = (xorshift32(&filter->prng_state) % 2) ? i1 : i2;
+
+	for (size_t kick = 0; kick < CORE_MAX_KICKS(filter); kick++) {
+		size_t      b       = xorshift32(&filter->prng_state) % filter->bucket_size;
+		CORE_ENTRY *slot    = &filter->entries[index * filter->bucket_size + b];
+		CORE_ENTRY  evicted = *slot;
+
+		*slot = entry;
+		entry = evicted;
+
+		index = cuckoo_alt_index(filter->num_buckets, index, CORE_FINGERPRINT(entry));
+		if (core_bucket_add(filter, index, entry, now)) {
+			return true;
+		}
+	}
+
+	filter->stash[filter->stash_count].index = index;
+	filter->stash[filter->stash_count].entry = entry;
+	filter->stash_count++;
+
+	return true;
+}
+#endif /* CORE_ENTRY */
@@ -0,0 +1,317 @@
+/* dcuckoo.c
+ *
+ * Dynamic cuckoo filter. A single cuckoo filter can't be resized without
+ * the original keys, since only fingerprints are stored. Instead, this keeps
+ * a chain of filters with the same geometry: an element hashes to the same
+ * buckets and fingerprint in each, so fingerprints can be moved between
+ * filters freely. When the newest filter fills up, a new one is added to
+ * the chain. After enough removals, the emptiest filter is merged into the
+ * others and freed.
+ *
+ * Lookups check every filter in the chain, so the false positive rate grows
+ * with the number of filters.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cuckoo.h"
+#include "dcuckoo.h"
+
+/* grow() - add an empty filter to the end of the chain
+ */
+static bool grow(dcuckoo *dcf) {
+	if (dcf->count == dcf->capacity) {
+		size_t        capacity = dcf->capacity * 2;
+		cuckoofilter *filters  = realloc(dcf->filters, capacity * sizeof(cuckoofilter));
+		if (filters == NULL) {
+			return false;
+		}
+
+		dcf->filters  = filters;
+		dcf->capacity = capacity;
+	}
+
+	if (cuckoo_init_ex(&dcf->filters[dcf->count], dcf->num_buckets, dcf->bucket_size,
+					   dcf->max_kicks, dcf->fingerprint_bits, dcf->flags) == false) {
+		return false;
+	}
+
+	dcf->count++;
+
+	return true;
+}
+
+/* dcuckoo_init() - initialize a dynamic cuckoo filter holding one filter
+ *
+ * Args:
+ *     dcf              - filter to initialize
+ *     num_buckets      - number of buckets in each filter of the chain
+ *     bucket_size      - number of fingerprints per bucket: 2, 4, or 8
+ *     max_kicks        - maximum number of evictions attempted per insert
+ *     fingerprint_bits - width of fingerprints: 8, 12, or 16
+ *     flags            - CUCKOO_* flags, as for cuckoo_init_ex(). the chain
+ *                        itself is single-threaded, since growing and
+ *                        shrinking it move and free filters, so
+ *                        CUCKOO_CONCURRENT is rejected.
+ *
+ * Returns:
+ *     true on success
+ *     false if parameters are invalid or unable to allocate memory
+ */
+bool dcuckoo_init(dcuckoo *dcf, size_t num_buckets, size_t bucket_size,
+				  size_t max_kicks, size_t fingerprint_bits, int flags) {
+	if (flags & CUCKOO_CONCURRENT) {
+		return false;
+	}
+
+	dcf->num_buckets      = num_buckets;
+	dcf->bucket_size      = bucket_size;
+	dcf->max_kicks        = max_kicks;
+	dcf->fingerprint_bits = fingerprint_bits;
+	dcf->flags            = flags;
+	dcf->count            = 0;
+	dcf->capacity         = 4;
+
+	dcf->filters = calloc(dcf->capacity, sizeof(cuckoofilter));
+	if (dcf->filters == NULL) {
+		return false;
+	}
+
+	if (grow(dcf) == false) {
+		free(dcf->filters);
+		return false;
+	}
+
+	return true;
+}
+
+/* dcuckoo_destroy() - free memory allocated by a dynamic cuckoo filter
+ *
+ * Args:
+ *     dcf - filter to destroy
+ *
+ * Returns:
+ *     Nothing
+ */
+void dcuckoo_destroy(dcuckoo dcf) {
+	for (size_t i = 0; i < dcf.count; i++) {
+		cuckoo_destroy(dcf.filters[i]);
+	}
+
+	free(dcf.filters);
+}
+
+/* dcuckoo_memory() - number of bytes used by the buckets of every filter
+ *
+ * Args:
+ *     dcf - filter to check
+ *
+ * Returns:
+ *     size of all filters' buckets in bytes
+ */
+size_t dcuckoo_memory(dcuckoo dcf) {
+	return dcf.count * cuckoo_memory(dcf.filters[0]);
+}
+
+/* filter_count() - number of fingerprints held by one filter of the chain
+ */
+static size_t filter_count(const cuckoofilter *cf) {
+	return cf->total_insertions + cf->stash_count;
+}
+
+/* dcuckoo_count() - number of fingerprints held by a dynamic cuckoo filter
+ *
+ * Args:
+ *     dcf - filter to check
+ *
+ * Returns:
+ *     number of fingerprints in all filters of the chain
+ */
+size_t dcuckoo_count(dcuckoo dcf) {
+	size_t count = 0;
+
+	for (size_t i = 0; i < dcf.count; i++) {
+		count += filter_count(&dcf.filters[i]);
+	}
+
+	return count;
+}
+
+/* dcuckoo_load_factor() - percentage of all slots in the chain holding a
+ *                         fingerprint
+ *
+ * Args:
+ *     dcf - filter to check
+ *
+ * Returns:
+ *     load factor, 0.0 through 100.0
+ */
+double dcuckoo_load_factor(dcuckoo dcf) {
+	size_t slots = dcf.count * dcf.num_buckets * dcf.bucket_size;
+
+	return ((double)dcuckoo_count(dcf) / (double)slots) * 100.0;
+}
+
+/* dcuckoo_add() - add an element to the newest filter of the chain, adding
+ *                 a filter if it is full
+ *
+ * Args:
+ *     dcf - filter to add element to
+ *     key - element to add
+ *     len - length of element in bytes
+ *
+ * Returns:
+ *     true if element was added
+ *     false if unable to allocate memory for a new filter
+ */
+bool dcuckoo_add(dcuckoo *dcf, void *key, size_t len) {
+	size_t   index;
+	uint16_t fingerprint;
+
+	cuckoo_fingerprint(dcf->filters[0], key, len, &index, &fingerprint);
+
+	if (cuckoo_add_fingerprint(&dcf->filters[dcf->count - 1], index, fingerprint)) {
+		return true;
+	}
+
+	if (grow(dcf) == false) {
+		return false;
+	}
+
+	return cuckoo_add_fingerprint(&dcf->filters[dcf->count - 1], index, fingerprint);
+}
+
+/* dcuckoo_add_string() - helper function to add string elements
+ *
+ * Args:
+ *     dcf - filter to add element to
+ *     key - string to add
+ *
+ * Returns:
+ *     true if element was added
+ *     false if unable to allocate memory for a new filter
+ */
+bool dcuckoo_add_string(dcuckoo *dcf, char *key) {
+	return dcuckoo_add(dcf, key, strlen(key));
+}
+
+/* dcuckoo_lookup() - check if an element is likely in any filter of the
+ *                    chain
+ *
+ * Args:
+ *     dcf - filter to use
+ *     key - element to look up
+ *     len - length of element in bytes
+ *
+ * Returns:
+ *     true if element is probably in the filter
+ *     false if element is definitely not in the filter
+ */
+bool dcuckoo_lookup(dcuckoo dcf, void *key, size_t len) {
+	size_t   index;
+	uint16_t fingerprint;
+
+	cuckoo_fingerprint(dcf.filters[0], key, len, &index, &fingerprint);
+
+	for (size_t i = dcf.count; i-- > 0;) {
+		if (cuckoo_lookup_fingerprint(dcf.filters[i], index, fingerprint)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* dcuckoo_lookup_string() - helper function to look up string elements
+ *
+ * Args:
+ *     dcf - filter to use
+ *     key - string to look up
+ *
+ * Returns:
+ *     true if element is probably in the filter
+ *     false if element is definitely not in the filter
+ */
+bool dcuckoo_lookup_string(dcuckoo dcf, char *key) {
+	return dcuckoo_lookup(dcf, key, strlen(key));
+}
+
+/* shrink() - merge the emptiest filter into the rest of the chain and free
+ *            it, once all fingerprints would fit in one filter fewer at
+ *            DCUCKOO_SHRINK_LOAD. if the others run out of room part way,
+ *            the filter is kept with whatever wasn't moved.
+ */
+static void shrink(dcuckoo *dcf) {
+	size_t slots = dcf->num_buckets * dcf->bucket_size;
+
+	if (dcf->count < 2 ||
+		dcuckoo_count(*dcf) > (dcf->count - 1) * slots * DCUCKOO_SHRINK_LOAD / 100.0) {
+		return;
+	}
+
+	size_t emptiest = 0;
+	for (size_t i = 1; i < dcf->count; i++) {
+		if (filter_count(&dcf->filters[i]) < filter_count(&dcf->filters[emptiest])) {
+			emptiest = i;
+		}
+	}
+
+	for (size_t i = dcf->count; i-- > 0;) {
+		if (i != emptiest && cuckoo_merge(&dcf->filters[i], &dcf->filters[emptiest])) {
+			break;
+		}
+	}
+
+	if (filter_count(&dcf->filters[emptiest]) != 0) {
+		return;
+	}
+
+	cuckoo_destroy(dcf->filters[emptiest]);
+	memmove(&dcf->filters[emptiest], &dcf->filters[emptiest + 1],
+			(dcf->count - emptiest - 1) * sizeof(cuckoofilter));
+	dcf->count--;
+}
+
+/* dcuckoo_remove() - remove an element from the chain, shrinking the chain
+ *                    if it has become sparse enough
+ *
+ * Args:
+ *     dcf - filter to remove element from
+ *     key - element to remove
+ *     len - length of element in bytes
+ *
+ * Returns:
+ *     true if a matching fingerprint was removed
+ *     false if element was not found
+ */
+bool dcuckoo_remove(dcuckoo *dcf, void *key, size_t len) {
+	size_t   index;
+	uint16_t fingerprint;
+
+	cuckoo_fingerprint(dcf->filters[0], key, len, &index, &fingerprint);
+
+	for (size_t i = dcf->count; i-- > 0;) {
+		if (cuckoo_remove_fingerprint(&dcf->filters[i], index, fingerprint)) {
+			shrink(dcf);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* dcuckoo_remove_string() - helper function to remove string elements
+ *
+ * Args:
+ *     dcf - filter to remove element from
+ *     key - string to remove
+ *
+ * Returns:
+ *     true if a matching fingerprint was removed
+ *     false if element was not found
+ */
+bool dcuckoo_remove_string(dcuckoo *dcf, char *key) {
+	return dcuckoo_remove(dcf, key, strlen(key));
+}
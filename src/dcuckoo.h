@@ -0,0 +1,46 @@
+/* dcuckoo.h
+ */
+#ifndef DCUCKOO_H
+#define DCUCKOO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cuckoo.h"
+
+/* DCUCKOO_SHRINK_LOAD -- a chain is compacted after removals once all of
+ *                        its fingerprints would fit in one filter fewer at
+ *                        this load factor (percent).
+ */
+#define DCUCKOO_SHRINK_LOAD 50.0
+
+/* dcuckoo -- dynamic cuckoo filter. a chain of cuckoo filters of the same
+ *            geometry, which grows by a filter when the newest one fills
+ *            up, and shrinks by merging the emptiest filter into the rest.
+ */
+typedef struct {
+	size_t        num_buckets;       /* buckets per filter */
+	size_t        bucket_size;       /* 2, 4, or 8 */
+	size_t        max_kicks;
+	size_t        fingerprint_bits;  /* 8, 12, or 16 */
+	int           flags;             /* CUCKOO_* flags for each filter */
+	size_t        count;             /* number of filters in chain */
+	size_t        capacity;          /* number of filters allocated */
+	cuckoofilter *filters;           /* chain of filters, oldest first */
+} dcuckoo;
+
+/* function definitions
+ */
+bool   dcuckoo_init(dcuckoo *, size_t, size_t, size_t, size_t, int);
+void   dcuckoo_destroy(dcuckoo);
+size_t dcuckoo_memory(dcuckoo);
+size_t dcuckoo_count(dcuckoo);
+double dcuckoo_load_factor(dcuckoo);
+bool   dcuckoo_add(dcuckoo *, void *, size_t);
+bool   dcuckoo_add_string(dcuckoo *, char *);
+bool   dcuckoo_lookup(dcuckoo, void *, size_t);
+bool   dcuckoo_lookup_string(dcuckoo, char *);
+bool   dcuckoo_remove(dcuckoo *, void *, size_t);
+bool   dcuckoo_remove_string(dcuckoo *, char *);
+
+#endif /* DCUCKOO_H */
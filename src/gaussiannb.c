@@ -1,17 +1,25 @@
 /* gaussiannb.c
- * TODO: save/load models
- * TODO: multi-threaded log calculations for gaussiannb_predict() ?
  */
+#include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <stdbool.h>
 #include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 #include "gaussiannb.h"
+#include "gnbcore.h"
 
 bool gaussiannb_init(gaussiannb *gnb, size_t num_classes, size_t num_features) {
 	gnb->num_classes  = num_classes;
 	gnb->num_features = num_features;
 	gnb->num_samples  = 0;
+	gnb->mapping      = NULL;
+	gnb->mapping_size = 0;
 	gnb->classes      = calloc(num_classes, sizeof(gaussiannbclass));
 
 	if (gnb->classes == NULL) {
@@ -26,15 +34,50 @@ bool gaussiannb_init(gaussiannb *gnb, size_t num_classes, size_t num_features) {
 	return true;
 }
 
-void gaussiannb_destroy(gaussiannb gnb) {
-	if (gnb.num_classes > 0) {
-		free(gnb.classes[0].mean);
-		free(gnb.classes[0].variance);
+/* release_class_arrays() - free the per-class arrays allocated by
+ *                          training or gaussiannb_load(), or unmap those
+ *                          of a model mapped by gaussiannb_map()
+ */
+static void release_class_arrays(gaussiannb *gnb) {
+	if (gnb->mapping != NULL) {
+		munmap(gnb->mapping, gnb->mapping_size);
+		gnb->mapping      = NULL;
+		gnb->mapping_size = 0;
+	} else if (gnb->num_classes > 0) {
+		free(gnb->classes[0].mean);
+		free(gnb->classes[0].variance);
+		free(gnb->classes[0].inv_two_var);
 	}
+}
 
+void gaussiannb_destroy(gaussiannb gnb) {
+	release_class_arrays(&gnb);
 	free(gnb.classes);
 }
 
+/* refresh_class() - recompute a class's cached predict constants after its
+ *                   prior, weight, or variances change. with these,
+ *                   gaussiannb_predict() evaluates each class's log
+ *                   likelihood directly, without exp() or log() per feature.
+ */
+static void refresh_class(gaussiannb *gnb, size_t c) {
+	gaussiannbclass *cls = &gnb->classes[c];
+
+	cls->log_prior = log(cls->prior * cls->weight + GNB_EPSILON);
+
+	if (cls->variance == NULL) { // not trained yet
+		return;
+	}
+
+	cls->log_norm = 0.0;
+	for (size_t j = 0; j < gnb->num_features; j++) {
+		double var = cls->variance[j] + GNB_EPSILON;
+
+		cls->inv_two_var[j] = 1.0 / (2 * var);
+		cls->log_norm      += log(GNB_NORMALIZING_CONSTANT) - 0.5 * log(var);
+	}
+}
+
 static void calculate_class_mean(gaussiannbclass *cls, double **X, int *y, size_t num_samples, size_t num_features, int class_label) {
 	size_t count = 0;
 
@@ -76,28 +119,53 @@ static void calculate_class_variance(gaussiannbclass *cls, double **X, int *y, s
 	}
 }
 
+/* alloc_class_arrays() - give every class fresh, zeroed mean, variance,
+ *                        and cached constant arrays, releasing any from an
+ *                        earlier training run.
+ *
+ * Args:
+ *     gnb - model
+ *
+ * Returns:
+ *     true on success
+ *     false if unable to allocate memory. the model is unchanged.
+ */
+static bool alloc_class_arrays(gaussiannb *gnb) {
+	size_t  bufsiz      = gnb->num_classes * gnb->num_features;
+	double *means       = calloc(bufsiz, sizeof(double));
+	double *variances   = calloc(bufsiz, sizeof(double));
+	double *inv_two_var = calloc(bufsiz, sizeof(double));
+
+	if (means == NULL || variances == NULL || inv_two_var == NULL) {
+		free(means);
+		free(variances);
+		free(inv_two_var);
+		return false;
+	}
+
+	release_class_arrays(gnb);
+
+	for (size_t ci = 0; ci < gnb->num_classes; ci++) {
+		gnb->classes[ci].mean        = means + (ci * gnb->num_features);
+		gnb->classes[ci].variance    = variances + (ci * gnb->num_features);
+		gnb->classes[ci].inv_two_var = inv_two_var + (ci * gnb->num_features);
+	}
+
+	return true;
+}
+
 void gaussiannb_train(gaussiannb *gnb, double **X, int *y, size_t num_samples) {
 	if (num_samples == 0) {
 		return;
 	}
 
-	size_t  bufsiz    = gnb->num_classes * gnb->num_features;
-	double *means     = calloc(bufsiz, sizeof(double));
-	double *variances = calloc(bufsiz, sizeof(double));
-
-	if (means == NULL || variances == NULL) {
-		if (means != NULL) { free(means); }
-		if (variances != NULL) { free(variances); }
+	if (alloc_class_arrays(gnb) == false) {
 		return;
 	}
 
 	gnb->num_samples += num_samples; // needed for online learning
 
 	for (size_t ci = 0; ci < gnb->num_classes; ci++) {
-		gnb->classes[ci].count    = 0;
-		gnb->classes[ci].mean     = means + (ci * gnb->num_features);
-		gnb->classes[ci].variance = variances + (ci * gnb->num_features);
-
 		calculate_class_mean(&gnb->classes[ci],
 							 X,
 							 y,
@@ -115,23 +183,162 @@ void gaussiannb_train(gaussiannb *gnb, double **X, int *y, size_t num_samples) {
 
 		// laplace smoothing using class weight
 		gnb->classes[ci].prior = (gnb->classes[ci].count + gnb->classes[ci].weight) / (num_samples + gnb->num_classes);
+
+		refresh_class(gnb, ci);
 	}
 }
 
-int gaussiannb_predict(gaussiannb *gnb, double *X) {
+/* stats_finish() - turn running statistics into a trained model, the same
+ *                  way gaussiannb_train() finishes each class.
+ */
+static void stats_finish(gaussiannb *gnb, const gnbstats *stats, size_t num_samples) {
+	gnb->num_samples += num_samples;
+
+	for (size_t ci = 0; ci < gnb->num_classes; ci++) {
+		gaussiannbclass *cls  = &gnb->classes[ci];
+		size_t           base = ci * gnb->num_features;
+
+		cls->count = stats->rows[ci];
+
+		for (size_t fi = 0; fi < gnb->num_features; fi++) {
+			cls->mean[fi]     = stats->mean[base + fi];
+			cls->variance[fi] = gnb_stats_variance(stats, ci, base + fi);
+		}
+
+		// laplace smoothing using class weight
+		cls->prior = (cls->count + cls->weight) / (num_samples + gnb->num_classes);
+
+		refresh_class(gnb, ci);
+	}
+}
+
+/* gaussiannb_train_contiguous() - train a model from a contiguous row-major
+ *                                 matrix in a single pass over the data.
+ *                                 unlike gaussiannb_train(), X is left
+ *                                 untouched: NaN features are skipped,
+ *                                 which is the same as imputing the class
+ *                                 mean. large inputs are split across
+ *                                 threads, and their statistics merged.
+ *
+ * Args:
+ *     gnb         - model
+ *     X           - num_samples rows of num_features doubles, row-major
+ *     y           - class label of each row
+ *     num_samples - number of rows in X
+ *
+ * Returns:
+ *     true on success
+ *     false if unable to allocate memory
+ */
+bool gaussiannb_train_contiguous(gaussiannb *gnb, const double *X, const int *y, size_t num_samples) {
+	gnbstats stats;
+
+	if (num_samples == 0) {
+		return true;
+	}
+
+	if (gnb_stats_collect(&stats, X, sizeof(double), y, num_samples, gnb->num_classes, gnb->num_features) == false) {
+		return false;
+	}
+
+	if (alloc_class_arrays(gnb) == false) {
+		gnb_stats_destroy(&stats);
+		return false;
+	}
+
+	stats_finish(gnb, &stats, num_samples);
+	gnb_stats_destroy(&stats);
+
+	return true;
+}
+
+/* gaussiannb_merge() - combine a model trained on another shard of data
+ *                      into this one, as if both had been trained on the
+ *                      union of their samples. each class's sum of squared
+ *                      deviations is recovered from its variance, and
+ *                      means are weighted by class counts, so the result
+ *                      is exact for models built by gaussiannb_train() or
+ *                      gaussiannb_train_contiguous() from data without
+ *                      NaNs. it is approximate when training skipped NaN
+ *                      features, whose per-feature counts models don't
+ *                      keep, and for models changed with
+ *                      gaussiannb_update(). class weights of gnb are kept.
+ *
+ * Args:
+ *     gnb   - model to merge into. may be untrained
+ *     other - model to merge from
+ *
+ * Returns:
+ *     true on success
+ *     false if the models' shapes differ, or unable to allocate memory
+ */
+bool gaussiannb_merge(gaussiannb *gnb, const gaussiannb *other) {
+	if (gnb->num_classes != other->num_classes || gnb->num_features != other->num_features) {
+		return false;
+	}
+
+	if (other->num_classes == 0 || other->classes[0].mean == NULL) { // nothing to add
+		return true;
+	}
+
+	if (gnb->classes[0].mean == NULL && alloc_class_arrays(gnb) == false) {
+		return false;
+	}
+
+	gnb->num_samples += other->num_samples;
+
+	for (size_t ci = 0; ci < gnb->num_classes; ci++) {
+		gaussiannbclass       *cls = &gnb->classes[ci];
+		const gaussiannbclass *src = &other->classes[ci];
+
+		for (size_t fi = 0; fi < gnb->num_features; fi++) {
+			size_t n   = cls->count;
+			double m2  = (cls->count == 0) ? 0.0 : (cls->variance[fi] - GNB_ALPHA) * cls->count;
+			double m2b = (src->count == 0) ? 0.0 : (src->variance[fi] - GNB_ALPHA) * src->count;
+
+			gnb_merge_moments(&n, &cls->mean[fi], &m2, src->count, src->mean[fi], m2b);
+			cls->variance[fi] = (n == 0) ? GNB_EPSILON : (m2 / n) + GNB_ALPHA;
+		}
+
+		cls->count += src->count;
+
+		// laplace smoothing using class weight
+		cls->prior = (cls->count + cls->weight) / (gnb->num_samples + gnb->num_classes);
+
+		refresh_class(gnb, ci);
+	}
+
+	return true;
+}
+
+/* predict_row() - score one sample against every class. gaussiannb_predict()
+ *                 and the scalar batch path share this, so both produce
+ *                 identical results.
+ *
+ * Args:
+ *     gnb           - model
+ *     X             - sample's features
+ *     log_posterior - if not NULL, receives each class's log posterior
+ *
+ * Returns:
+ *     index of the most likely class, -1 if there are no classes.
+ */
+static int predict_row(const gaussiannb *gnb, const double *X, double *log_posterior) {
 	double best_posterior = -INFINITY;
 	int    best_class     = -1;
 
 	for (size_t c = 0; c < gnb->num_classes; c++) {
-		double log_prob = log(gnb->classes[c].prior * gnb->classes[c].weight + GNB_EPSILON);
+		const gaussiannbclass *cls      = &gnb->classes[c];
+		double                 log_prob = cls->log_prior + cls->log_norm;
 
-		// calculate log(probabilities) of features
+		// log of each feature's gaussian pdf, less the constant part
 		for (size_t j = 0; j < gnb->num_features; j++) {
-			double mean = gnb->classes[c].mean[j];
-			double var  = gnb->classes[c].variance[j] + GNB_EPSILON;
-			double diff = X[j] - mean;
-			double prob = GNB_NORMALIZING_CONSTANT * exp(-(diff * diff) / (2 * var));
-			log_prob += log(prob);
+			double diff = X[j] - cls->mean[j];
+			log_prob -= diff * diff * cls->inv_two_var[j];
+		}
+
+		if (log_posterior != NULL) {
+			log_posterior[c] = log_prob;
 		}
 
 		if (log_prob > best_posterior) {
@@ -143,6 +350,466 @@ int gaussiannb_predict(gaussiannb *gnb, double *X) {
 	return best_class;
 }
 
+int gaussiannb_predict(gaussiannb *gnb, double *X) {
+	return predict_row(gnb, X, NULL);
+}
+
+static void predict_rows_scalar(const gaussiannb *gnb, const double *X, size_t first, size_t last, int *predictions, double *log_posteriors) {
+	for (size_t i = first; i < last; i++) {
+		predictions[i] = predict_row(gnb,
+									 X + i * gnb->num_features,
+									 log_posteriors ? log_posteriors + i * gnb->num_classes : NULL);
+	}
+}
+
+#ifdef GNB_X86
+/* predict_rows_avx2() - score four samples at a time, one per lane. each
+ *                       lane performs the same operations in the same order
+ *                       as predict_row(), so results match it exactly.
+ *                       rows are transposed into a scratch block first, so
+ *                       every class reads them with aligned loads.
+ */
+__attribute__((target("avx2")))
+static void predict_rows_avx2(const gaussiannb *gnb, const double *X, size_t first, size_t last, int *predictions, double *log_posteriors) {
+	size_t  nf    = gnb->num_features;
+	size_t  nc    = gnb->num_classes;
+	double *block = aligned_alloc(32, (nf * 4 * sizeof(double) + 31) & ~(size_t)31);
+
+	if (block == NULL) {
+		predict_rows_scalar(gnb, X, first, last, predictions, log_posteriors);
+		return;
+	}
+
+	size_t i;
+	for (i = first; i + 4 <= last; i += 4) {
+		const double *r0 = X + i * nf;
+
+		for (size_t j = 0; j < nf; j++) {
+			block[j * 4 + 0] = r0[j];
+			block[j * 4 + 1] = r0[nf + j];
+			block[j * 4 + 2] = r0[2 * nf + j];
+			block[j * 4 + 3] = r0[3 * nf + j];
+		}
+
+		__m256d best       = _mm256_set1_pd(-INFINITY);
+		__m256d best_class = _mm256_set1_pd(-1.0);
+
+		for (size_t c = 0; c < nc; c++) {
+			const gaussiannbclass *cls      = &gnb->classes[c];
+			__m256d                log_prob = _mm256_set1_pd(cls->log_prior + cls->log_norm);
+
+			for (size_t j = 0; j < nf; j++) {
+				__m256d diff = _mm256_sub_pd(_mm256_load_pd(block + j * 4), _mm256_set1_pd(cls->mean[j]));
+				log_prob = _mm256_sub_pd(log_prob, _mm256_mul_pd(_mm256_mul_pd(diff, diff), _mm256_set1_pd(cls->inv_two_var[j])));
+			}
+
+			if (log_posteriors != NULL) {
+				double lp[4];
+
+				_mm256_storeu_pd(lp, log_prob);
+				for (size_t k = 0; k < 4; k++) {
+					log_posteriors[(i + k) * nc + c] = lp[k];
+				}
+			}
+
+			// strictly greater, so ties and NaNs keep the earlier class
+			__m256d better = _mm256_cmp_pd(log_prob, best, _CMP_GT_OQ);
+			best       = _mm256_blendv_pd(best, log_prob, better);
+			best_class = _mm256_blendv_pd(best_class, _mm256_set1_pd((double)c), better);
+		}
+
+		double classes[4];
+		_mm256_storeu_pd(classes, best_class);
+		for (size_t k = 0; k < 4; k++) {
+			predictions[i + k] = (int)classes[k];
+		}
+	}
+
+	free(block);
+
+	predict_rows_scalar(gnb, X, i, last, predictions, log_posteriors);
+}
+#endif /* GNB_X86 */
+
+/* rows_kernel_t -- scores rows first through last-1 of a batch, writing a
+ *                  class index and per-row values for each. the predict
+ *                  and Mahalanobis kernels share this shape, and the
+ *                  threading in run_batch().
+ */
+typedef void (*rows_kernel_t)(const gaussiannb *, const double *, size_t, size_t, int *, double *);
+
+/* predict_rows -- batch predict kernel, chosen at runtime by the CPU's
+ *                 features.
+ */
+static rows_kernel_t predict_rows = NULL;
+
+static rows_kernel_t select_predict_rows() {
+	rows_kernel_t kernel = __atomic_load_n(&predict_rows, __ATOMIC_RELAXED);
+
+	if (kernel == NULL) {
+#ifdef GNB_X86
+		if (gnb_use_avx2()) {
+			kernel = predict_rows_avx2;
+		}
+#endif
+		if (kernel == NULL) {
+			kernel = predict_rows_scalar;
+		}
+
+		__atomic_store_n(&predict_rows, kernel, __ATOMIC_RELAXED);
+	}
+
+	return kernel;
+}
+
+typedef struct {
+	const gaussiannb *gnb;
+	const double     *X;
+	int              *classes;
+	double           *values;
+	rows_kernel_t     kernel;
+} batch_job;
+
+static void batch_share(void *arg, size_t share, size_t first, size_t last) {
+	batch_job *job = arg;
+
+	(void)share;
+	job->kernel(job->gnb, job->X, first, last, job->classes, job->values);
+}
+
+/* run_batch() - run a batch kernel over num_samples rows, splitting large
+ *               batches across threads.
+ */
+static void run_batch(const gaussiannb *gnb, const double *X, size_t num_samples, int *classes, double *values, rows_kernel_t kernel) {
+	batch_job job = {
+		.gnb     = gnb,
+		.X       = X,
+		.classes = classes,
+		.values  = values,
+		.kernel  = kernel,
+	};
+
+	gnb_run_shares(gnb_batch_threads(num_samples), num_samples, batch_share, &job);
+}
+
+/* gaussiannb_predict_batch() - predict classes for many samples at once.
+ *                              large batches are split across threads.
+ *                              results match gaussiannb_predict() exactly.
+ *
+ * Args:
+ *     gnb            - model
+ *     X              - num_samples rows of num_features doubles, row-major
+ *     num_samples    - number of rows in X
+ *     predictions    - receives num_samples predicted class indexes
+ *     log_posteriors - if not NULL, receives num_samples rows of
+ *                      num_classes unnormalized log posteriors, row-major
+ *
+ * Returns:
+ *     Nothing
+ */
+void gaussiannb_predict_batch(gaussiannb *gnb, const double *X, size_t num_samples, int *predictions, double *log_posteriors) {
+	run_batch(gnb, X, num_samples, predictions, log_posteriors, select_predict_rows());
+}
+
+/* distance_row() - smallest Mahalanobis distance from a sample to any
+ *                  class. the division per feature is replaced with the
+ *                  cached inv_two_var: 1 / variance is 2 * inv_two_var.
+ *
+ * Args:
+ *     gnb     - model
+ *     X       - sample's features
+ *     nearest - if not NULL, receives the index of the nearest class
+ *
+ * Returns:
+ *     distance to the nearest class, INFINITY if there are no classes
+ */
+static double distance_row(const gaussiannb *gnb, const double *X, int *nearest) {
+	double best       = INFINITY;
+	int    best_class = -1;
+
+	for (size_t c = 0; c < gnb->num_classes; c++) {
+		const gaussiannbclass *cls      = &gnb->classes[c];
+		double                 distance = 0.0;
+
+		for (size_t j = 0; j < gnb->num_features; j++) {
+			double diff = X[j] - cls->mean[j];
+			distance += diff * diff * (2 * cls->inv_two_var[j]);
+		}
+
+		if (distance < best) {
+			best       = distance;
+			best_class = c;
+		}
+	}
+
+	if (nearest != NULL) {
+		*nearest = best_class;
+	}
+
+	return sqrt(best);
+}
+
+static void distance_rows_scalar(const gaussiannb *gnb, const double *X, size_t first, size_t last, int *nearest, double *distances) {
+	for (size_t i = first; i < last; i++) {
+		distances[i] = distance_row(gnb, X + i * gnb->num_features, nearest ? nearest + i : NULL);
+	}
+}
+
+#ifdef GNB_X86
+/* distance_rows_avx2() - Mahalanobis distances for four samples at a time,
+ *                        one per lane, in the same order of operations as
+ *                        distance_row().
+ */
+__attribute__((target("avx2")))
+static void distance_rows_avx2(const gaussiannb *gnb, const double *X, size_t first, size_t last, int *nearest, double *distances) {
+	size_t  nf    = gnb->num_features;
+	size_t  nc    = gnb->num_classes;
+	double *block = aligned_alloc(32, (nf * 4 * sizeof(double) + 31) & ~(size_t)31);
+
+	if (block == NULL) {
+		distance_rows_scalar(gnb, X, first, last, nearest, distances);
+		return;
+	}
+
+	size_t i;
+	for (i = first; i + 4 <= last; i += 4) {
+		const double *r0 = X + i * nf;
+
+		for (size_t j = 0; j < nf; j++) {
+			block[j * 4 + 0] = r0[j];
+			block[j * 4 + 1] = r0[nf + j];
+			block[j * 4 + 2] = r0[2 * nf + j];
+			block[j * 4 + 3] = r0[3 * nf + j];
+		}
+
+		__m256d best       = _mm256_set1_pd(INFINITY);
+		__m256d best_class = _mm256_set1_pd(-1.0);
+
+		for (size_t c = 0; c < nc; c++) {
+			const gaussiannbclass *cls      = &gnb->classes[c];
+			__m256d                distance = _mm256_setzero_pd();
+
+			for (size_t j = 0; j < nf; j++) {
+				__m256d diff = _mm256_sub_pd(_mm256_load_pd(block + j * 4), _mm256_set1_pd(cls->mean[j]));
+				distance = _mm256_add_pd(distance, _mm256_mul_pd(_mm256_mul_pd(diff, diff), _mm256_set1_pd(2 * cls->inv_two_var[j])));
+			}
+
+			// strictly less, so ties and NaNs keep the earlier class
+			__m256d closer = _mm256_cmp_pd(distance, best, _CMP_LT_OQ);
+			best       = _mm256_blendv_pd(best, distance, closer);
+			best_class = _mm256_blendv_pd(best_class, _mm256_set1_pd((double)c), closer);
+		}
+
+		_mm256_storeu_pd(distances + i, _mm256_sqrt_pd(best));
+
+		if (nearest != NULL) {
+			double classes[4];
+
+			_mm256_storeu_pd(classes, best_class);
+			for (size_t k = 0; k < 4; k++) {
+				nearest[i + k] = (int)classes[k];
+			}
+		}
+	}
+
+	free(block);
+
+	distance_rows_scalar(gnb, X, i, last, nearest, distances);
+}
+#endif /* GNB_X86 */
+
+/* distance_rows -- batch Mahalanobis kernel, chosen at runtime by the
+ *                  CPU's features.
+ */
+static rows_kernel_t distance_rows = NULL;
+
+static rows_kernel_t select_distance_rows() {
+	rows_kernel_t kernel = __atomic_load_n(&distance_rows, __ATOMIC_RELAXED);
+
+	if (kernel == NULL) {
+#ifdef GNB_X86
+		if (gnb_use_avx2()) {
+			kernel = distance_rows_avx2;
+		}
+#endif
+		if (kernel == NULL) {
+			kernel = distance_rows_scalar;
+		}
+
+		__atomic_store_n(&distance_rows, kernel, __ATOMIC_RELAXED);
+	}
+
+	return kernel;
+}
+
+/* gaussiannb_mahalanobis_batch() - score many samples for anomaly
+ *                                  detection at once: each sample's
+ *                                  Mahalanobis distance to its nearest
+ *                                  class. large batches are split across
+ *                                  threads.
+ *
+ * Args:
+ *     gnb         - model
+ *     X           - num_samples rows of num_features doubles, row-major
+ *     num_samples - number of rows in X
+ *     distances   - receives num_samples distances. samples with NaN
+ *                   features are no nearer any class, and score INFINITY
+ *     nearest     - if not NULL, receives num_samples nearest class indexes,
+ *                   -1 for samples scoring INFINITY
+ *
+ * Returns:
+ *     Nothing
+ */
+void gaussiannb_mahalanobis_batch(gaussiannb *gnb, const double *X, size_t num_samples, double *distances, int *nearest) {
+	run_batch(gnb, X, num_samples, nearest, distances, select_distance_rows());
+}
+
+/* gaussiannb_topk_init() - create an empty streaming top-k set of the most
+ *                          anomalous samples
+ *
+ * Args:
+ *     topk - set to initialize
+ *     k    - number of samples to keep
+ *
+ * Returns:
+ *     true on success
+ *     false if k is 0 or unable to allocate memory
+ */
+bool gaussiannb_topk_init(gaussiannbtopk *topk, size_t k) {
+	topk->k     = k;
+	topk->count = 0;
+	topk->seen  = 0;
+	topk->heap  = (k > 0) ? malloc(k * sizeof(gaussiannbanomaly)) : NULL;
+
+	return topk->heap != NULL;
+}
+
+void gaussiannb_topk_destroy(gaussiannbtopk topk) {
+	free(topk.heap);
+}
+
+/* topk_sift_down() - restore the min-heap below 'i', so the least
+ *                    anomalous kept sample stays at the root
+ */
+static void topk_sift_down(gaussiannbtopk *topk, size_t i) {
+	gaussiannbanomaly *heap = topk->heap;
+
+	for (;;) {
+		size_t smallest = i;
+		size_t left     = 2 * i + 1;
+		size_t right    = 2 * i + 2;
+
+		if (left < topk->count && heap[left].distance < heap[smallest].distance) {
+			smallest = left;
+		}
+		if (right < topk->count && heap[right].distance < heap[smallest].distance) {
+			smallest = right;
+		}
+		if (smallest == i) {
+			return;
+		}
+
+		gaussiannbanomaly tmp = heap[i];
+		heap[i]        = heap[smallest];
+		heap[smallest] = tmp;
+		i              = smallest;
+	}
+}
+
+static void topk_push(gaussiannbtopk *topk, double distance, size_t index) {
+	gaussiannbanomaly *heap = topk->heap;
+
+	// NaN compares false against everything and would break the heap's
+	// ordering. rank it like a sample with no nearest class.
+	if (isnan(distance)) {
+		distance = INFINITY;
+	}
+
+	if (topk->count < topk->k) {
+		size_t i = topk->count++;
+
+		// sift up
+		while (i > 0 && heap[(i - 1) / 2].distance > distance) {
+			heap[i] = heap[(i - 1) / 2];
+			i       = (i - 1) / 2;
+		}
+		heap[i] = (gaussiannbanomaly) { distance, index };
+		return;
+	}
+
+	// most samples are ordinary, and stop here
+	if (!(distance > heap[0].distance)) {
+		return;
+	}
+
+	heap[0] = (gaussiannbanomaly) { distance, index };
+	topk_sift_down(topk, 0);
+}
+
+/* gaussiannb_mahalanobis_topk() - score a batch of samples from a stream,
+ *                                 keeping the k most anomalous samples seen
+ *                                 across every call. samples are numbered
+ *                                 in stream order, starting at 0. samples
+ *                                 with NaN features rank as infinitely
+ *                                 anomalous.
+ *
+ * Args:
+ *     gnb         - model
+ *     X           - num_samples rows of num_features doubles, row-major
+ *     num_samples - number of rows in X
+ *     topk        - set created with gaussiannb_topk_init()
+ *
+ * Returns:
+ *     true on success
+ *     false if unable to allocate memory. the set is unchanged.
+ */
+bool gaussiannb_mahalanobis_topk(gaussiannb *gnb, const double *X, size_t num_samples, gaussiannbtopk *topk) {
+	double *distances = malloc(num_samples * sizeof(double));
+
+	if (distances == NULL && num_samples > 0) {
+		return false;
+	}
+
+	gaussiannb_mahalanobis_batch(gnb, X, num_samples, distances, NULL);
+
+	for (size_t i = 0; i < num_samples; i++) {
+		topk_push(topk, distances[i], topk->seen + i);
+	}
+
+	topk->seen += num_samples;
+	free(distances);
+
+	return true;
+}
+
+static int compare_anomalies(const void *a, const void *b) {
+	const gaussiannbanomaly *x = a;
+	const gaussiannbanomaly *y = b;
+
+	if (x->distance != y->distance) {
+		return (x->distance < y->distance) ? 1 : -1;
+	}
+
+	return (x->index > y->index) - (x->index < y->index);
+}
+
+/* gaussiannb_topk_results() - copy out the most anomalous samples kept so
+ *                             far, most anomalous first
+ *
+ * Args:
+ *     topk    - set to read
+ *     results - receives up to k samples
+ *
+ * Returns:
+ *     number of samples written to results
+ */
+size_t gaussiannb_topk_results(gaussiannbtopk topk, gaussiannbanomaly *results) {
+	memcpy(results, topk.heap, topk.count * sizeof(gaussiannbanomaly));
+	qsort(results, topk.count, sizeof(gaussiannbanomaly), compare_anomalies);
+
+	return topk.count;
+}
+
 double gaussiannb_mahalanobis_distance(gaussiannb *gnb, double *X, size_t class_index) {
 	double distance = 0.0;
 
@@ -174,11 +841,383 @@ void gaussiannb_update(gaussiannb *gnb, double *X, int y, bool new) {
 
 	gnb->classes[y].count++;
 	gnb->classes[y].prior = (double)gnb->classes[y].count / gnb->num_samples;
+
+	refresh_class(gnb, y);
 }
 
 void gaussiannb_adjust_weight(gaussiannb *gnb, int ci, double weight) {
 	if (ci >= 0 && ci < gnb->num_classes) {
 		gnb->classes[ci].weight = weight;
+		refresh_class(gnb, ci);
 	}
 	// class_index out of range ...
 }
+
+/* put_le(), get_le() -- store and fetch little-endian integers of 'bytes'
+ *     bytes, so files are the same on every host
+ */
+static void put_le(uint8_t *p, uint64_t value, int bytes) {
+	for (int i = 0; i < bytes; i++) {
+		p[i] = value >> (8 * i);
+	}
+}
+
+static uint64_t get_le(const uint8_t *p, int bytes) {
+	uint64_t value = 0;
+
+	for (int i = 0; i < bytes; i++) {
+		value |= (uint64_t)p[i] << (8 * i);
+	}
+
+	return value;
+}
+
+static void put_double(uint8_t *p, double value) {
+	uint64_t bits;
+
+	memcpy(&bits, &value, sizeof(bits));
+	put_le(p, bits, 8);
+}
+
+static double get_double(const uint8_t *p) {
+	uint64_t bits  = get_le(p, 8);
+	double   value;
+
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+#define GNB_CLASS_RECORD 40 // bytes per class table entry
+#define GNB_ALIGN_UP(x)  (((x) + GNB_FILE_ALIGN - 1) & ~(uint64_t)(GNB_FILE_ALIGN - 1))
+
+/* gnblayout -- where each part of a model lives in its file
+ */
+typedef struct {
+	uint64_t table;
+	uint64_t means;
+	uint64_t variances;
+	uint64_t inv_two_var;
+	uint64_t size;
+} gnblayout;
+
+/* file_layout() - compute the file layout for a model's dimensions. see
+ *                 gaussiannb.h for the format.
+ *
+ * Returns:
+ *     true if a model of this size can be stored
+ *     false if the dimensions are zero or too large
+ */
+static bool file_layout(uint64_t num_classes, uint64_t num_features, gnblayout *layout) {
+	if (num_classes == 0 || num_features == 0 ||
+		num_classes > UINT32_MAX || num_features > UINT32_MAX ||
+		num_classes * num_features > SIZE_MAX / sizeof(double) / 4) {
+		return false;
+	}
+
+	uint64_t array = GNB_ALIGN_UP(num_classes * num_features * sizeof(double));
+
+	layout->table       = GNB_FILE_ALIGN;
+	layout->means       = layout->table + GNB_ALIGN_UP(num_classes * GNB_CLASS_RECORD);
+	layout->variances   = layout->means + array;
+	layout->inv_two_var = layout->variances + array;
+	layout->size        = layout->inv_two_var + array;
+
+	return true;
+}
+
+/* write_doubles(), read_doubles() - copy arrays of doubles to and from a
+ *     file, converting to and from little-endian through a small buffer
+ */
+static bool write_doubles(FILE *fp, const double *values, size_t count) {
+	uint8_t buf[4096];
+
+	for (size_t i = 0; i < count; ) {
+		size_t chunk = count - i < sizeof(buf) / 8 ? count - i : sizeof(buf) / 8;
+
+		for (size_t k = 0; k < chunk; k++) {
+			put_double(buf + k * 8, values[i + k]);
+		}
+
+		if (fwrite(buf, 8, chunk, fp) != chunk) {
+			return false;
+		}
+
+		i += chunk;
+	}
+
+	return true;
+}
+
+static bool read_doubles(FILE *fp, double *values, size_t count) {
+	uint8_t buf[4096];
+
+	for (size_t i = 0; i < count; ) {
+		size_t chunk = count - i < sizeof(buf) / 8 ? count - i : sizeof(buf) / 8;
+
+		if (fread(buf, 8, chunk, fp) != chunk) {
+			return false;
+		}
+
+		for (size_t k = 0; k < chunk; k++) {
+			values[i + k] = get_double(buf + k * 8);
+		}
+
+		i += chunk;
+	}
+
+	return true;
+}
+
+/* pad_to() - write zeroes until the file position reaches 'offset'
+ */
+static bool pad_to(FILE *fp, uint64_t offset) {
+	static const uint8_t zeroes[GNB_FILE_ALIGN] = { 0 };
+	long                 position = ftell(fp);
+
+	if (position < 0 || (uint64_t)position > offset) {
+		return false;
+	}
+
+	return fwrite(zeroes, 1, offset - position, fp) == offset - position;
+}
+
+/* decode_header() - read and validate a file header and class table,
+ *                   creating a model with the saved dimensions and classes,
+ *                   but no arrays
+ *
+ * Args:
+ *     data      - start of the file: the header and class table
+ *     data_size - bytes available at data
+ *     file_size - size of the whole file
+ *     gnb       - model to create
+ *     layout    - receives the file's layout
+ *
+ * Returns:
+ *     true if the file is valid
+ *     false if it isn't, or unable to allocate memory
+ */
+static bool decode_header(const uint8_t *data, uint64_t data_size, uint64_t file_size, gaussiannb *gnb, gnblayout *layout) {
+	if (data_size < GNB_FILE_ALIGN ||
+		memcmp(data, GNB_FILE_MAGIC, 8) != 0 ||
+		get_le(data + 8, 4) != GNB_FILE_VERSION ||
+		get_le(data + 12, 4) != GNB_FILE_ALIGN ||
+		!file_layout(get_le(data + 16, 8), get_le(data + 24, 8), layout) ||
+		layout->size != file_size ||
+		layout->means > data_size) {
+		return false;
+	}
+
+	if (gaussiannb_init(gnb, get_le(data + 16, 8), get_le(data + 24, 8)) == false) {
+		return false;
+	}
+
+	gnb->num_samples = get_le(data + 32, 8);
+
+	for (size_t ci = 0; ci < gnb->num_classes; ci++) {
+		const uint8_t   *record = data + layout->table + ci * GNB_CLASS_RECORD;
+		gaussiannbclass *cls    = &gnb->classes[ci];
+
+		cls->count     = get_le(record, 8);
+		cls->prior     = get_double(record + 8);
+		cls->weight    = get_double(record + 16);
+		cls->log_prior = get_double(record + 24);
+		cls->log_norm  = get_double(record + 32);
+	}
+
+	return true;
+}
+
+/* gaussiannb_save() - save a trained model to disk in a portable, versioned
+ *                     format that gaussiannb_load() and gaussiannb_map()
+ *                     read back. see gaussiannb.h for the layout.
+ *
+ * Args:
+ *     gnb  - model to save
+ *     path - path to save model
+ *
+ * Returns:
+ *     true on success
+ *     false if the model isn't trained, or unable to write the file
+ */
+bool gaussiannb_save(gaussiannb *gnb, const char *path) {
+	gnblayout layout;
+	uint8_t   header[GNB_FILE_ALIGN] = { 0 };
+	size_t    bufsiz                 = gnb->num_classes * gnb->num_features;
+	FILE     *fp;
+	bool      written;
+
+	if (!file_layout(gnb->num_classes, gnb->num_features, &layout) ||
+		gnb->classes[0].mean == NULL) {
+		return false;
+	}
+
+	fp = fopen(path, "wb");
+	if (fp == NULL) {
+		return false;
+	}
+
+	memcpy(header, GNB_FILE_MAGIC, 8);
+	put_le(header + 8,  GNB_FILE_VERSION, 4);
+	put_le(header + 12, GNB_FILE_ALIGN, 4);
+	put_le(header + 16, gnb->num_classes, 8);
+	put_le(header + 24, gnb->num_features, 8);
+	put_le(header + 32, gnb->num_samples, 8);
+
+	written = fwrite(header, sizeof(header), 1, fp) == 1;
+
+	for (size_t ci = 0; written && ci < gnb->num_classes; ci++) {
+		const gaussiannbclass *cls = &gnb->classes[ci];
+		uint8_t                record[GNB_CLASS_RECORD];
+
+		put_le(record, cls->count, 8);
+		put_double(record + 8,  cls->prior);
+		put_double(record + 16, cls->weight);
+		put_double(record + 24, cls->log_prior);
+		put_double(record + 32, cls->log_norm);
+
+		written = fwrite(record, sizeof(record), 1, fp) == 1;
+	}
+
+	written = written &&
+		pad_to(fp, layout.means)       && write_doubles(fp, gnb->classes[0].mean, bufsiz) &&
+		pad_to(fp, layout.variances)   && write_doubles(fp, gnb->classes[0].variance, bufsiz) &&
+		pad_to(fp, layout.inv_two_var) && write_doubles(fp, gnb->classes[0].inv_two_var, bufsiz) &&
+		pad_to(fp, layout.size);
+
+	if (fclose(fp) != 0) {
+		return false;
+	}
+
+	return written;
+}
+
+/* gaussiannb_load() - load a model saved by gaussiannb_save() into memory
+ *
+ * Args:
+ *     gnb  - model structure to populate. it shouldn't be initialized
+ *     path - path to saved model
+ *
+ * Returns:
+ *     true on success
+ *     false if the file can't be read or is invalid, or out of memory
+ */
+bool gaussiannb_load(gaussiannb *gnb, const char *path) {
+	FILE       *fp;
+	struct stat sb;
+	uint8_t     header[GNB_FILE_ALIGN];
+	uint8_t    *head;
+	gnblayout   layout;
+	gaussiannb  loaded;
+	size_t      bufsiz;
+	uint64_t    head_size;
+
+	fp = fopen(path, "rb");
+	if (fp == NULL) {
+		return false;
+	}
+
+	// the header sizes the class table, so read it first
+	if (fstat(fileno(fp), &sb) != 0 ||
+		fread(header, sizeof(header), 1, fp) != 1 ||
+		!file_layout(get_le(header + 16, 8), get_le(header + 24, 8), &layout) ||
+		layout.size != (uint64_t)sb.st_size) {
+		fclose(fp);
+		return false;
+	}
+
+	head_size = layout.means;
+	head      = malloc(head_size);
+	if (head == NULL) {
+		fclose(fp);
+		return false;
+	}
+
+	memcpy(head, header, sizeof(header));
+	if (fread(head + sizeof(header), head_size - sizeof(header), 1, fp) != 1 ||
+		!decode_header(head, head_size, sb.st_size, &loaded, &layout)) {
+		free(head);
+		fclose(fp);
+		return false;
+	}
+	free(head);
+
+	bufsiz = loaded.num_classes * loaded.num_features;
+	if (!alloc_class_arrays(&loaded) ||
+		!read_doubles(fp, loaded.classes[0].mean, bufsiz) ||
+		fseek(fp, layout.variances, SEEK_SET) != 0 ||
+		!read_doubles(fp, loaded.classes[0].variance, bufsiz) ||
+		fseek(fp, layout.inv_two_var, SEEK_SET) != 0 ||
+		!read_doubles(fp, loaded.classes[0].inv_two_var, bufsiz)) {
+		gaussiannb_destroy(loaded);
+		fclose(fp);
+		return false;
+	}
+
+	fclose(fp);
+	*gnb = loaded;
+
+	return true;
+}
+
+/* gaussiannb_map() - map a model saved by gaussiannb_save() into memory,
+ *                    rather than reading it. means, variances, and cached
+ *                    constants are used in place, so worker processes
+ *                    mapping the same file share one copy of them in the
+ *                    page cache. the mapping is copy-on-write: training or
+ *                    updating a mapped model never changes the file.
+ *
+ * Args:
+ *     gnb  - model structure to populate. it shouldn't be initialized
+ *     path - path to saved model
+ *
+ * Returns:
+ *     true on success
+ *     false if the file can't be mapped or is invalid, out of memory, or
+ *           on big-endian hosts, which need to use gaussiannb_load()
+ */
+bool gaussiannb_map(gaussiannb *gnb, const char *path) {
+	struct stat  sb;
+	gnblayout    layout;
+	gaussiannb   mapped;
+	uint8_t     *mapping;
+	int          fd;
+
+	if (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__) {
+		return false;
+	}
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	if (fstat(fd, &sb) != 0 || sb.st_size < GNB_FILE_ALIGN) {
+		close(fd);
+		return false;
+	}
+
+	mapping = mmap(NULL, sb.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		return false;
+	}
+
+	if (!decode_header(mapping, sb.st_size, sb.st_size, &mapped, &layout)) {
+		munmap(mapping, sb.st_size);
+		return false;
+	}
+
+	for (size_t ci = 0; ci < mapped.num_classes; ci++) {
+		size_t row = ci * mapped.num_features;
+
+		mapped.classes[ci].mean        = (double *)(mapping + layout.means) + row;
+		mapped.classes[ci].variance    = (double *)(mapping + layout.variances) + row;
+		mapped.classes[ci].inv_two_var = (double *)(mapping + layout.inv_two_var) + row;
+	}
+
+	mapped.mapping      = mapping;
+	mapped.mapping_size = sb.st_size;
+	*gnb = mapped;
+
+	return true;
+}
@@ -5,11 +5,35 @@
 
 #include <math.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #define GNB_EPSILON               1e-9 // avoid division by zero
 #define GNB_ALPHA                 1e-2 // for regularization
 #define GNB_NORMALIZING_CONSTANT (1 / sqrt(2 * M_PI)) // normalizing constant
 
+/* gaussiannb file format, written by gaussiannb_save(). integers and
+ * doubles (IEEE 754) are little-endian.
+ *
+ *     offset  size  field
+ *          0     8  GNB_FILE_MAGIC
+ *          8     4  GNB_FILE_VERSION
+ *         12     4  GNB_FILE_ALIGN
+ *         16     8  num_classes
+ *         24     8  num_features
+ *         32     8  num_samples
+ *         40    24  reserved, zero
+ *         64        class table: num_classes records of count, prior,
+ *                   weight, log_prior, and log_norm, 8 bytes each
+ *                   means, variances, and inv_two_var, each num_classes
+ *                   rows of num_features doubles
+ *
+ * The class table and each array start on a GNB_FILE_ALIGN boundary, and
+ * the file is padded to one, so a mapped model can be used in place.
+ */
+#define GNB_FILE_MAGIC   "GNBMODEL"
+#define GNB_FILE_VERSION 1
+#define GNB_FILE_ALIGN   64
+
 /* structures
  */
 typedef struct {
@@ -18,6 +42,9 @@ typedef struct {
 	double  prior;
 	double  weight;
 	size_t  count;
+	double *inv_two_var; // cached 1 / (2 * variance), refreshed with variance
+	double  log_prior;   // cached log(prior * weight)
+	double  log_norm;    // cached sum of -0.5 * log(2 * pi * variance)
 } gaussiannbclass;
 
 typedef struct {
@@ -25,17 +52,47 @@ typedef struct {
 	size_t           num_features;
 	size_t           num_samples;
 	gaussiannbclass *classes;
+	void            *mapping;      // file mapped by gaussiannb_map(), or NULL
+	size_t           mapping_size; // size of mapping in bytes
 } gaussiannb;
 
+typedef struct {
+	double distance; // Mahalanobis distance to the nearest class
+	size_t index;    // sample's position in the stream
+} gaussiannbanomaly;
+
+/* gaussiannbtopk -- the k most anomalous samples seen by
+ *                   gaussiannb_mahalanobis_topk(), kept in a min-heap so
+ *                   each new sample is checked against the least
+ *                   anomalous of them.
+ */
+typedef struct {
+	size_t             k;
+	size_t             count;
+	size_t             seen;
+	gaussiannbanomaly *heap;
+} gaussiannbtopk;
+
 /* function definitions
  * TODO: _update, _train, _adjust_weight, should return statuses
  */
 bool   gaussiannb_init(gaussiannb *, size_t, size_t);
 void   gaussiannb_destroy(gaussiannb);
 void   gaussiannb_train(gaussiannb *, double **, int *, size_t);
+bool   gaussiannb_train_contiguous(gaussiannb *, const double *, const int *, size_t);
+bool   gaussiannb_merge(gaussiannb *, const gaussiannb *);
 void   gaussiannb_update(gaussiannb *, double *, int, bool);
 int    gaussiannb_predict(gaussiannb *, double *);
+void   gaussiannb_predict_batch(gaussiannb *, const double *, size_t, int *, double *);
 void   gaussiannb_adjust_weight(gaussiannb *, int, double);
 double gaussiannb_mahalanobis_distance(gaussiannb *, double *, size_t);
+void   gaussiannb_mahalanobis_batch(gaussiannb *, const double *, size_t, double *, int *);
+bool   gaussiannb_mahalanobis_topk(gaussiannb *, const double *, size_t, gaussiannbtopk *);
+bool   gaussiannb_topk_init(gaussiannbtopk *, size_t);
+void   gaussiannb_topk_destroy(gaussiannbtopk);
+size_t gaussiannb_topk_results(gaussiannbtopk, gaussiannbanomaly *);
+bool   gaussiannb_save(gaussiannb *, const char *);
+bool   gaussiannb_load(gaussiannb *, const char *);
+bool   gaussiannb_map(gaussiannb *, const char *);
 
 #endif /* GAUSSIANNB_H */
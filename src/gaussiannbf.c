@@ -0,0 +1,579 @@
+/* gaussiannbf.c
+ */
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "gaussiannbf.h"
+#include "gnbcore.h"
+
+bool gaussiannbf_init(gaussiannbf *gnb, size_t num_classes, size_t num_features) {
+	gnb->num_classes  = num_classes;
+	gnb->num_features = num_features;
+	gnb->num_samples  = 0;
+	gnb->classes      = calloc(num_classes, sizeof(gaussiannbfclass));
+
+	if (gnb->classes == NULL) {
+		return false;
+	}
+
+	// initialize class weights to 1.0
+	for (size_t c = 0; c < num_classes; c++) {
+		gnb->classes[c].weight = 1.0;
+	}
+
+	return true;
+}
+
+void gaussiannbf_destroy(gaussiannbf gnb) {
+	if (gnb.num_classes > 0) {
+		free(gnb.classes[0].mean);
+		free(gnb.classes[0].variance);
+		free(gnb.classes[0].inv_two_var);
+	}
+
+	free(gnb.classes);
+}
+
+/* refresh_class() - recompute a class's cached predict constants after its
+ *                   prior, weight, or variances change. constants are
+ *                   computed in double precision and rounded once.
+ */
+static void refresh_class(gaussiannbf *gnb, size_t c) {
+	gaussiannbfclass *cls      = &gnb->classes[c];
+	double            log_norm = 0.0;
+
+	cls->log_prior = log(cls->prior * cls->weight + GNB_EPSILON);
+
+	if (cls->variance == NULL) { // not trained yet
+		return;
+	}
+
+	for (size_t j = 0; j < gnb->num_features; j++) {
+		double var = (double)cls->variance[j] + GNB_EPSILON;
+
+		cls->inv_two_var[j] = 1.0 / (2 * var);
+		log_norm           += log(GNB_NORMALIZING_CONSTANT) - 0.5 * log(var);
+	}
+
+	cls->log_norm = log_norm;
+}
+
+/* alloc_class_arrays() - give every class fresh, zeroed mean, variance, and
+ *                        cached constant arrays, releasing any from an
+ *                        earlier training run.
+ *
+ * Args:
+ *     gnb - model
+ *
+ * Returns:
+ *     true on success
+ *     false if unable to allocate memory. the model is unchanged.
+ */
+static bool alloc_class_arrays(gaussiannbf *gnb) {
+	size_t bufsiz      = gnb->num_classes * gnb->num_features;
+	float *means       = calloc(bufsiz, sizeof(float));
+	float *variances   = calloc(bufsiz, sizeof(float));
+	float *inv_two_var = calloc(bufsiz, sizeof(float));
+
+	if (means == NULL || variances == NULL || inv_two_var == NULL) {
+		free(means);
+		free(variances);
+		free(inv_two_var);
+		return false;
+	}
+
+	if (gnb->num_classes > 0) {
+		free(gnb->classes[0].mean);
+		free(gnb->classes[0].variance);
+		free(gnb->classes[0].inv_two_var);
+	}
+
+	for (size_t ci = 0; ci < gnb->num_classes; ci++) {
+		gnb->classes[ci].mean        = means + (ci * gnb->num_features);
+		gnb->classes[ci].variance    = variances + (ci * gnb->num_features);
+		gnb->classes[ci].inv_two_var = inv_two_var + (ci * gnb->num_features);
+	}
+
+	return true;
+}
+
+/* gaussiannbf_train_contiguous() - train a model from a contiguous
+ *                                  row-major matrix of floats in a single
+ *                                  pass, like gaussiannb_train_contiguous().
+ *                                  statistics are accumulated in double
+ *                                  precision, and rounded to float once
+ *                                  training is done. large inputs are
+ *                                  split across threads.
+ *
+ * Args:
+ *     gnb         - model
+ *     X           - num_samples rows of num_features floats, row-major
+ *     y           - class label of each row
+ *     num_samples - number of rows in X
+ *
+ * Returns:
+ *     true on success
+ *     false if unable to allocate memory
+ */
+bool gaussiannbf_train_contiguous(gaussiannbf *gnb, const float *X, const int *y, size_t num_samples) {
+	gnbstats stats;
+
+	if (num_samples == 0) {
+		return true;
+	}
+
+	if (gnb_stats_collect(&stats, X, sizeof(float), y, num_samples, gnb->num_classes, gnb->num_features) == false) {
+		return false;
+	}
+
+	if (alloc_class_arrays(gnb) == false) {
+		gnb_stats_destroy(&stats);
+		return false;
+	}
+
+	gnb->num_samples += num_samples;
+
+	for (size_t ci = 0; ci < gnb->num_classes; ci++) {
+		gaussiannbfclass *cls  = &gnb->classes[ci];
+		size_t            base = ci * gnb->num_features;
+
+		cls->count = stats.rows[ci];
+
+		for (size_t fi = 0; fi < gnb->num_features; fi++) {
+			cls->mean[fi]     = stats.mean[base + fi];
+			cls->variance[fi] = gnb_stats_variance(&stats, ci, base + fi);
+		}
+
+		// laplace smoothing using class weight
+		cls->prior = (cls->count + cls->weight) / (num_samples + gnb->num_classes);
+
+		refresh_class(gnb, ci);
+	}
+
+	gnb_stats_destroy(&stats);
+
+	return true;
+}
+
+/* gaussiannbf_from_double() - build a single precision copy of a trained
+ *                             double precision model, e.g. one trained with
+ *                             threads, merged, or loaded from disk.
+ *
+ * Args:
+ *     gnb   - model structure to populate. it shouldn't be initialized
+ *     model - trained double precision model to copy
+ *
+ * Returns:
+ *     true on success
+ *     false if model isn't trained, or unable to allocate memory
+ */
+bool gaussiannbf_from_double(gaussiannbf *gnb, const gaussiannb *model) {
+	gaussiannbf copy;
+
+	if (model->num_classes == 0 || model->classes[0].mean == NULL) {
+		return false;
+	}
+
+	if (!gaussiannbf_init(&copy, model->num_classes, model->num_features)) {
+		return false;
+	}
+
+	if (!alloc_class_arrays(&copy)) {
+		gaussiannbf_destroy(copy);
+		return false;
+	}
+
+	copy.num_samples = model->num_samples;
+
+	for (size_t ci = 0; ci < copy.num_classes; ci++) {
+		const gaussiannbclass *src = &model->classes[ci];
+		gaussiannbfclass      *cls = &copy.classes[ci];
+
+		cls->prior  = src->prior;
+		cls->weight = src->weight;
+		cls->count  = src->count;
+
+		for (size_t fi = 0; fi < copy.num_features; fi++) {
+			cls->mean[fi]     = src->mean[fi];
+			cls->variance[fi] = src->variance[fi];
+		}
+
+		refresh_class(&copy, ci);
+	}
+
+	*gnb = copy;
+
+	return true;
+}
+
+/* predict_row() - score one sample against every class. gaussiannbf_predict()
+ *                 and the scalar batch path share this, so both produce
+ *                 identical results.
+ *
+ * Args:
+ *     gnb           - model
+ *     X             - sample's features
+ *     log_posterior - if not NULL, receives each class's log posterior
+ *
+ * Returns:
+ *     index of the most likely class, -1 if there are no classes.
+ */
+static int predict_row(const gaussiannbf *gnb, const float *X, float *log_posterior) {
+	float best_posterior = -INFINITY;
+	int   best_class     = -1;
+
+	for (size_t c = 0; c < gnb->num_classes; c++) {
+		const gaussiannbfclass *cls      = &gnb->classes[c];
+		float                   log_prob = cls->log_prior + cls->log_norm;
+
+		// log of each feature's gaussian pdf, less the constant part
+		for (size_t j = 0; j < gnb->num_features; j++) {
+			float diff = X[j] - cls->mean[j];
+			log_prob -= diff * diff * cls->inv_two_var[j];
+		}
+
+		if (log_posterior != NULL) {
+			log_posterior[c] = log_prob;
+		}
+
+		if (log_prob > best_posterior) {
+			best_posterior = log_prob;
+			best_class = c;
+		}
+	}
+
+	return best_class;
+}
+
+int gaussiannbf_predict(gaussiannbf *gnb, const float *X) {
+	return predict_row(gnb, X, NULL);
+}
+
+static void predict_rows_scalar(const gaussiannbf *gnb, const float *X, size_t first, size_t last, int *predictions, float *log_posteriors) {
+	for (size_t i = first; i < last; i++) {
+		predictions[i] = predict_row(gnb,
+									 X + i * gnb->num_features,
+									 log_posteriors ? log_posteriors + i * gnb->num_classes : NULL);
+	}
+}
+
+#ifdef GNB_X86
+/* predict_rows_avx2() - score eight samples at a time, one per lane. each
+ *                       lane performs the same operations in the same order
+ *                       as predict_row(), so results match it exactly.
+ */
+__attribute__((target("avx2")))
+static void predict_rows_avx2(const gaussiannbf *gnb, const float *X, size_t first, size_t last, int *predictions, float *log_posteriors) {
+	size_t nf    = gnb->num_features;
+	size_t nc    = gnb->num_classes;
+	float *block = aligned_alloc(32, (nf * 8 * sizeof(float) + 31) & ~(size_t)31);
+
+	if (block == NULL) {
+		predict_rows_scalar(gnb, X, first, last, predictions, log_posteriors);
+		return;
+	}
+
+	size_t i;
+	for (i = first; i + 8 <= last; i += 8) {
+		const float *rows = X + i * nf;
+
+		for (size_t j = 0; j < nf; j++) {
+			for (size_t k = 0; k < 8; k++) {
+				block[j * 8 + k] = rows[k * nf + j];
+			}
+		}
+
+		__m256 best       = _mm256_set1_ps(-INFINITY);
+		__m256 best_class = _mm256_set1_ps(-1.0f);
+
+		for (size_t c = 0; c < nc; c++) {
+			const gaussiannbfclass *cls      = &gnb->classes[c];
+			__m256                  log_prob = _mm256_set1_ps(cls->log_prior + cls->log_norm);
+
+			for (size_t j = 0; j < nf; j++) {
+				__m256 diff = _mm256_sub_ps(_mm256_load_ps(block + j * 8), _mm256_set1_ps(cls->mean[j]));
+				log_prob = _mm256_sub_ps(log_prob, _mm256_mul_ps(_mm256_mul_ps(diff, diff), _mm256_set1_ps(cls->inv_two_var[j])));
+			}
+
+			if (log_posteriors != NULL) {
+				float lp[8];
+
+				_mm256_storeu_ps(lp, log_prob);
+				for (size_t k = 0; k < 8; k++) {
+					log_posteriors[(i + k) * nc + c] = lp[k];
+				}
+			}
+
+			// strictly greater, so ties and NaNs keep the earlier class
+			__m256 better = _mm256_cmp_ps(log_prob, best, _CMP_GT_OQ);
+			best       = _mm256_blendv_ps(best, log_prob, better);
+			best_class = _mm256_blendv_ps(best_class, _mm256_set1_ps((float)c), better);
+		}
+
+		float classes[8];
+		_mm256_storeu_ps(classes, best_class);
+		for (size_t k = 0; k < 8; k++) {
+			predictions[i + k] = (int)classes[k];
+		}
+	}
+
+	free(block);
+
+	predict_rows_scalar(gnb, X, i, last, predictions, log_posteriors);
+}
+#endif /* GNB_X86 */
+
+/* rows_kernel_t -- scores rows first through last-1 of a batch, writing a
+ *                  class index and per-row values for each. the predict
+ *                  and Mahalanobis kernels share this shape, and the
+ *                  threading in run_batch().
+ */
+typedef void (*rows_kernel_t)(const gaussiannbf *, const float *, size_t, size_t, int *, float *);
+
+/* predict_rows -- batch predict kernel, chosen at runtime by the CPU's
+ *                 features.
+ */
+static rows_kernel_t predict_rows = NULL;
+
+static rows_kernel_t select_predict_rows() {
+	rows_kernel_t kernel = __atomic_load_n(&predict_rows, __ATOMIC_RELAXED);
+
+	if (kernel == NULL) {
+#ifdef GNB_X86
+		if (gnb_use_avx2()) {
+			kernel = predict_rows_avx2;
+		}
+#endif
+		if (kernel == NULL) {
+			kernel = predict_rows_scalar;
+		}
+
+		__atomic_store_n(&predict_rows, kernel, __ATOMIC_RELAXED);
+	}
+
+	return kernel;
+}
+
+typedef struct {
+	const gaussiannbf *gnb;
+	const float       *X;
+	int               *classes;
+	float             *values;
+	rows_kernel_t      kernel;
+} batch_job;
+
+static void batch_share(void *arg, size_t share, size_t first, size_t last) {
+	batch_job *job = arg;
+
+	(void)share;
+	job->kernel(job->gnb, job->X, first, last, job->classes, job->values);
+}
+
+/* run_batch() - run a batch kernel over num_samples rows, splitting large
+ *               batches across threads.
+ */
+static void run_batch(const gaussiannbf *gnb, const float *X, size_t num_samples, int *classes, float *values, rows_kernel_t kernel) {
+	batch_job job = {
+		.gnb     = gnb,
+		.X       = X,
+		.classes = classes,
+		.values  = values,
+		.kernel  = kernel,
+	};
+
+	gnb_run_shares(gnb_batch_threads(num_samples), num_samples, batch_share, &job);
+}
+
+/* gaussiannbf_predict_batch() - predict classes for many samples at once.
+ *                               large batches are split across threads.
+ *                               results match gaussiannbf_predict()
+ *                               exactly.
+ *
+ * Args:
+ *     gnb            - model
+ *     X              - num_samples rows of num_features floats, row-major
+ *     num_samples    - number of rows in X
+ *     predictions    - receives num_samples predicted class indexes
+ *     log_posteriors - if not NULL, receives num_samples rows of
+ *                      num_classes unnormalized log posteriors, row-major
+ *
+ * Returns:
+ *     Nothing
+ */
+void gaussiannbf_predict_batch(gaussiannbf *gnb, const float *X, size_t num_samples, int *predictions, float *log_posteriors) {
+	run_batch(gnb, X, num_samples, predictions, log_posteriors, select_predict_rows());
+}
+
+void gaussiannbf_adjust_weight(gaussiannbf *gnb, int ci, double weight) {
+	if (ci >= 0 && (size_t)ci < gnb->num_classes) {
+		gnb->classes[ci].weight = weight;
+		refresh_class(gnb, ci);
+	}
+}
+
+float gaussiannbf_mahalanobis_distance(gaussiannbf *gnb, const float *X, size_t class_index) {
+	const gaussiannbfclass *cls      = &gnb->classes[class_index];
+	float                   distance = 0.0f;
+
+	// 2 * inv_two_var is 1 / variance, without a division per feature
+	for (size_t i = 0; i < gnb->num_features; i++) {
+		float diff = X[i] - cls->mean[i];
+		distance += diff * diff * (2 * cls->inv_two_var[i]);
+	}
+
+	return sqrtf(distance);
+}
+
+/* distance_row() - smallest Mahalanobis distance from a sample to any
+ *                  class, in the same order of operations as
+ *                  gaussiannbf_mahalanobis_distance().
+ *
+ * Args:
+ *     gnb     - model
+ *     X       - sample's features
+ *     nearest - if not NULL, receives the index of the nearest class
+ *
+ * Returns:
+ *     distance to the nearest class, INFINITY if there are no classes
+ */
+static float distance_row(const gaussiannbf *gnb, const float *X, int *nearest) {
+	float best       = INFINITY;
+	int   best_class = -1;
+
+	for (size_t c = 0; c < gnb->num_classes; c++) {
+		const gaussiannbfclass *cls      = &gnb->classes[c];
+		float                   distance = 0.0f;
+
+		for (size_t j = 0; j < gnb->num_features; j++) {
+			float diff = X[j] - cls->mean[j];
+			distance += diff * diff * (2 * cls->inv_two_var[j]);
+		}
+
+		if (distance < best) {
+			best       = distance;
+			best_class = c;
+		}
+	}
+
+	if (nearest != NULL) {
+		*nearest = best_class;
+	}
+
+	return sqrtf(best);
+}
+
+static void distance_rows_scalar(const gaussiannbf *gnb, const float *X, size_t first, size_t last, int *nearest, float *distances) {
+	for (size_t i = first; i < last; i++) {
+		distances[i] = distance_row(gnb, X + i * gnb->num_features, nearest ? nearest + i : NULL);
+	}
+}
+
+#ifdef GNB_X86
+/* distance_rows_avx2() - Mahalanobis distances for eight samples at a
+ *                        time, one per lane, in the same order of
+ *                        operations as distance_row().
+ */
+__attribute__((target("avx2")))
+static void distance_rows_avx2(const gaussiannbf *gnb, const float *X, size_t first, size_t last, int *nearest, float *distances) {
+	size_t nf    = gnb->num_features;
+	size_t nc    = gnb->num_classes;
+	float *block = aligned_alloc(32, (nf * 8 * sizeof(float) + 31) & ~(size_t)31);
+
+	if (block == NULL) {
+		distance_rows_scalar(gnb, X, first, last, nearest, distances);
+		return;
+	}
+
+	size_t i;
+	for (i = first; i + 8 <= last; i += 8) {
+		const float *rows = X + i * nf;
+
+		for (size_t j = 0; j < nf; j++) {
+			for (size_t k = 0; k < 8; k++) {
+				block[j * 8 + k] = rows[k * nf + j];
+			}
+		}
+
+		__m256 best       = _mm256_set1_ps(INFINITY);
+		__m256 best_class = _mm256_set1_ps(-1.0f);
+
+		for (size_t c = 0; c < nc; c++) {
+			const gaussiannbfclass *cls      = &gnb->classes[c];
+			__m256                  distance = _mm256_setzero_ps();
+
+			for (size_t j = 0; j < nf; j++) {
+				__m256 diff = _mm256_sub_ps(_mm256_load_ps(block + j * 8), _mm256_set1_ps(cls->mean[j]));
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_mul_ps(diff, diff), _mm256_set1_ps(2 * cls->inv_two_var[j])));
+			}
+
+			// strictly less, so ties and NaNs keep the earlier class
+			__m256 closer = _mm256_cmp_ps(distance, best, _CMP_LT_OQ);
+			best       = _mm256_blendv_ps(best, distance, closer);
+			best_class = _mm256_blendv_ps(best_class, _mm256_set1_ps((float)c), closer);
+		}
+
+		_mm256_storeu_ps(distances + i, _mm256_sqrt_ps(best));
+
+		if (nearest != NULL) {
+			float classes[8];
+
+			_mm256_storeu_ps(classes, best_class);
+			for (size_t k = 0; k < 8; k++) {
+				nearest[i + k] = (int)classes[k];
+			}
+		}
+	}
+
+	free(block);
+
+	distance_rows_scalar(gnb, X, i, last, nearest, distances);
+}
+#endif /* GNB_X86 */
+
+/* distance_rows -- batch Mahalanobis kernel, chosen at runtime by the
+ *                  CPU's features.
+ */
+static rows_kernel_t distance_rows = NULL;
+
+static rows_kernel_t select_distance_rows() {
+	rows_kernel_t kernel = __atomic_load_n(&distance_rows, __ATOMIC_RELAXED);
+
+	if (kernel == NULL) {
+#ifdef GNB_X86
+		if (gnb_use_avx2()) {
+			kernel = distance_rows_avx2;
+		}
+#endif
+		if (kernel == NULL) {
+			kernel = distance_rows_scalar;
+		}
+
+		__atomic_store_n(&distance_rows, kernel, __ATOMIC_RELAXED);
+	}
+
+	return kernel;
+}
+
+/* gaussiannbf_mahalanobis_batch() - score many samples for anomaly
+ *                                   detection at once: each sample's
+ *                                   Mahalanobis distance to its nearest
+ *                                   class, eight samples per vector where
+ *                                   AVX2 is available. large batches are
+ *                                   split across threads.
+ *
+ * Args:
+ *     gnb         - model
+ *     X           - num_samples rows of num_features floats, row-major
+ *     num_samples - number of rows in X
+ *     distances   - receives num_samples distances. samples with NaN
+ *                   features are no nearer any class, and score INFINITY
+ *     nearest     - if not NULL, receives num_samples nearest class indexes,
+ *                   -1 for samples scoring INFINITY
+ *
+ * Returns:
+ *     Nothing
+ */
+void gaussiannbf_mahalanobis_batch(gaussiannbf *gnb, const float *X, size_t num_samples, float *distances, int *nearest) {
+	run_batch(gnb, X, num_samples, nearest, distances, select_distance_rows());
+}
@@ -0,0 +1,46 @@
+/* gaussiannbf.h -- single precision gaussian naive bayes. means, variances,
+ *                  and math are float: half the memory of gaussiannb, and
+ *                  twice as many samples per vector in batch prediction
+ *                  and Mahalanobis scoring.
+ */
+#ifndef GAUSSIANNBF_H
+#define GAUSSIANNBF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "gaussiannb.h"
+
+/* structures
+ */
+typedef struct {
+	float  *mean;
+	float  *variance;
+	float  *inv_two_var; // cached 1 / (2 * variance), refreshed with variance
+	double  prior;
+	double  weight;
+	size_t  count;
+	float   log_prior;   // cached log(prior * weight)
+	float   log_norm;    // cached sum of -0.5 * log(2 * pi * variance)
+} gaussiannbfclass;
+
+typedef struct {
+	size_t            num_classes;
+	size_t            num_features;
+	size_t            num_samples;
+	gaussiannbfclass *classes;
+} gaussiannbf;
+
+/* function definitions
+ */
+bool  gaussiannbf_init(gaussiannbf *, size_t, size_t);
+void  gaussiannbf_destroy(gaussiannbf);
+bool  gaussiannbf_train_contiguous(gaussiannbf *, const float *, const int *, size_t);
+bool  gaussiannbf_from_double(gaussiannbf *, const gaussiannb *);
+int   gaussiannbf_predict(gaussiannbf *, const float *);
+void  gaussiannbf_predict_batch(gaussiannbf *, const float *, size_t, int *, float *);
+void  gaussiannbf_adjust_weight(gaussiannbf *, int, double);
+float gaussiannbf_mahalanobis_distance(gaussiannbf *, const float *, size_t);
+void  gaussiannbf_mahalanobis_batch(gaussiannbf *, const float *, size_t, float *, int *);
+
+#endif /* GAUSSIANNBF_H */
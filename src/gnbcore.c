@@ -0,0 +1,286 @@
+/* gnbcore.c
+ */
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "gaussiannb.h"
+#include "gnbcore.h"
+
+/* gnb_batch_threads() - number of threads worth starting for a batch of
+ *                       rows.
+ */
+size_t gnb_batch_threads(size_t num_samples) {
+	long   cpus    = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t threads = num_samples / GNB_THREAD_ROWS;
+
+	if (cpus > 0 && threads > (size_t)cpus) {
+		threads = cpus;
+	}
+
+	if (threads > GNB_MAX_THREADS) {
+		threads = GNB_MAX_THREADS;
+	}
+
+	return threads > 0 ? threads : 1;
+}
+
+typedef struct {
+	gnb_share_fn  fn;
+	void         *arg;
+	size_t        share;
+	size_t        first;
+	size_t        last;
+} share_job;
+
+static void *share_worker(void *arg) {
+	share_job *job = arg;
+
+	job->fn(job->arg, job->share, job->first, job->last);
+
+	return NULL;
+}
+
+/* gnb_run_shares() - split num_samples rows into 'threads' even shares and
+ *                    run them in parallel
+ *
+ * Args:
+ *     threads     - number of shares, at most GNB_MAX_THREADS
+ *     num_samples - number of rows
+ *     fn          - called once per share
+ *     arg         - passed to fn
+ *
+ * Returns:
+ *     Nothing
+ */
+void gnb_run_shares(size_t threads, size_t num_samples, gnb_share_fn fn, void *arg) {
+	pthread_t tids[GNB_MAX_THREADS];
+	share_job jobs[GNB_MAX_THREADS];
+	bool      started[GNB_MAX_THREADS] = { false };
+
+	for (size_t t = 0; t < threads; t++) {
+		jobs[t] = (share_job) {
+			.fn    = fn,
+			.arg   = arg,
+			.share = t,
+			.first = num_samples * t / threads,
+			.last  = num_samples * (t + 1) / threads,
+		};
+	}
+
+	// the calling thread takes the first share. if a thread can't be
+	// started, its share is done here too
+	for (size_t t = 1; t < threads; t++) {
+		started[t] = pthread_create(&tids[t], NULL, share_worker, &jobs[t]) == 0;
+	}
+
+	share_worker(&jobs[0]);
+
+	for (size_t t = 1; t < threads; t++) {
+		if (started[t]) {
+			pthread_join(tids[t], NULL);
+		} else {
+			share_worker(&jobs[t]);
+		}
+	}
+}
+
+/* gnb_use_avx2() - check if batch kernels should use AVX2
+ */
+bool gnb_use_avx2() {
+#ifdef GNB_X86
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#else
+	return false;
+#endif
+}
+
+/* gnb_merge_moments() - combine the count, mean, and sum of squared
+ *                       deviations of two sets of samples into those of
+ *                       their union, with Chan et al.'s parallel variance
+ *                       formula.
+ *
+ * Args:
+ *     n    - count of the first set, updated in place
+ *     mean - mean of the first set, updated in place
+ *     m2   - sum of squared deviations of the first set, updated in place
+ *     nb   - count of the second set
+ *     mb   - mean of the second set
+ *     m2b  - sum of squared deviations of the second set
+ *
+ * Returns:
+ *     Nothing
+ */
+void gnb_merge_moments(size_t *n, double *mean, double *m2, size_t nb, double mb, double m2b) {
+	size_t total = *n + nb;
+
+	if (nb == 0) {
+		return;
+	}
+
+	double delta = mb - *mean;
+
+	*mean += delta * nb / total;
+	*m2   += m2b + delta * delta * ((double)*n * nb / total);
+	*n     = total;
+}
+
+static bool stats_init(gnbstats *stats, size_t num_classes, size_t num_features) {
+	size_t bufsiz = num_classes * num_features;
+
+	stats->rows = calloc(num_classes, sizeof(size_t));
+	stats->n    = calloc(bufsiz, sizeof(size_t));
+	stats->mean = calloc(bufsiz, sizeof(double));
+	stats->m2   = calloc(bufsiz, sizeof(double));
+
+	if (stats->rows == NULL || stats->n == NULL || stats->mean == NULL || stats->m2 == NULL) {
+		gnb_stats_destroy(stats);
+		return false;
+	}
+
+	return true;
+}
+
+void gnb_stats_destroy(gnbstats *stats) {
+	free(stats->rows);
+	free(stats->n);
+	free(stats->mean);
+	free(stats->m2);
+}
+
+/* stats_accumulate() - fold rows first through last-1 of a row-major
+ *                      matrix of floats or doubles into running statistics
+ *                      with Welford's method. rows with labels outside the
+ *                      model's classes are skipped, as are NaN features.
+ */
+static void stats_accumulate(gnbstats *stats, const void *X, size_t width, const int *y, size_t first, size_t last, size_t num_classes, size_t num_features) {
+	const float  *Xf = X;
+	const double *Xd = X;
+
+	for (size_t si = first; si < last; si++) {
+		if (y[si] < 0 || (size_t)y[si] >= num_classes) {
+			continue;
+		}
+
+		size_t  base = (size_t)y[si] * num_features;
+		size_t *n    = stats->n + base;
+		double *mean = stats->mean + base;
+		double *m2   = stats->m2 + base;
+
+		stats->rows[y[si]]++;
+
+		for (size_t fi = 0; fi < num_features; fi++) {
+			size_t i = si * num_features + fi;
+			double x = (width == sizeof(float)) ? Xf[i] : Xd[i];
+
+			if (isnan(x)) {
+				continue;
+			}
+
+			double delta = x - mean[fi];
+			n[fi]++;
+			mean[fi] += delta / n[fi];
+			m2[fi]   += delta * (x - mean[fi]);
+		}
+	}
+}
+
+/* stats_merge() - fold one thread's running statistics into another's.
+ */
+static void stats_merge(gnbstats *dst, const gnbstats *src, size_t num_classes, size_t num_features) {
+	for (size_t ci = 0; ci < num_classes; ci++) {
+		dst->rows[ci] += src->rows[ci];
+	}
+
+	for (size_t i = 0; i < num_classes * num_features; i++) {
+		gnb_merge_moments(&dst->n[i], &dst->mean[i], &dst->m2[i], src->n[i], src->mean[i], src->m2[i]);
+	}
+}
+
+typedef struct {
+	gnbstats   *stats;
+	const void *X;
+	size_t      width;
+	const int  *y;
+	size_t      num_classes;
+	size_t      num_features;
+} collect_job;
+
+static void collect_share(void *arg, size_t share, size_t first, size_t last) {
+	collect_job *job = arg;
+
+	stats_accumulate(&job->stats[share], job->X, job->width, job->y, first, last, job->num_classes, job->num_features);
+}
+
+/* gnb_stats_collect() - gather per-class statistics from a contiguous
+ *                       row-major matrix in a single pass. large inputs
+ *                       are split across threads, each keeping its own
+ *                       statistics, which are merged once they finish.
+ *
+ * Args:
+ *     stats        - receives the statistics. free with gnb_stats_destroy()
+ *     X            - num_samples rows of num_features values
+ *     width        - sizeof(float) or sizeof(double): the type of X
+ *     y            - class label of each row
+ *     num_samples  - number of rows in X
+ *     num_classes  - number of classes
+ *     num_features - number of features
+ *
+ * Returns:
+ *     true on success
+ *     false if unable to allocate memory
+ */
+bool gnb_stats_collect(gnbstats *stats, const void *X, size_t width, const int *y, size_t num_samples, size_t num_classes, size_t num_features) {
+	size_t      threads = gnb_batch_threads(num_samples);
+	gnbstats    shares[GNB_MAX_THREADS];
+	collect_job job     = {
+		.stats        = shares,
+		.X            = X,
+		.width        = width,
+		.y            = y,
+		.num_classes  = num_classes,
+		.num_features = num_features,
+	};
+
+	for (size_t t = 0; t < threads; t++) {
+		if (stats_init(&shares[t], num_classes, num_features) == false) {
+			while (t-- > 0) {
+				gnb_stats_destroy(&shares[t]);
+			}
+			return false;
+		}
+	}
+
+	gnb_run_shares(threads, num_samples, collect_share, &job);
+
+	for (size_t t = 1; t < threads; t++) {
+		stats_merge(&shares[0], &shares[t], num_classes, num_features);
+		gnb_stats_destroy(&shares[t]);
+	}
+
+	*stats = shares[0];
+
+	return true;
+}
+
+/* gnb_stats_variance() - regularized variance of one class and feature. a
+ *                        NaN feature counts as the class mean: it adds a
+ *                        row to the divisor, but nothing to the squared
+ *                        deviations.
+ *
+ * Args:
+ *     stats       - collected statistics
+ *     class_index - class
+ *     i           - index of the class and feature in stats' arrays
+ *
+ * Returns:
+ *     variance plus GNB_ALPHA, or GNB_EPSILON for a class without samples
+ */
+double gnb_stats_variance(const gnbstats *stats, size_t class_index, size_t i) {
+	size_t rows = stats->rows[class_index];
+
+	return (rows == 0) ? GNB_EPSILON : (stats->m2[i] / rows) + GNB_ALPHA;
+}
@@ -0,0 +1,51 @@
+/* gnbcore.h -- internals shared by the double (gaussiannb) and single
+ *              (gaussiannbf) precision models: batch threading, kernel
+ *              dispatch, and single pass training statistics. not
+ *              installed.
+ */
+#ifndef GNBCORE_H
+#define GNBCORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#if defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define GNB_X86
+#endif
+
+/* GNB_THREAD_ROWS -- minimum number of rows each thread handles in batch
+ *                    calls. smaller batches aren't worth a thread start.
+ */
+#define GNB_THREAD_ROWS 16384
+#define GNB_MAX_THREADS 64
+
+/* gnb_share_fn -- does one share of a batch: rows first through last-1.
+ *                 'share' numbers the shares from 0, so callers can give
+ *                 each its own state.
+ */
+typedef void (*gnb_share_fn)(void *arg, size_t share, size_t first, size_t last);
+
+/* gnbstats -- running per-class statistics for single pass training. each
+ *             array holds num_classes rows of num_features entries, except
+ *             rows, which has one entry per class. accumulated in double
+ *             precision for both models.
+ */
+typedef struct {
+	size_t *rows;  // samples seen per class
+	size_t *n;     // non-NaN values seen per class and feature
+	double *mean;  // running mean
+	double *m2;    // running sum of squared deviations from the mean
+} gnbstats;
+
+/* function definitions
+ */
+size_t gnb_batch_threads(size_t);
+void   gnb_run_shares(size_t, size_t, gnb_share_fn, void *);
+bool   gnb_use_avx2();
+void   gnb_merge_moments(size_t *, double *, double *, size_t, double, double);
+bool   gnb_stats_collect(gnbstats *, const void *, size_t, const int *, size_t, size_t, size_t);
+void   gnb_stats_destroy(gnbstats *);
+double gnb_stats_variance(const gnbstats *, size_t, size_t);
+
+#endif /* GNBCORE_H */
@@ -0,0 +1,304 @@
+/* swbloom.c
+ *
+ * Sliding-window bloom filter built from a ring of plain bloom filters
+ * ("generations"). This answers the same question as tdbloom, "have I seen
+ * this element in the last N seconds?", using one bit per slot per
+ * generation rather than a 1-8 byte timestamp per slot.
+ *
+ * With g generations, each generation covers N / (g - 1) seconds. Elements
+ * are always added to the newest generation, and when the newest generation
+ * is retired the oldest one is cleared with a single memset(). An element
+ * is therefore remembered for at least N seconds, and at most N + N / (g - 1)
+ * seconds.
+ */
+#include <time.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "mmh3.h"
+#include "bloom.h"
+#include "swbloom.h"
+
+const char *swbloom_errors[] = {
+	"Success",
+	"Invalid window value",
+	"Invalid number of generations",
+	"Out of memory"
+};
+
+/* get_monotonic_ms() - get monotonic time in milliseconds.
+ *
+ * Args:
+ *     None
+ *
+ * Returns:
+ *     int64_t holding CLOCK_MONOTONIC value in milliseconds
+ */
+static int64_t get_monotonic_ms() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* current_epoch() - number of generation spans elapsed since start_time
+ */
+static int64_t current_epoch(const swbloom *swbf) {
+	int64_t elapsed = get_monotonic_ms() - swbf->start_time;
+
+	return elapsed / (int64_t)swbf->span;
+}
+
+/* swbloom_init() - initialize a sliding-window bloom filter
+ *
+ * Args:
+ *     swbf        - pointer to swbloom structure
+ *     expected    - maximum expected number of elements within one window
+ *     accuracy    - acceptable false positive rate. ex: 0.01 == 99.99%
+ *     window      - number of seconds an element is valid
+ *     generations - number of generations, 2 through SWBLOOM_MAX_GENERATIONS.
+ *                   more generations expire elements closer to 'window' at
+ *                   the cost of memory.
+ *
+ * Returns:
+ *     SWBF_SUCCESS on success
+ *     SWBF_INVALIDWINDOW if 'window' is 0
+ *     SWBF_INVALIDGENERATIONS if 'generations' is out of range
+ *     SWBF_OUTOFMEMORY if unable to allocate memory
+ */
+swbloom_error_t swbloom_init(swbloom *swbf, const size_t expected, const float accuracy, const size_t window, const size_t generations) {
+	if (window == 0) {
+		return SWBF_INVALIDWINDOW;
+	}
+
+	if (generations < 2 || generations > SWBLOOM_MAX_GENERATIONS) {
+		return SWBF_INVALIDGENERATIONS;
+	}
+
+	swbf->window      = window;
+	swbf->generations = generations;
+	swbf->span        = (window * 1000 + (generations - 2)) / (generations - 1);
+	swbf->expected    = expected;
+	swbf->accuracy    = accuracy;
+	swbf->start_time  = get_monotonic_ms();
+	swbf->epoch       = 0;
+
+	swbf->filters = calloc(generations, sizeof(bloomfilter));
+	if (swbf->filters == NULL) {
+		return SWBF_OUTOFMEMORY;
+	}
+
+	// each generation holds roughly 1 / (g - 1) of a window's elements, and
+	// a lookup can match in any of g generations, so size each one for a
+	// 1 / g share of the false positive budget.
+	size_t per_generation = (expected + generations - 2) / (generations - 1);
+
+	for (size_t g = 0; g < generations; g++) {
+		if (bloom_init(&swbf->filters[g], per_generation, accuracy / generations) == false) {
+			for (size_t i = 0; i < g; i++) {
+				bloom_destroy(swbf->filters[i]);
+			}
+			free(swbf->filters);
+			return SWBF_OUTOFMEMORY;
+		}
+	}
+
+	return SWBF_SUCCESS;
+}
+
+/* swbloom_destroy() - free memory allocated by swbloom_init()
+ *
+ * Args:
+ *     swbf - filter to destroy
+ *
+ * Returns:
+ *     Nothing
+ */
+void swbloom_destroy(swbloom swbf) {
+	for (size_t g = 0; g < swbf.generations; g++) {
+		bloom_destroy(swbf.filters[g]);
+	}
+
+	free(swbf.filters);
+}
+
+/* clear_generation() - empty one generation's bitmap
+ */
+static void clear_generation(bloomfilter *bf) {
+	memset(bf->bitmap, 0, bf->bitmap_size);
+	bf->insertions = 0;
+}
+
+/* swbloom_clear() - clear all generations and reset the start time to 'now'
+ *
+ * Args:
+ *     swbf - filter to clear
+ *
+ * Returns:
+ *     Nothing
+ */
+void swbloom_clear(swbloom *swbf) {
+	for (size_t g = 0; g < swbf->generations; g++) {
+		clear_generation(&swbf->filters[g]);
+	}
+
+	swbf->start_time = get_monotonic_ms();
+	swbf->epoch      = 0;
+}
+
+/* swbloom_memory() - number of bytes used by a filter's bitmaps
+ *
+ * Args:
+ *     swbf - filter to check
+ *
+ * Returns:
+ *     size of all generations' bitmaps in bytes
+ */
+size_t swbloom_memory(const swbloom swbf) {
+	return swbf.generations * swbf.filters[0].bitmap_size;
+}
+
+/* rotate() - retire generations whose spans have passed, clearing the
+ *            oldest generation for each span that has elapsed.
+ */
+static void rotate(swbloom *swbf, int64_t now) {
+	if (now <= swbf->epoch) {
+		return;
+	}
+
+	int64_t steps = now - swbf->epoch;
+	if (steps > (int64_t)swbf->generations) {
+		steps = swbf->generations;
+	}
+
+	for (int64_t s = 1; s <= steps; s++) {
+		clear_generation(&swbf->filters[(swbf->epoch + s) % swbf->generations]);
+	}
+
+	swbf->epoch = now;
+}
+
+/* live_generations() - bitmask of generations that are still within the
+ *                      window at epoch 'now', without rotating the filter.
+ */
+static uint64_t live_generations(const swbloom *swbf, int64_t now) {
+	int64_t  oldest = swbf->epoch - (int64_t)swbf->generations + 1;
+	uint64_t live   = 0;
+
+	if (now - (int64_t)swbf->generations + 1 > oldest) {
+		oldest = now - (int64_t)swbf->generations + 1;
+	}
+
+	for (int64_t e = (oldest < 0) ? 0 : oldest; e <= swbf->epoch; e++) {
+		live |= 1ULL << (e % swbf->generations);
+	}
+
+	return live;
+}
+
+/* swbloom_add() - add an element to the newest generation of a filter
+ *
+ * Args:
+ *     swbf    - filter to add element to
+ *     element - element to add
+ *     len     - length of element in bytes
+ *
+ * Returns:
+ *     Nothing
+ */
+void swbloom_add(swbloom *swbf, void *element, const size_t len) {
+	int64_t now = current_epoch(swbf);
+
+	rotate(swbf, now);
+
+	bloom_add(&swbf->filters[swbf->epoch % swbf->generations], element, len);
+}
+
+/* swbloom_add_string() - add a string element to a filter
+ *
+ * Args:
+ *     swbf    - filter to add element to
+ *     element - string to add
+ *
+ * Returns:
+ *     Nothing
+ */
+void swbloom_add_string(swbloom *swbf, const char *element) {
+	swbloom_add(swbf, (uint8_t *)element, strlen(element));
+}
+
+/* swbloom_lookup() - check if an element was added within the window
+ *
+ * All live generations are checked in one pass: each position is hashed
+ * once, and a mask of generations that could still hold the element is
+ * narrowed down at each position.
+ *
+ * Args:
+ *     swbf    - filter to perform lookup against
+ *     element - element to search for
+ *     len     - length of element in bytes
+ *
+ * Returns:
+ *     true if element is likely in the filter
+ *     false if element is definitely not in the filter
+ */
+bool swbloom_lookup(const swbloom swbf, void *element, const size_t len) {
+	uint64_t hash[2];
+	uint64_t result;
+	uint64_t candidates = live_generations(&swbf, current_epoch(&swbf));
+	size_t   size       = swbf.filters[0].size;
+
+	for (int i = 0; i < swbf.filters[0].hashcount && candidates != 0; i++) {
+		mmh3_128(element, len, i, hash);
+		result = ((hash[0] % size) + (hash[1] % size)) % size;
+
+		uint64_t bytepos = result / 8;
+		uint8_t  bitmask = 0x01 << (result % 8);
+		uint64_t present = 0;
+
+		for (uint64_t remaining = candidates; remaining != 0; remaining &= remaining - 1) {
+			int g = __builtin_ctzll(remaining);
+			if (swbf.filters[g].bitmap[bytepos] & bitmask) {
+				present |= 1ULL << g;
+			}
+		}
+
+		candidates &= present;
+	}
+
+	return candidates != 0;
+}
+
+/* swbloom_lookup_string() - helper function to handle string lookups
+ *
+ * Args:
+ *     swbf    - filter to use
+ *     element - string element to lookup
+ *
+ * Returns:
+ *     true if element is likely in the filter
+ *     false if element is definitely not in the filter
+ */
+bool swbloom_lookup_string(const swbloom swbf, const char *element) {
+	return swbloom_lookup(swbf, (uint8_t *)element, strlen(element));
+}
+
+/* swbloom_strerror() - returns string containing error message
+ *
+ * Args:
+ *     error - error number returned from function
+ *
+ * Returns:
+ *     "Unknown error" if 'error' is out of range. Otherwise, a pointer to
+ *     a string containing relevant error message.
+ */
+const char *swbloom_strerror(swbloom_error_t error) {
+	if (error < 0 || error >= SWBF_ERRORCOUNT) {
+		return "Unknown error";
+	}
+
+	return swbloom_errors[error];
+}
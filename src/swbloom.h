@@ -0,0 +1,63 @@
+/* swbloom.h
+ */
+#ifndef SWBLOOM_H
+#define SWBLOOM_H
+
+#include <time.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "bloom.h"
+
+/* swbloom_error_t -- error handling return values
+ */
+typedef enum {
+	SWBF_SUCCESS,
+	SWBF_INVALIDWINDOW,
+	SWBF_INVALIDGENERATIONS,
+	SWBF_OUTOFMEMORY,
+	// used for counting number of statuses. don't add statuses below this line
+	SWBF_ERRORCOUNT
+} swbloom_error_t;
+
+/* swbloom_errors -- human-readable error messages. defined in swbloom.c so
+ *                   the header can be included by more than one file.
+ */
+extern const char *swbloom_errors[];
+
+/* SWBLOOM_MAX_GENERATIONS -- generations are tracked in a 64 bit mask
+ */
+#define SWBLOOM_MAX_GENERATIONS 64
+
+/* swbloom -- sliding-window bloom filter structure. elements are added to
+ *            the newest of 'generations' bloom filters, and the oldest
+ *            generation is cleared each time 'span' milliseconds pass.
+ */
+typedef struct {
+	size_t       window;       /* number of seconds an element is valid */
+	size_t       generations;  /* number of generations */
+	size_t       span;         /* milliseconds covered by one generation */
+	size_t       expected;     /* expected number of elements per window */
+	float        accuracy;     /* desired margin of error */
+	int64_t      start_time;   /* monotonic milliseconds at initialization */
+	int64_t      epoch;        /* number of the newest generation */
+	bloomfilter *filters;      /* one bloom filter per generation */
+} swbloom;
+
+/* function definitions
+ */
+swbloom_error_t  swbloom_init(swbloom *,
+							  const size_t,
+							  const float,
+							  const size_t,
+							  const size_t);
+void             swbloom_destroy(swbloom);
+void             swbloom_clear(swbloom *);
+size_t           swbloom_memory(const swbloom);
+void             swbloom_add(swbloom *, void *, const size_t);
+void             swbloom_add_string(swbloom *, const char *);
+bool             swbloom_lookup(const swbloom, void *, const size_t);
+bool             swbloom_lookup_string(const swbloom, const char *);
+const char      *swbloom_strerror(swbloom_error_t);
+
+#endif /* SWBLOOM_H */
@@ -10,9 +10,25 @@
 #include <limits.h>
 #include <sys/stat.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "tdbloom.h"
 #include "mmh3.h"
 
+const char *tdbloom_errors[] = {
+	"Success",
+	"Invalid timeout value",
+	"Out of memory",
+	"Unable to open file",
+	"Unable to read file",
+	"Unable to write to file",
+	"fstat() error",
+	"Invalid file format",
+	"Invalid time resolution"
+};
+
 /* ideal_size() - calculate ideal size of a filter based on the expected
  *                number of elements and desired accuracy.
  *
@@ -27,7 +43,7 @@ static uint64_t ideal_size(const uint64_t expected, const float accuracy) {
 	return -(expected * log(accuracy) / pow(log(2.0), 2));
 }
 
-/* get_monotonic_time() - get monotonic time.
+/* get_monotonic_ms() - get monotonic time in milliseconds.
  *
  * This helps account for clock changes on the local system. Relying on time()
  * will ruin the filter if the clock is adjusted on the system.
@@ -36,17 +52,40 @@ static uint64_t ideal_size(const uint64_t expected, const float accuracy) {
  *     None
  *
  * Returns:
- *     time_t holding CLOCK_MONOTONIC value
+ *     int64_t holding CLOCK_MONOTONIC value in milliseconds
  */
-static time_t get_monotonic_time() {
+static int64_t get_monotonic_ms() {
 	struct timespec ts;
 
 	clock_gettime(CLOCK_MONOTONIC, &ts);
 
-	return ts.tv_sec;
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* reset_sweep() - restart sweeping from the first slot, treating every
+ *                 stored timestamp as written since start_time.
+ */
+static void reset_sweep(tdbloom *tdbf) {
+	tdbf->sweep_position = 0;
+	tdbf->sweep_tick     = 0;
+	tdbf->sweep_live     = 0;
+	tdbf->clean_tick     = 0;
+	tdbf->live_slots     = 0;
 }
 
-/* tdbloom_init() - initialize a time-decaying bloom filter
+/* filter_bytes() - calculate size of a filter's timestamp array in bytes.
+ *                  12-bit timestamps are packed 2 per 3 bytes.
+ */
+static size_t filter_bytes(const tdbloom *tdbf) {
+	if (tdbf->bits == 12) {
+		return ((tdbf->size + 1) / 2) * 3;
+	}
+
+	return tdbf->size * tdbf->bytes;
+}
+
+/* tdbloom_init() - initialize a time-decaying bloom filter with one second
+ *                  timestamp resolution
  *
  * Args:
  *     tdbf     - pointer to tdbloom structure
@@ -60,35 +99,84 @@ static time_t get_monotonic_time() {
  *     TDBF_OUTOFMEMORY if unable to allocate memory
  */
 tdbloom_error_t tdbloom_init(tdbloom *tdbf, const size_t expected, const float accuracy, const size_t timeout) {
-	tdbf->size       = ideal_size(expected, accuracy);
-	tdbf->hashcount  = (tdbf->size / expected) * log(2);
-	tdbf->timeout    = timeout;
-	tdbf->expected   = expected;
-	tdbf->accuracy   = accuracy;
-	tdbf->start_time = get_monotonic_time();
-
-	// decide which datatype to use for storing timestamps
-	/// TODO: test this
-	int bytes;
-	if (timeout > UINT64_MAX || sizeof(time_t) == 4 && timeout > UINT32_MAX) {
+	return tdbloom_init_ex(tdbf, expected, accuracy, timeout, TDBLOOM_RESOLUTION_DEFAULT, 0);
+}
+
+/* tdbloom_init_ex() - initialize a time-decaying bloom filter storing
+ *                     timestamps in ticks of 'resolution' milliseconds.
+ *
+ * Timestamp width is picked from the number of ticks in 'timeout', so a
+ * coarser resolution lets longer timeouts fit into smaller slots. For
+ * example, a 10 minute timeout needs 2 byte slots at one second resolution,
+ * but fits 1 byte slots at 10 second resolution. Elements are considered
+ * valid for 'timeout' seconds rounded up to a whole number of ticks.
+ *
+ * Args:
+ *     tdbf       - pointer to tdbloom structure
+ *     expected   - maximum expected number of elements
+ *     accuracy   - acceptable false positive rate
+ *     timeout    - number of seconds an element is valid
+ *     resolution - milliseconds per timestamp tick. ex: 1000 == 1 second
+ *     flags      - TDBLOOM_PACKED12 to allow 12-bit packed timestamps.
+ *                  TDBLOOM_CONCURRENT to allow threads to add, look up, and
+ *                  sweep concurrently. packed timestamps share bytes and
+ *                  can't be written atomically, so this overrides
+ *                  TDBLOOM_PACKED12.
+ *                  TDBLOOM_TTL to store expiry times, so each element can
+ *                  have its own lifetime of up to 'timeout' seconds.
+ *
+ * Returns:
+ *     TDBF_SUCCESS on success
+ *     TDBF_INVALIDTIMEOUT if value of 'timeout' isn't sane
+ *     TDBF_INVALIDRESOLUTION if value of 'resolution' isn't sane
+ *     TDBF_OUTOFMEMORY if unable to allocate memory
+ */
+tdbloom_error_t tdbloom_init_ex(tdbloom *tdbf, const size_t expected, const float accuracy, const size_t timeout, const size_t resolution, const int flags) {
+	if (resolution == 0) {
+		return TDBF_INVALIDRESOLUTION;
+	}
+
+	if (timeout > UINT64_MAX / 1000 || sizeof(time_t) == 4 && timeout > UINT32_MAX) {
 		return TDBF_INVALIDTIMEOUT;
 	}
 
-	if      (timeout < UINT8_MAX)   { bytes = 1; tdbf->max_time = UINT8_MAX; }
-	else if (timeout < UINT16_MAX)  { bytes = 2; tdbf->max_time = UINT16_MAX; }
-	else if (timeout < UINT32_MAX)  { bytes = 4; tdbf->max_time = UINT32_MAX; }
-	else if (timeout <= UINT64_MAX) { bytes = 8; tdbf->max_time = UINT64_MAX; }
+	tdbf->size          = ideal_size(expected, accuracy);
+	tdbf->hashcount     = (tdbf->size / expected) * log(2);
+	tdbf->timeout       = timeout;
+	tdbf->resolution    = resolution;
+	tdbf->timeout_ticks = (timeout * 1000 + resolution - 1) / resolution;
+	tdbf->expected      = expected;
+	tdbf->accuracy      = accuracy;
+	tdbf->flags         = flags;
+	tdbf->start_time    = get_monotonic_ms();
+
+	reset_sweep(tdbf);
+
+	// decide which datatype to use for storing timestamps. expiry times
+	// run ahead of the clock, so leave TDBLOOM_TTL filters room to be used
+	// for at least one timeout between sweeps.
+	size_t ticks = tdbf->timeout_ticks;
+	if (flags & TDBLOOM_TTL) {
+		ticks *= 2;
+	}
+
+	if      (ticks < UINT8_MAX)  { tdbf->bits = 8;  tdbf->max_time = UINT8_MAX; }
+	else if (ticks < 0xfff && (flags & TDBLOOM_PACKED12) && !(flags & TDBLOOM_CONCURRENT)) {
+		tdbf->bits = 12; tdbf->max_time = 0xfff;
+	}
+	else if (ticks < UINT16_MAX) { tdbf->bits = 16; tdbf->max_time = UINT16_MAX; }
+	else if (ticks < UINT32_MAX) { tdbf->bits = 32; tdbf->max_time = UINT32_MAX; }
+	else                         { tdbf->bits = 64; tdbf->max_time = UINT64_MAX; }
 
-	tdbf->bytes = bytes;
+	tdbf->bytes = (tdbf->bits + 7) / 8;
 
-	tdbf->filter = calloc(tdbf->size, bytes);
+	tdbf->filter_size = filter_bytes(tdbf);
+
+	tdbf->filter = calloc(tdbf->filter_size, 1);
 	if (tdbf->filter == NULL) {
 		return TDBF_OUTOFMEMORY;
 	}
 
-	// calculate filter size
-	tdbf->filter_size = tdbf->size * tdbf->bytes;
-
 	return TDBF_SUCCESS;
 }
 
@@ -115,7 +203,8 @@ void tdbloom_destroy(tdbloom tdbf) {
  */
 void tdbloom_clear(tdbloom *tdbf) {
 	memset(tdbf->filter, 0, tdbf->filter_size);
-	tdbf->start_time = get_monotonic_time();
+	tdbf->start_time = get_monotonic_ms();
+	reset_sweep(tdbf);
 }
 
 /* tdbloom_reset_start_time() - resets the start time of a time-decaying bloom
@@ -129,10 +218,158 @@ void tdbloom_clear(tdbloom *tdbf) {
  *     Nothing
  */
 void tdbloom_reset_start_time(tdbloom *tdbf) {
-	tdbf->start_time = get_monotonic_time();
+	tdbf->start_time = get_monotonic_ms();
+	reset_sweep(tdbf);
 }
 
-/* tdbloom_add() - add an element to a time filter
+/* get_slot(), set_slot() -- helper functions used to handle different
+ *     timestamp widths. 12-bit timestamps are packed two per three bytes.
+ *
+ * Whole-word timestamps are read and written with relaxed atomic loads and
+ * stores, so threads may add and look up elements concurrently. This costs
+ * nothing over plain loads and stores on common hardware. Concurrent writers
+ * to the same slot simply race; whichever timestamp lands last wins, which
+ * is fine since they are at most a tick apart.
+ */
+static inline uint64_t get_slot(const tdbloom *tdbf, uint64_t position) {
+	const uint8_t *packed;
+
+	switch (tdbf->bits) {
+	case 8:  return __atomic_load_n(&((uint8_t *)tdbf->filter)[position], __ATOMIC_RELAXED);
+	case 12:
+		packed = (uint8_t *)tdbf->filter + (position >> 1) * 3;
+		if (position & 1) {
+			return (packed[1] >> 4) | (packed[2] << 4);
+		}
+		return packed[0] | ((packed[1] & 0x0f) << 8);
+	case 16: return __atomic_load_n(&((uint16_t *)tdbf->filter)[position], __ATOMIC_RELAXED);
+	case 32: return __atomic_load_n(&((uint32_t *)tdbf->filter)[position], __ATOMIC_RELAXED);
+	case 64: return __atomic_load_n(&((uint64_t *)tdbf->filter)[position], __ATOMIC_RELAXED);
+	default:
+		return 0; // shouldn't get here
+	}
+}
+
+static inline void set_slot(tdbloom *tdbf, uint64_t position, uint64_t value) {
+	uint8_t *packed;
+
+	switch (tdbf->bits) {
+	case 8:  __atomic_store_n(&((uint8_t *)tdbf->filter)[position], value, __ATOMIC_RELAXED); break;
+	case 12:
+		packed = (uint8_t *)tdbf->filter + (position >> 1) * 3;
+		if (position & 1) {
+			packed[1] = (packed[1] & 0x0f) | ((value & 0x0f) << 4);
+			packed[2] = value >> 4;
+		} else {
+			packed[0] = value;
+			packed[1] = (packed[1] & 0xf0) | ((value >> 8) & 0x0f);
+		}
+		break;
+	case 16: __atomic_store_n(&((uint16_t *)tdbf->filter)[position], value, __ATOMIC_RELAXED); break;
+	case 32: __atomic_store_n(&((uint32_t *)tdbf->filter)[position], value, __ATOMIC_RELAXED); break;
+	case 64: __atomic_store_n(&((uint64_t *)tdbf->filter)[position], value, __ATOMIC_RELAXED); break;
+	}
+}
+
+/* replace_slot() -- replace a slot's value only if it still holds 'old', so
+ *     that a thread never discards a timestamp written by another thread
+ *     after it was read.
+ *
+ * Returns:
+ *     true if the slot was replaced
+ */
+static inline bool replace_slot(tdbloom *tdbf, uint64_t position, uint64_t old, uint64_t value) {
+	uint8_t  v8  = old;
+	uint16_t v16 = old;
+	uint32_t v32 = old;
+	uint64_t v64 = old;
+
+	if (!(tdbf->flags & TDBLOOM_CONCURRENT)) {
+		set_slot(tdbf, position, value);
+		return true;
+	}
+
+	switch (tdbf->bits) {
+	case 8:  return __atomic_compare_exchange_n(&((uint8_t *)tdbf->filter)[position],  &v8,  value, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+	case 16: return __atomic_compare_exchange_n(&((uint16_t *)tdbf->filter)[position], &v16, value, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+	case 32: return __atomic_compare_exchange_n(&((uint32_t *)tdbf->filter)[position], &v32, value, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+	case 64: return __atomic_compare_exchange_n(&((uint64_t *)tdbf->filter)[position], &v64, value, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+	default:
+		return false; // shouldn't get here
+	}
+}
+
+/* current_tick() - number of ticks elapsed since the filter's start time
+ */
+static int64_t current_tick(const tdbloom *tdbf) {
+	int64_t elapsed = get_monotonic_ms() - tdbf->start_time;
+
+	return elapsed / (int64_t)tdbf->resolution;
+}
+
+/* tick_timestamp() - map a tick onto the range of stored timestamps,
+ *                    1 through max_time. 0 marks an empty slot.
+ */
+static uint64_t tick_timestamp(const tdbloom *tdbf, int64_t tick) {
+	if (tdbf->bits == 64) {
+		return (uint64_t)tick + 1;
+	}
+
+	int64_t max_time = tdbf->max_time;
+
+	return ((tick % max_time) + max_time) % max_time + 1;
+}
+
+/* timestamp_age() - number of ticks between stored timestamp 'value' and
+ *                   current timestamp 'ts', accounting for wraparound.
+ *                   with arguments swapped, this is the number of ticks
+ *                   left until an expiry timestamp.
+ */
+static uint64_t timestamp_age(const tdbloom *tdbf, uint64_t ts, uint64_t value) {
+	return (ts >= value) ? ts - value : ts + (tdbf->max_time - value);
+}
+
+/* timestamps_may_alias() - check if a stored timestamp could be old enough
+ *                          to have wrapped around into the valid range.
+ *
+ * Stored timestamps repeat every max_time ticks. Without sweeping, a filter
+ * is only trustworthy for max_time ticks after it starts. Each complete
+ * tdbloom_sweep() pass moves clean_tick forward, keeping it trustworthy as
+ * long as passes complete in less than max_time - timeout ticks.
+ */
+static bool timestamps_may_alias(const tdbloom *tdbf, int64_t now) {
+	if (tdbf->bits == 64) {
+		return false;
+	}
+
+	// expiry timestamps run up to timeout ticks ahead of now
+	if (tdbf->flags & TDBLOOM_TTL) {
+		now += tdbf->timeout_ticks;
+	}
+
+	return now - tdbf->clean_tick >= (int64_t)tdbf->max_time;
+}
+
+/* slot_ticks() - ticks since a slot was written, or with TDBLOOM_TTL, ticks
+ *                left until it expires. either way, a slot is live while
+ *                this is no more than timeout_ticks.
+ */
+static uint64_t slot_ticks(const tdbloom *tdbf, uint64_t ts, uint64_t value) {
+	if (tdbf->flags & TDBLOOM_TTL) {
+		return timestamp_age(tdbf, value, ts);
+	}
+
+	return timestamp_age(tdbf, ts, value);
+}
+
+/* seconds_to_ticks() - convert a number of seconds to ticks, rounding up
+ */
+static uint64_t seconds_to_ticks(const tdbloom *tdbf, size_t seconds) {
+	return (seconds * 1000 + tdbf->resolution - 1) / tdbf->resolution;
+}
+
+/* tdbloom_add() - add an element to a time filter. with TDBLOOM_TTL, the
+ *                 element expires after the filter's timeout.
  *
  * Args:
  *     tf      - time filter to add element to
@@ -145,74 +382,193 @@ void tdbloom_reset_start_time(tdbloom *tdbf) {
 void tdbloom_add(tdbloom *tf, void *element, const size_t len) {
 	uint64_t    result;
 	uint64_t    hash[2];
-	time_t      now = get_monotonic_time();
-	size_t      ts = ((now - tf->start_time) % tf->max_time + tf->max_time) % tf->max_time + 1;
+	uint64_t    ts;
+
+	if (tf->flags & TDBLOOM_TTL) {
+		tdbloom_add_ttl(tf, element, len, tf->timeout);
+		return;
+	}
+
+	ts = tick_timestamp(tf, current_tick(tf));
 
 	for (int i = 0; i < tf->hashcount; i++) {
 		mmh3_128(element, len, i, hash);
 		result = ((hash[0] % tf->size) + (hash[1] % tf->size)) % tf->size;
-		switch(tf->bytes) {
-		case 1:	((uint8_t *)tf->filter)[result] = ts; break;
-		case 2:	((uint16_t *)tf->filter)[result] = ts; break;
-		case 4:	((uint32_t *)tf->filter)[result] = ts; break;
-		case 8: ((uint64_t *)tf->filter)[result] = ts; break;
+		set_slot(tf, result, ts);
+	}
+}
+
+/* extend_expiry() - set a slot's expiry timestamp, unless it already holds
+ *                   a later one written by another element.
+ */
+static void extend_expiry(tdbloom *tdbf, uint64_t position, uint64_t ts, uint64_t expiry) {
+	uint64_t remaining = timestamp_age(tdbf, expiry, ts);
+
+	for (;;) {
+		uint64_t old = get_slot(tdbf, position);
+
+		if (old != 0) {
+			uint64_t old_remaining = timestamp_age(tdbf, old, ts);
+			if (old_remaining <= tdbf->timeout_ticks && old_remaining >= remaining) {
+				return;
+			}
+		}
+
+		if (replace_slot(tdbf, position, old, expiry)) {
+			return;
 		}
 	}
 }
 
-/* tdbloom_add_string() - add a string element to a time filter
+/* tdbloom_add_ttl() - add an element that expires after 'ttl' seconds to a
+ *                     filter created with TDBLOOM_TTL. this lets one filter
+ *                     hold elements with different lifetimes.
+ *
+ * Slots store expiry times rather than insertion times. When elements share
+ * a slot, the later expiry is kept, so no element expires early.
+ *
+ * Filters created without TDBLOOM_TTL can't store per-element lifetimes. The
+ * element is added with tdbloom_add() instead, and is valid for the filter's
+ * timeout.
  *
  * Args:
  *     tdbf    - time filter to add element to
  *     element - element to add to filter
+ *     len     - length of element in bytes
+ *     ttl     - number of seconds the element is valid. values greater
+ *               than the filter's timeout are treated as the timeout.
  *
  * Returns:
  *     Nothing
  */
-void tdbloom_add_string(tdbloom tdbf, const char *element) {
-	tdbloom_add(&tdbf, (uint8_t *)element, strlen(element));
+void tdbloom_add_ttl(tdbloom *tdbf, void *element, const size_t len, const size_t ttl) {
+	uint64_t    result;
+	uint64_t    hash[2];
+	int64_t     now       = current_tick(tdbf);
+	uint64_t    ttl_ticks = seconds_to_ticks(tdbf, ttl);
+
+	if (!(tdbf->flags & TDBLOOM_TTL)) {
+		tdbloom_add(tdbf, element, len);
+		return;
+	}
+
+	if (ttl_ticks > tdbf->timeout_ticks) {
+		ttl_ticks = tdbf->timeout_ticks;
+	}
+
+	uint64_t ts     = tick_timestamp(tdbf, now);
+	uint64_t expiry = tick_timestamp(tdbf, now + ttl_ticks);
+
+	for (int i = 0; i < tdbf->hashcount; i++) {
+		mmh3_128(element, len, i, hash);
+		result = ((hash[0] % tdbf->size) + (hash[1] % tdbf->size)) % tdbf->size;
+		extend_expiry(tdbf, result, ts, expiry);
+	}
 }
 
-/* tdbloom_lookup() - check if element exists within tdbloom
+/* tdbloom_add_ttl_string() - add a string element with its own ttl
  *
  * Args:
- *     tdbf    - time filter to perform lookup against
- *     element - element to search for
- *     len     - length of element to search (bytes)
+ *     tdbf    - time filter to add element to
+ *     element - element to add to filter
+ *     ttl     - number of seconds the element is valid
  *
  * Returns:
- *     true if element is in filter
- *     false if element is not in filter
+ *     Nothing
  */
-bool tdbloom_lookup(const tdbloom tdbf, void *element, const size_t len) {
+void tdbloom_add_ttl_string(tdbloom *tdbf, const char *element, const size_t ttl) {
+	tdbloom_add_ttl(tdbf, (uint8_t *)element, strlen(element), ttl);
+}
+
+/* tdbloom_add_string() - add a string element to a time filter
+ *
+ * Args:
+ *     tdbf    - time filter to add element to
+ *     element - element to add to filter
+ *
+ * Returns:
+ *     Nothing
+ */
+void tdbloom_add_string(tdbloom *tdbf, const char *element) {
+	tdbloom_add(tdbf, (uint8_t *)element, strlen(element));
+}
+
+/* element_probe() - check an element's slots.
+ *
+ * Each slot holds the time it was last written by any element, which is
+ * never older than the time this element was added. The oldest of the
+ * element's slots is therefore the closest estimate of its age. With
+ * TDBLOOM_TTL, the slot expiring soonest is the closest estimate of the
+ * element's remaining lifetime.
+ *
+ * Returns:
+ *     true and sets 'ticks' to the element's age, or remaining lifetime
+ *     with TDBLOOM_TTL, if the element is live
+ *     false if element is not in the filter or has expired
+ */
+static bool element_probe(const tdbloom *tdbf, void *element, const size_t len, uint64_t *ticks) {
 	uint64_t    result;
 	uint64_t    hash[2];
-	time_t      now = get_monotonic_time();
-	size_t      ts = ((now - tdbf.start_time) % tdbf.max_time + tdbf.max_time) % tdbf.max_time + 1;
+	int64_t     now        = current_tick(tdbf);
+	uint64_t    ts         = tick_timestamp(tdbf, now);
+	bool        ttl        = tdbf->flags & TDBLOOM_TTL;
+	bool        concurrent = tdbf->flags & TDBLOOM_CONCURRENT;
+	uint64_t    bound      = ttl ? UINT64_MAX : 0;
 
-	if ((now - tdbf.start_time) > tdbf.max_time) { return false; }
+	if (timestamps_may_alias(tdbf, now)) { return false; }
 
-	for (int i = 0; i < tdbf.hashcount; i++) {
+	for (int i = 0; i < tdbf->hashcount; i++) {
 		mmh3_128(element, len, i, hash);
-		result = ((hash[0] % tdbf.size) + (hash[1] % tdbf.size)) % tdbf.size;
-
-		size_t value;
-		switch(tdbf.bytes) {
-		case 1:	value = ((uint8_t *)tdbf.filter)[result];  break;
-		case 2:	value = ((uint16_t *)tdbf.filter)[result]; break;
-		case 4:	value = ((uint32_t *)tdbf.filter)[result]; break;
-		case 8:	value = ((uint64_t *)tdbf.filter)[result]; break;
+		result = ((hash[0] % tdbf->size) + (hash[1] % tdbf->size)) % tdbf->size;
+
+		uint64_t value = get_slot(tdbf, result);
+		if (value == 0) {
+			return false;
 		}
 
-		if (value == 0 ||
-			((ts - value + tdbf.max_time) % tdbf.max_time) > tdbf.timeout) {
+		uint64_t slot = slot_ticks(tdbf, ts, value);
+		if (slot > tdbf->timeout_ticks) {
+			// another thread may have read a later tick and stored it
+			// after 'now' was taken. start over against the current tick
+			// before reporting a miss.
+			int64_t later = concurrent ? current_tick(tdbf) : now;
+			if (later != now) {
+				now   = later;
+				ts    = tick_timestamp(tdbf, now);
+				bound = ttl ? UINT64_MAX : 0;
+				i     = -1;
+				continue;
+			}
 			return false;
 		}
+
+		if (ttl ? slot < bound : slot > bound) {
+			bound = slot;
+		}
 	}
 
+	*ticks = bound;
+
 	return true;
 }
 
+/* tdbloom_lookup() - check if element exists within tdbloom
+ *
+ * Args:
+ *     tdbf    - time filter to perform lookup against
+ *     element - element to search for
+ *     len     - length of element to search (bytes)
+ *
+ * Returns:
+ *     true if element is in filter
+ *     false if element is not in filter
+ */
+bool tdbloom_lookup(const tdbloom tdbf, void *element, const size_t len) {
+	uint64_t ticks;
+
+	return element_probe(&tdbf, element, len, &ticks);
+}
+
 /* tdbloom_lookup_string() -- helper function to handle string lookups
  *
  * Args:
@@ -228,15 +584,422 @@ bool tdbloom_lookup_string(const tdbloom tdbf, const char *element) {
 }
 
 
+/* tdbloom_lookup_age() - check if element exists within tdbloom, and
+ *                        estimate how long ago it was added
+ *
+ * The estimate is never older than the element's true age, and is
+ * accurate to the filter's resolution unless every one of the element's
+ * slots has since been overwritten by other elements.
+ *
+ * Args:
+ *     tdbf    - time filter to perform lookup against
+ *     element - element to search for
+ *     len     - length of element to search (bytes)
+ *     age     - set to the element's estimated age in milliseconds if found
+ *
+ * Returns:
+ *     true if element is in filter
+ *     false if element is not in filter, or the filter stores expiry times
+ *     (TDBLOOM_TTL). 'age' is left untouched.
+ */
+bool tdbloom_lookup_age(const tdbloom tdbf, void *element, const size_t len, uint64_t *age) {
+	uint64_t ticks;
+
+	if ((tdbf.flags & TDBLOOM_TTL) ||
+		element_probe(&tdbf, element, len, &ticks) == false) {
+		return false;
+	}
+
+	*age = ticks * tdbf.resolution;
+
+	return true;
+}
+
+/* tdbloom_lookup_age_string() - helper function to handle string lookups
+ *
+ * Args:
+ *     tdbf    - filter to use
+ *     element - string element to lookup
+ *     age     - set to the element's estimated age in milliseconds if found
+ *
+ * Returns:
+ *     true if element is likely in the filter
+ *     false if element is definitely not in the filter
+ */
+bool tdbloom_lookup_age_string(const tdbloom tdbf, const char *element, uint64_t *age) {
+	return tdbloom_lookup_age(tdbf, (uint8_t *)element, strlen(element), age);
+}
+
+/* tdbloom_lookup_ttl() - check if element exists within a filter created
+ *                        with TDBLOOM_TTL, and estimate how long it has left
+ *
+ * Args:
+ *     tdbf      - time filter to perform lookup against
+ *     element   - element to search for
+ *     len       - length of element to search (bytes)
+ *     remaining - set to the element's remaining lifetime in milliseconds
+ *
+ * Returns:
+ *     true if element is in filter
+ *     false if element is not in filter or the filter doesn't store expiry
+ *     times. 'remaining' is left untouched.
+ */
+bool tdbloom_lookup_ttl(const tdbloom tdbf, void *element, const size_t len, uint64_t *remaining) {
+	uint64_t ticks;
+
+	if (!(tdbf.flags & TDBLOOM_TTL) ||
+		element_probe(&tdbf, element, len, &ticks) == false) {
+		return false;
+	}
+
+	*remaining = ticks * tdbf.resolution;
+
+	return true;
+}
+
+/* tdbloom_lookup_windows() - check if an element was seen within each of
+ *                            several windows using a single probe.
+ *
+ * This lets one filter replace a stack of filters with different timeouts,
+ * as long as the filter's own timeout is at least as long as the largest
+ * window. Windows longer than the filter's timeout are answered as if they
+ * were equal to it.
+ *
+ * Args:
+ *     tdbf    - time filter to perform lookup against
+ *     element - element to search for
+ *     len     - length of element to search (bytes)
+ *     windows - array of window lengths in seconds
+ *     count   - number of windows
+ *     results - array of 'count' booleans, set to true if the element was
+ *               seen within the corresponding window
+ *
+ * Returns:
+ *     true if element was seen within the filter's timeout
+ *     false if element is not in the filter, or the filter stores expiry
+ *     times (TDBLOOM_TTL)
+ */
+bool tdbloom_lookup_windows(const tdbloom tdbf, void *element, const size_t len, const size_t *windows, const size_t count, bool *results) {
+	uint64_t age;
+	bool     found = !(tdbf.flags & TDBLOOM_TTL) &&
+		element_probe(&tdbf, element, len, &age);
+
+	for (size_t i = 0; i < count; i++) {
+		results[i] = found && age <= seconds_to_ticks(&tdbf, windows[i]);
+	}
+
+	return found;
+}
+
+/* sweep_scalar() - zero expired slots in [start, end) one at a time.
+ *
+ * Returns:
+ *     number of slots cleared. 'live' is incremented by the number of
+ *     non-empty slots left behind.
+ */
+static size_t sweep_scalar(tdbloom *tdbf, size_t start, size_t end, uint64_t ts, size_t *live) {
+	size_t cleared = 0;
+
+	for (size_t i = start; i < end; i++) {
+		uint64_t value = get_slot(tdbf, i);
+		if (value == 0) {
+			continue;
+		}
+
+		if (slot_ticks(tdbf, ts, value) > tdbf->timeout_ticks) {
+			// with TDBLOOM_CONCURRENT, a writer may have read a later tick
+			// than 'ts' and stored it since. only clear the slot if it is
+			// also expired as of the current tick.
+			if (tdbf->flags & TDBLOOM_CONCURRENT) {
+				ts = tick_timestamp(tdbf, current_tick(tdbf));
+				if (slot_ticks(tdbf, ts, value) <= tdbf->timeout_ticks) {
+					*live += 1;
+					continue;
+				}
+			}
+
+			if (replace_slot(tdbf, i, value, 0)) {
+				cleared++;
+			}
+		} else {
+			*live += 1;
+		}
+	}
+
+	return cleared;
+}
+
+#ifdef __SSE2__
+/* sweep8_sse2(), sweep16_sse2() - zero expired 8 and 16 bit slots 16 bytes at
+ *     a time. A slot is live if its value lies within [lo, hi], or outside of
+ *     (hi, lo) when the live range wraps around. Unsigned comparisons are
+ *     done with saturating subtraction: a >= b when b - a saturates to 0.
+ *
+ * Returns:
+ *     number of slots cleared. 'live' is incremented by the number of
+ *     non-empty slots left behind. A tail of fewer than 16 bytes is left
+ *     for sweep_scalar().
+ */
+static size_t sweep8_sse2(uint8_t *slots, size_t count, uint8_t lo, uint8_t hi, size_t *live) {
+	__m128i vlo     = _mm_set1_epi8(lo);
+	__m128i vhi     = _mm_set1_epi8(hi);
+	__m128i zero    = _mm_setzero_si128();
+	bool    wrapped = lo > hi;
+	size_t  cleared = 0;
+
+	for (size_t i = 0; i + 16 <= count; i += 16) {
+		__m128i v     = _mm_loadu_si128((__m128i *)(slots + i));
+		__m128i ge_lo = _mm_cmpeq_epi8(_mm_subs_epu8(vlo, v), zero);
+		__m128i le_hi = _mm_cmpeq_epi8(_mm_subs_epu8(v, vhi), zero);
+		__m128i keep  = wrapped ? _mm_or_si128(ge_lo, le_hi) : _mm_and_si128(ge_lo, le_hi);
+		__m128i empty = _mm_cmpeq_epi8(v, zero);
+
+		int expired = _mm_movemask_epi8(_mm_andnot_si128(_mm_or_si128(keep, empty), _mm_set1_epi8(-1)));
+		*live += __builtin_popcount(_mm_movemask_epi8(_mm_andnot_si128(empty, keep)));
+
+		if (expired != 0) {
+			_mm_storeu_si128((__m128i *)(slots + i), _mm_and_si128(v, keep));
+			cleared += __builtin_popcount(expired);
+		}
+	}
+
+	return cleared;
+}
+
+static size_t sweep16_sse2(uint16_t *slots, size_t count, uint16_t lo, uint16_t hi, size_t *live) {
+	__m128i vlo     = _mm_set1_epi16(lo);
+	__m128i vhi     = _mm_set1_epi16(hi);
+	__m128i zero    = _mm_setzero_si128();
+	bool    wrapped = lo > hi;
+	size_t  cleared = 0;
+
+	for (size_t i = 0; i + 8 <= count; i += 8) {
+		__m128i v     = _mm_loadu_si128((__m128i *)(slots + i));
+		__m128i ge_lo = _mm_cmpeq_epi16(_mm_subs_epu16(vlo, v), zero);
+		__m128i le_hi = _mm_cmpeq_epi16(_mm_subs_epu16(v, vhi), zero);
+		__m128i keep  = wrapped ? _mm_or_si128(ge_lo, le_hi) : _mm_and_si128(ge_lo, le_hi);
+		__m128i empty = _mm_cmpeq_epi16(v, zero);
+
+		// movemask yields 2 bits per 16 bit lane
+		int expired = _mm_movemask_epi8(_mm_andnot_si128(_mm_or_si128(keep, empty), _mm_set1_epi8(-1)));
+		*live += __builtin_popcount(_mm_movemask_epi8(_mm_andnot_si128(empty, keep))) / 2;
+
+		if (expired != 0) {
+			_mm_storeu_si128((__m128i *)(slots + i), _mm_and_si128(v, keep));
+			cleared += __builtin_popcount(expired) / 2;
+		}
+	}
+
+	return cleared;
+}
+#endif /* __SSE2__ */
+
+/* sweep_chunk() - zero expired slots in [start, end), using SIMD compares
+ *                 for 8 and 16 bit timestamps when available.
+ */
+static size_t sweep_chunk(tdbloom *tdbf, size_t start, size_t end, int64_t now, size_t *live) {
+	uint64_t ts      = tick_timestamp(tdbf, now);
+	size_t   cleared = 0;
+
+#ifdef __SSE2__
+	// live timestamps lie within [lo, hi]: insertion times up to timeout
+	// ticks ago, or expiry times up to timeout ticks ahead.
+	uint64_t lo = ts;
+	uint64_t hi = ts;
+	size_t   vectorized = 0;
+
+	if (tdbf->flags & TDBLOOM_TTL) {
+		hi = tick_timestamp(tdbf, now + (int64_t)tdbf->timeout_ticks);
+	} else {
+		lo = tick_timestamp(tdbf, now - (int64_t)tdbf->timeout_ticks);
+	}
+
+	// vector stores could overwrite timestamps written by other threads
+	switch ((tdbf->flags & TDBLOOM_CONCURRENT) ? 0 : tdbf->bits) {
+	case 8:
+		vectorized = (end - start) & ~(size_t)15;
+		cleared = sweep8_sse2((uint8_t *)tdbf->filter + start, vectorized, lo, hi, live);
+		break;
+	case 16:
+		vectorized = (end - start) & ~(size_t)7;
+		cleared = sweep16_sse2((uint16_t *)tdbf->filter + start, vectorized, lo, hi, live);
+		break;
+	}
+
+	start += vectorized;
+#endif /* __SSE2__ */
+
+	return cleared + sweep_scalar(tdbf, start, end, ts, live);
+}
+
+/* tdbloom_sweep() - incrementally zero expired slots
+ *
+ * Expired timestamps are otherwise never cleared. Because timestamps wrap
+ * around every max_time ticks, a stale timestamp can eventually look fresh
+ * again, so lookups on a filter that is never swept start failing after
+ * max_time ticks. Calling this regularly, with a budget that completes a
+ * pass over the filter in less than (max_time - timeout) ticks, keeps the
+ * filter usable indefinitely with narrow timestamps and without losing its
+ * contents to tdbloom_clear().
+ *
+ * Each call checks at most 'budget' slots, continuing where the previous
+ * call left off, so the cost can be spread out over time. With
+ * TDBLOOM_CONCURRENT, this can run on a helper thread while other threads
+ * add and look up elements, but only one thread may sweep at a time.
+ *
+ * Args:
+ *     tdbf   - filter to sweep
+ *     budget - maximum number of slots to check
+ *
+ * Returns:
+ *     number of expired slots that were cleared
+ */
+size_t tdbloom_sweep(tdbloom *tdbf, const size_t budget) {
+	int64_t now       = current_tick(tdbf);
+	size_t  remaining = budget;
+	size_t  cleared   = 0;
+
+	while (remaining > 0) {
+		if (tdbf->sweep_position == 0) {
+			tdbf->sweep_tick = now;
+			tdbf->sweep_live = 0;
+		}
+
+		size_t end = tdbf->sweep_position + remaining;
+		if (end > tdbf->size) {
+			end = tdbf->size;
+		}
+
+		cleared += sweep_chunk(tdbf, tdbf->sweep_position, end, now, &tdbf->sweep_live);
+		remaining -= end - tdbf->sweep_position;
+		tdbf->sweep_position = end;
+
+		if (tdbf->sweep_position == tdbf->size) {
+			// every slot surviving this pass was written within the timeout
+			// of the pass starting, or after it started. expiry timestamps
+			// surviving the pass are no earlier than its start.
+			int64_t clean = tdbf->sweep_tick;
+			if (!(tdbf->flags & TDBLOOM_TTL)) {
+				clean -= tdbf->timeout_ticks;
+			}
+
+			__atomic_store_n(&tdbf->clean_tick, clean, __ATOMIC_RELAXED);
+			tdbf->live_slots     = tdbf->sweep_live;
+			tdbf->sweep_position = 0;
+		}
+	}
+
+	return cleared;
+}
+
+/* tdbloom_count_estimate() - estimate the number of live elements in a
+ *                            filter from the number of live slots counted
+ *                            by the last complete tdbloom_sweep() pass.
+ *
+ * Args:
+ *     tdbf - filter to check
+ *
+ * Returns:
+ *     estimated number of elements added within the timeout
+ */
+size_t tdbloom_count_estimate(const tdbloom tdbf) {
+	if (tdbf.live_slots >= tdbf.size) {
+		return tdbf.expected;
+	}
+
+	double m = tdbf.size;
+	double k = tdbf.hashcount;
+
+	return -(m / k) * log(1.0 - tdbf.live_slots / m);
+}
+
+/* tdbloom_anchor -- ties a saved filter's monotonic time base to the wall
+ *                   clock, so it can be rebased after CLOCK_MONOTONIC resets
+ */
+typedef struct {
+	int64_t wall_ms;     /* CLOCK_REALTIME when the filter was saved */
+	int64_t elapsed_ms;  /* time elapsed since start_time when saved */
+} tdbloom_anchor;
+
+/* get_realtime_ms() - get wall clock time in milliseconds
+ */
+static int64_t get_realtime_ms() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* copy_slots() - copy a filter's timestamps to 'dest'. concurrent filters
+ *                are copied one slot at a time so that timestamps being
+ *                written by other threads are never torn.
+ */
+static void copy_slots(const tdbloom *tdbf, void *dest, size_t first, size_t count) {
+	tdbloom copy = *tdbf;
+
+	if (!(tdbf->flags & TDBLOOM_CONCURRENT)) {
+		memcpy(dest, (uint8_t *)tdbf->filter + first * tdbf->bytes, count * tdbf->bytes);
+		return;
+	}
+
+	copy.filter = dest;
+	for (size_t i = 0; i < count; i++) {
+		set_slot(&copy, i, get_slot(tdbf, first + i));
+	}
+}
+
+/* tdbloom_snapshot() -- make a point-in-time copy of a filter, which can
+ *                       then be saved with tdbloom_save() without holding
+ *                       up threads using the original.
+ *
+ * Concurrent filters may keep being written while the copy is made; each
+ * slot in the copy holds either its old or its new timestamp.
+ *
+ * Args:
+ *     tdbf     - filter to copy
+ *     snapshot - tdbloom struct of the copy. free with tdbloom_destroy()
+ *
+ * Returns:
+ *     TDBF_SUCCESS on success
+ *     TDBF_OUTOFMEMORY if memory allocation failed
+ */
+tdbloom_error_t tdbloom_snapshot(const tdbloom *tdbf, tdbloom *snapshot) {
+	*snapshot = *tdbf;
+
+	snapshot->filter = malloc(tdbf->filter_size);
+	if (snapshot->filter == NULL) {
+		return TDBF_OUTOFMEMORY;
+	}
+
+	if (tdbf->bits == 12) {
+		memcpy(snapshot->filter, tdbf->filter, tdbf->filter_size);
+	} else {
+		copy_slots(tdbf, snapshot->filter, 0, tdbf->size);
+	}
+
+	return TDBF_SUCCESS;
+}
+
 /* tdbloom_save() -- save a time-decaying bloom filter to disk
  *
  * Format of these files on disk is:
  *    +------------------+
  *    |  tdbloom struct  |
  *    +------------------+
- *    |      bitmap      |
+ *    |  tdbloom anchor  |
+ *    +------------------+
+ *    |    timestamps    |
  *    +------------------+
  *
+ * The anchor records the wall clock time and the filter's age when saved.
+ * tdbloom_load() uses it to rebase the filter onto the loading host's
+ * monotonic clock, so timestamps keep decaying across restarts.
+ *
+ * Concurrent filters are saved a chunk at a time without blocking other
+ * threads, so this may be called from a background thread. Otherwise, use
+ * tdbloom_snapshot() and save the snapshot to keep saves off the hot path.
+ *
  * Args:
  *     tdbf - filter to save
  *     path - file path to save filter
@@ -245,11 +1008,14 @@ bool tdbloom_lookup_string(const tdbloom tdbf, const char *element) {
  *      TDBF_SUCCESS on success
  *      TDBF_FOPEN if unable to open file for writing
  *      TDBF_FWRITE if unable to write to file
- *
- * TODO: test tdbloom_save()
+ *      TDBF_OUTOFMEMORY if memory allocation failed
  */
 tdbloom_error_t tdbloom_save(tdbloom tdbf, const char *path) {
-	FILE *fp;
+	FILE           *fp;
+	tdbloom_anchor  anchor;
+
+	anchor.wall_ms    = get_realtime_ms();
+	anchor.elapsed_ms = get_monotonic_ms() - tdbf.start_time;
 
 	fp = fopen(path, "wb");
 	if (fp == NULL) {
@@ -257,16 +1023,68 @@ tdbloom_error_t tdbloom_save(tdbloom tdbf, const char *path) {
 	}
 
 	if (fwrite(&tdbf, sizeof(tdbloom), 1, fp) != 1 ||
-		fwrite(tdbf.filter, tdbf.filter_size, 1, fp)) {
+		fwrite(&anchor, sizeof(tdbloom_anchor), 1, fp) != 1) {
 		fclose(fp);
 		return TDBF_FWRITE;
 	}
 
+	if (!(tdbf.flags & TDBLOOM_CONCURRENT)) {
+		if (fwrite(tdbf.filter, tdbf.filter_size, 1, fp) != 1) {
+			fclose(fp);
+			return TDBF_FWRITE;
+		}
+
+		fclose(fp);
+		return TDBF_SUCCESS;
+	}
+
+	const size_t  chunk  = 65536;
+	uint8_t      *buffer = malloc(chunk * tdbf.bytes);
+	if (buffer == NULL) {
+		fclose(fp);
+		return TDBF_OUTOFMEMORY;
+	}
+
+	for (size_t first = 0; first < tdbf.size; first += chunk) {
+		size_t count = (tdbf.size - first < chunk) ? tdbf.size - first : chunk;
+
+		copy_slots(&tdbf, buffer, first, count);
+		if (fwrite(buffer, count * tdbf.bytes, 1, fp) != 1) {
+			free(buffer);
+			fclose(fp);
+			return TDBF_FWRITE;
+		}
+	}
+
+	free(buffer);
 	fclose(fp);
 
 	return TDBF_SUCCESS;
 }
 
+/* rebase() - move a loaded filter's start time onto this host's monotonic
+ *            clock, accounting for wall clock time passed since it was saved.
+ *
+ * If more time has passed than timestamps can represent, every element has
+ * expired, and the filter is cleared rather than risk stale timestamps
+ * looking fresh.
+ */
+static void rebase(tdbloom *tdbf, const tdbloom_anchor *anchor) {
+	int64_t downtime = get_realtime_ms() - anchor->wall_ms;
+	int64_t now      = get_monotonic_ms();
+
+	// wall clock went backwards; assume no time passed
+	if (downtime < 0) {
+		downtime = 0;
+	}
+
+	tdbf->start_time = now - (anchor->elapsed_ms + downtime);
+
+	if (timestamps_may_alias(tdbf, current_tick(tdbf))) {
+		tdbloom_clear(tdbf);
+	}
+}
+
 /* tdbloom_load() -- load a time-decaying bloom filter from disk
  *
  * Args:
@@ -280,12 +1098,11 @@ tdbloom_error_t tdbloom_save(tdbloom tdbf, const char *path) {
  *     TDBF_FSTAT if fstat() fails
  *     TDBF_INVALIDFILE if file format is incorrect
  *     TDBF_OUTOFMEMORY if memory allocation failed
- *
- * TODO: test tdbloom_save()
  */
 tdbloom_error_t tdbloom_load(tdbloom *tdbf, const char *path) {
-	FILE        *fp;
-	struct stat  sb;
+	FILE           *fp;
+	struct stat     sb;
+	tdbloom_anchor  anchor;
 
 	fp = fopen(path, "rb");
 	if (fp == NULL) {
@@ -297,14 +1114,16 @@ tdbloom_error_t tdbloom_load(tdbloom *tdbf, const char *path) {
 		return TDBF_FSTAT;
 	}
 
-	if (fread(tdbf, sizeof(tdbloom), 1, fp) != 1) {
+	if (fread(tdbf, sizeof(tdbloom), 1, fp) != 1 ||
+		fread(&anchor, sizeof(tdbloom_anchor), 1, fp) != 1) {
 		fclose(fp);
 		return TDBF_FREAD;
 	}
 
 	// basic sanity checks. should fail if file is not a filter
-	if (tdbf->filter_size != (tdbf->size * tdbf->bytes) ||
-		(sizeof(tdbloom) + tdbf->filter_size) != sb.st_size) {
+	if (tdbf->resolution == 0 ||
+		tdbf->filter_size != filter_bytes(tdbf) ||
+		(sizeof(tdbloom) + sizeof(tdbloom_anchor) + tdbf->filter_size) != sb.st_size) {
 		fclose(fp);
 		return TDBF_INVALIDFILE;
 	}
@@ -323,6 +1142,8 @@ tdbloom_error_t tdbloom_load(tdbloom *tdbf, const char *path) {
 
 	fclose(fp);
 
+	rebase(tdbf, &anchor);
+
 	return TDBF_SUCCESS;
 }
 
@@ -1,5 +1,4 @@
 /* tdbloom.h
- * TODO: calculate used/remaining capacity of filters
  */
 #ifndef TDBLOOM_H
 #define TDBLOOM_H
@@ -19,22 +18,25 @@ typedef enum {
 	TDBF_FWRITE,
 	TDBF_FSTAT,
 	TDBF_INVALIDFILE,
+	TDBF_INVALIDRESOLUTION,
 	// used for counting number of statuses. don't add statuses below this line
 	TDBF_ERRORCOUNT
 } tdbloom_error_t;
 
-/* tdbloom_errors -- human-readable error messages
+/* tdbloom_errors -- human-readable error messages. defined in tdbloom.c so
+ *                   the header can be included by more than one file.
  */
-const char *tdbloom_errors[] = {
-	"Success",
-	"Invalid timeout value",
-	"Out of memory",
-	"Unable to open file",
-	"Unable to read file",
-	"Unable to write to file",
-	"fstat() error",
-	"Invalid file format"
-};
+extern const char *tdbloom_errors[];
+
+/* flags for tdbloom_init_ex()
+ */
+#define TDBLOOM_PACKED12   0x01 /* allow packing 12-bit timestamps, 2 per 3 bytes */
+#define TDBLOOM_CONCURRENT 0x02 /* allow use from multiple threads at once */
+#define TDBLOOM_TTL        0x04 /* store expiry times for per-element ttls */
+
+/* TDBLOOM_RESOLUTION_DEFAULT -- default timestamp tick, in milliseconds
+ */
+#define TDBLOOM_RESOLUTION_DEFAULT 1000
 
 /* tdbloom -- time-decaying bloom filter structure
  */
@@ -42,12 +44,21 @@ typedef struct {
 	size_t  size;          /* size of time filter */
 	size_t  hashcount;     /* number of hashes per element */
 	size_t  timeout;       /* number of seconds an element is valid */
-	size_t  filter_size;   /* number of time_t values in time filter */
-	time_t  start_time;    /* time of filter initialization */
+	size_t  resolution;    /* milliseconds per timestamp tick */
+	size_t  timeout_ticks; /* number of ticks an element is valid */
+	size_t  filter_size;   /* size of time filter in bytes */
+	int64_t start_time;    /* monotonic milliseconds at initialization */
 	size_t  expected;      /* expected number of elements */
 	float   accuracy;      /* desired margin of error */
 	size_t  max_time;      /* maximum value of timestamp */
-	int     bytes;         /* byte size of timestamps */
+	int     bytes;         /* byte size of timestamps, rounded up */
+	int     bits;          /* bit width of timestamps: 8, 12, 16, 32, 64 */
+	int     flags;         /* TDBLOOM_* flags passed at initialization */
+	size_t  sweep_position;  /* next slot to be checked by tdbloom_sweep() */
+	int64_t sweep_tick;      /* tick the current sweep pass started */
+	size_t  sweep_live;      /* live slots seen so far in current pass */
+	int64_t clean_tick;      /* no stored timestamp is older than this tick */
+	size_t  live_slots;      /* live slots seen in last complete pass */
 	void   *filter;        /* array of time_t elements */
 } tdbloom;
 
@@ -57,13 +68,33 @@ tdbloom_error_t  tdbloom_init(tdbloom *,
 							  const size_t,
 							  const float,
 							  const size_t);
+tdbloom_error_t  tdbloom_init_ex(tdbloom *,
+								 const size_t,
+								 const float,
+								 const size_t,
+								 const size_t,
+								 const int);
 void             tdbloom_destroy(tdbloom);
 void             tdbloom_clear(tdbloom *);
 void             tdbloom_reset_start_time(tdbloom *);
 void             tdbloom_add(tdbloom *, void *, const size_t);
-void             tdbloom_add_string(tdbloom, const char *);
+void             tdbloom_add_string(tdbloom *, const char *);
+void             tdbloom_add_ttl(tdbloom *, void *, const size_t, const size_t);
+void             tdbloom_add_ttl_string(tdbloom *, const char *, const size_t);
 bool             tdbloom_lookup(const tdbloom, void *, const size_t);
 bool             tdbloom_lookup_string(const tdbloom, const char *);
+bool             tdbloom_lookup_age(const tdbloom, void *, const size_t, uint64_t *);
+bool             tdbloom_lookup_age_string(const tdbloom, const char *, uint64_t *);
+bool             tdbloom_lookup_ttl(const tdbloom, void *, const size_t, uint64_t *);
+size_t           tdbloom_sweep(tdbloom *, const size_t);
+size_t           tdbloom_count_estimate(const tdbloom);
+bool             tdbloom_lookup_windows(const tdbloom,
+										void *,
+										const size_t,
+										const size_t *,
+										const size_t,
+										bool *);
+tdbloom_error_t  tdbloom_snapshot(const tdbloom *, tdbloom *);
 tdbloom_error_t  tdbloom_save(tdbloom, const char *);
 tdbloom_error_t  tdbloom_load(tdbloom *, const char *);
 const char      *tdbloom_strerror(tdbloom_error_t);
@@ -0,0 +1,495 @@
+/* tdcbloom.c
+ *
+ * Time-decaying counting bloom filter. This answers "how many times was
+ * this element seen in the last N seconds?", which is the question a
+ * sliding-window rate limiter asks.
+ *
+ * Each slot holds a ring of counters, one per 'span' milliseconds of the
+ * window, along with the epoch (span number) of the newest counter written.
+ * Buckets that have fallen out of the window are cleared lazily, when the
+ * slot is next written. Keeping the epoch and counters together means an
+ * element costs one hash per position and touches one cache line per slot,
+ * rather than hashing into a counting filter and a time filter separately.
+ *
+ * Counts use the same approximation as cbloom_count(): the smallest count
+ * among an element's slots, which is never less than the true count unless
+ * counters saturate.
+ */
+#include <time.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "mmh3.h"
+#include "cbloom.h"
+#include "tdcbloom.h"
+
+const char *tdcbloom_errors[] = {
+	"Success",
+	"Invalid window value",
+	"Invalid number of buckets",
+	"Invalid counter size",
+	"Out of memory"
+};
+
+/* TDCBLOOM_BATCH -- number of elements hashed and prefetched at a time by
+ *                   the batch functions.
+ */
+#define TDCBLOOM_BATCH 16
+
+/* ideal_size() - calculate ideal size of a filter based on the expected
+ *                number of elements and desired accuracy.
+ *
+ * Args:
+ *     expected - expected number of elements
+ *     accuracy - margin of error. ex: 0.01 if you want 99.99% accuracy
+ *
+ * Returns:
+ *     unsigned integer
+ */
+static uint64_t ideal_size(const uint64_t expected, const float accuracy) {
+	return -(expected * log(accuracy) / pow(log(2.0), 2));
+}
+
+/* get_monotonic_ms() - get monotonic time in milliseconds.
+ *
+ * Args:
+ *     None
+ *
+ * Returns:
+ *     int64_t holding CLOCK_MONOTONIC value in milliseconds
+ */
+static int64_t get_monotonic_ms() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* tdcbloom_init() - initialize a time-decaying counting bloom filter
+ *
+ * The number of hashes is picked from 'accuracy', clamped to 1 through
+ * TDCBLOOM_MAX_HASHES.
+ *
+ * Args:
+ *     tdcbf    - pointer to tdcbloom structure
+ *     expected - maximum expected number of elements within one window
+ *     accuracy - acceptable false positive rate. ex: 0.01 == 99.99%
+ *     window   - number of seconds counts are kept
+ *     buckets  - number of counters per slot. more buckets track the
+ *                window more closely at the cost of memory.
+ *     csize    - size of counters: COUNTER_8BIT, _16BIT, _32BIT, _64BIT
+ *
+ * Returns:
+ *     TDCBF_SUCCESS on success
+ *     TDCBF_INVALIDWINDOW if 'window' is 0
+ *     TDCBF_INVALIDBUCKETS if 'buckets' is 0
+ *     TDCBF_INVALIDCOUNTERSIZE if 'csize' is invalid
+ *     TDCBF_OUTOFMEMORY if unable to allocate memory
+ */
+tdcbloom_error_t tdcbloom_init(tdcbloom *tdcbf, const size_t expected, const float accuracy, const size_t window, const size_t buckets, counter_size csize) {
+	if (window == 0) {
+		return TDCBF_INVALIDWINDOW;
+	}
+
+	if (buckets == 0 || buckets > UINT32_MAX) {
+		return TDCBF_INVALIDBUCKETS;
+	}
+
+	switch (csize) {
+	case COUNTER_8BIT:  tdcbf->counter_bytes = sizeof(uint8_t);  break;
+	case COUNTER_16BIT: tdcbf->counter_bytes = sizeof(uint16_t); break;
+	case COUNTER_32BIT: tdcbf->counter_bytes = sizeof(uint32_t); break;
+	case COUNTER_64BIT: tdcbf->counter_bytes = sizeof(uint64_t); break;
+	default:
+		return TDCBF_INVALIDCOUNTERSIZE;
+	}
+
+	tdcbf->size       = ideal_size(expected, accuracy);
+	tdcbf->hashcount  = (tdcbf->size / expected) * log(2);
+	tdcbf->window     = window;
+	tdcbf->buckets    = buckets;
+	tdcbf->span       = (window * 1000 + buckets - 1) / buckets;
+	tdcbf->csize      = csize;
+	tdcbf->expected   = expected;
+	tdcbf->accuracy   = accuracy;
+	tdcbf->start_time = get_monotonic_ms();
+
+	// loose accuracies round the hash count down to 0, and the batch
+	// functions keep TDCBLOOM_MAX_HASHES positions per element
+	if (tdcbf->hashcount < 1) {
+		tdcbf->hashcount = 1;
+	} else if (tdcbf->hashcount > TDCBLOOM_MAX_HASHES) {
+		tdcbf->hashcount = TDCBLOOM_MAX_HASHES;
+	}
+
+	// a multiple of 'buckets' keeps each epoch's ring position the same when
+	// stored epochs wrap around.
+	tdcbf->cycle = (UINT32_MAX / buckets) * buckets;
+
+	// the epoch is padded to the counter width so counters stay aligned
+	size_t header = (tdcbf->counter_bytes > sizeof(uint32_t)) ? tdcbf->counter_bytes : sizeof(uint32_t);
+	tdcbf->slot_bytes  = header + buckets * tdcbf->counter_bytes;
+	tdcbf->slot_bytes  = (tdcbf->slot_bytes + header - 1) / header * header;
+	tdcbf->filter_size = tdcbf->size * tdcbf->slot_bytes;
+
+	tdcbf->filter = calloc(tdcbf->size, tdcbf->slot_bytes);
+	if (tdcbf->filter == NULL) {
+		return TDCBF_OUTOFMEMORY;
+	}
+
+	return TDCBF_SUCCESS;
+}
+
+/* tdcbloom_destroy() - free memory allocated by tdcbloom_init()
+ *
+ * Args:
+ *     tdcbf - filter to destroy
+ *
+ * Returns:
+ *     Nothing
+ */
+void tdcbloom_destroy(tdcbloom tdcbf) {
+	free(tdcbf.filter);
+}
+
+/* tdcbloom_clear() - clear all counts and reset the start time to 'now'
+ *
+ * Args:
+ *     tdcbf - filter to clear
+ *
+ * Returns:
+ *     Nothing
+ */
+void tdcbloom_clear(tdcbloom *tdcbf) {
+	memset(tdcbf->filter, 0, tdcbf->filter_size);
+	tdcbf->start_time = get_monotonic_ms();
+}
+
+/* current_epoch() - number of bucket spans elapsed since start_time, modulo
+ *                   the stored epoch cycle.
+ */
+static uint32_t current_epoch(const tdcbloom *tdcbf) {
+	int64_t elapsed = get_monotonic_ms() - tdcbf->start_time;
+
+	return (elapsed / (int64_t)tdcbf->span) % tdcbf->cycle;
+}
+
+/* epoch_distance() - number of epochs from 'from' to 'to', accounting for
+ *                    wraparound.
+ */
+static uint32_t epoch_distance(const tdcbloom *tdcbf, uint32_t from, uint32_t to) {
+	return (to >= from) ? to - from : to + (tdcbf->cycle - from);
+}
+
+/* element_position() - slot number of an element's i'th hash
+ */
+static inline uint64_t element_position(const tdcbloom *tdcbf, void *element, const size_t len, int i) {
+	uint64_t hash[2];
+
+	mmh3_128(element, len, i, hash);
+
+	return ((hash[0] % tdcbf->size) + (hash[1] % tdcbf->size)) % tdcbf->size;
+}
+
+/* get_counter(), set_counter() -- helper functions used to handle different
+ *     sized counters. 'counters' points to the first counter of a slot.
+ */
+static inline uint64_t get_counter(const tdcbloom *tdcbf, const uint8_t *counters, size_t bucket) {
+	switch (tdcbf->csize) {
+	case COUNTER_8BIT:  return  ((uint8_t *)counters)[bucket];
+	case COUNTER_16BIT: return ((uint16_t *)counters)[bucket];
+	case COUNTER_32BIT: return ((uint32_t *)counters)[bucket];
+	case COUNTER_64BIT: return ((uint64_t *)counters)[bucket];
+	default:
+		return 0; // shouldn't get here
+	}
+}
+
+static inline void set_counter(const tdcbloom *tdcbf, uint8_t *counters, size_t bucket, uint64_t value) {
+	switch (tdcbf->csize) {
+	case COUNTER_8BIT:  ((uint8_t *)counters)[bucket]  = value; break;
+	case COUNTER_16BIT: ((uint16_t *)counters)[bucket] = value; break;
+	case COUNTER_32BIT: ((uint32_t *)counters)[bucket] = value; break;
+	case COUNTER_64BIT: ((uint64_t *)counters)[bucket] = value; break;
+	default:
+		return; // shouldn't get here
+	}
+}
+
+/* counter_max() - largest value a counter can hold
+ */
+static inline uint64_t counter_max(const tdcbloom *tdcbf) {
+	return (tdcbf->counter_bytes == sizeof(uint64_t)) ? UINT64_MAX : (1ULL << (tdcbf->counter_bytes * 8)) - 1;
+}
+
+/* slot_header() - size of the epoch at the start of each slot, in bytes
+ */
+static inline size_t slot_header(const tdcbloom *tdcbf) {
+	return tdcbf->slot_bytes - tdcbf->buckets * tdcbf->counter_bytes;
+}
+
+/* increment_slot() - count an occurrence in the current bucket of a slot,
+ *                    first clearing any buckets that have left the window
+ *                    since the slot was last written.
+ */
+static void increment_slot(tdcbloom *tdcbf, uint64_t position, uint32_t now) {
+	uint8_t  *slot     = tdcbf->filter + position * tdcbf->slot_bytes;
+	uint8_t  *counters = slot + slot_header(tdcbf);
+	uint32_t *epoch    = (uint32_t *)slot;
+	uint32_t  gap      = epoch_distance(tdcbf, *epoch, now);
+
+	if (gap >= tdcbf->buckets) {
+		memset(counters, 0, tdcbf->buckets * tdcbf->counter_bytes);
+	} else {
+		for (uint32_t e = 1; e <= gap; e++) {
+			set_counter(tdcbf, counters, ((uint64_t)*epoch + e) % tdcbf->buckets, 0);
+		}
+	}
+
+	*epoch = now;
+
+	size_t   bucket = now % tdcbf->buckets;
+	uint64_t count  = get_counter(tdcbf, counters, bucket);
+	if (count != counter_max(tdcbf)) {
+		set_counter(tdcbf, counters, bucket, count + 1);
+	}
+}
+
+/* slot_count() - sum of a slot's 'recent' newest buckets as of epoch 'now'
+ */
+static uint64_t slot_count(const tdcbloom *tdcbf, uint64_t position, uint32_t now, size_t recent) {
+	const uint8_t *slot     = tdcbf->filter + position * tdcbf->slot_bytes;
+	const uint8_t *counters = slot + slot_header(tdcbf);
+	uint32_t       epoch    = *(uint32_t *)slot;
+	uint32_t       age      = epoch_distance(tdcbf, epoch, now);
+	uint64_t       count    = 0;
+
+	if (age >= recent) {
+		return 0;
+	}
+
+	size_t bucket = epoch % tdcbf->buckets;
+	for (size_t b = age; b < recent; b++) {
+		uint64_t value = get_counter(tdcbf, counters, bucket);
+		count = (count + value < count) ? UINT64_MAX : count + value;
+		bucket = (bucket == 0) ? tdcbf->buckets - 1 : bucket - 1;
+	}
+
+	return count;
+}
+
+/* window_buckets() - number of buckets needed to cover 'window' seconds
+ */
+static size_t window_buckets(const tdcbloom *tdcbf, const size_t window) {
+	size_t recent = (window * 1000 + tdcbf->span - 1) / tdcbf->span;
+
+	return (recent > tdcbf->buckets) ? tdcbf->buckets : recent;
+}
+
+/* tdcbloom_add() - count an occurrence of an element
+ *
+ * Args:
+ *     tdcbf   - filter to add element to
+ *     element - element to add
+ *     len     - length of element in bytes
+ *
+ * Returns:
+ *     Nothing
+ */
+void tdcbloom_add(tdcbloom *tdcbf, void *element, const size_t len) {
+	uint32_t now = current_epoch(tdcbf);
+
+	for (int i = 0; i < tdcbf->hashcount; i++) {
+		increment_slot(tdcbf, element_position(tdcbf, element, len, i), now);
+	}
+}
+
+/* tdcbloom_add_string() - count an occurrence of a string element
+ *
+ * Args:
+ *     tdcbf   - filter to add element to
+ *     element - string to add
+ *
+ * Returns:
+ *     Nothing
+ */
+void tdcbloom_add_string(tdcbloom *tdcbf, const char *element) {
+	tdcbloom_add(tdcbf, (uint8_t *)element, strlen(element));
+}
+
+/* tdcbloom_add_batch() - count an occurrence of each of several elements
+ *
+ * Elements are hashed a batch at a time, and their slots prefetched before
+ * any are written, so memory latency overlaps rather than being paid one
+ * slot at a time.
+ *
+ * Args:
+ *     tdcbf    - filter to add elements to
+ *     elements - array of elements to add
+ *     lens     - length of each element in bytes
+ *     count    - number of elements
+ *
+ * Returns:
+ *     Nothing
+ */
+void tdcbloom_add_batch(tdcbloom *tdcbf, void **elements, const size_t *lens, const size_t count) {
+	uint32_t now = current_epoch(tdcbf);
+	uint64_t positions[TDCBLOOM_BATCH * TDCBLOOM_MAX_HASHES];
+
+	for (size_t start = 0; start < count; start += TDCBLOOM_BATCH) {
+		size_t n = (count - start < TDCBLOOM_BATCH) ? count - start : TDCBLOOM_BATCH;
+		size_t p = 0;
+
+		for (size_t e = 0; e < n; e++) {
+			for (int i = 0; i < tdcbf->hashcount; i++, p++) {
+				positions[p] = element_position(tdcbf, elements[start + e], lens[start + e], i);
+				__builtin_prefetch(tdcbf->filter + positions[p] * tdcbf->slot_bytes, 1);
+			}
+		}
+
+		for (size_t i = 0; i < p; i++) {
+			increment_slot(tdcbf, positions[i], now);
+		}
+	}
+}
+
+/* tdcbloom_count_in_window() - approximate number of times an element was
+ *                              added within the last 'window' seconds
+ *
+ * Windows are measured in whole buckets, including the bucket currently
+ * being filled, so counts are accurate to within one bucket's span.
+ * Windows longer than the filter's window are treated as the filter's
+ * window.
+ *
+ * Args:
+ *     tdcbf   - filter to use
+ *     element - element to count
+ *     len     - length of element in bytes
+ *     window  - number of seconds to count over
+ *
+ * Returns:
+ *     approximate number of times 'element' was added within 'window'
+ */
+size_t tdcbloom_count_in_window(const tdcbloom tdcbf, void *element, const size_t len, const size_t window) {
+	uint32_t now    = current_epoch(&tdcbf);
+	size_t   recent = window_buckets(&tdcbf, window);
+	uint64_t count  = UINT64_MAX;
+
+	for (int i = 0; i < tdcbf.hashcount && count != 0; i++) {
+		uint64_t current = slot_count(&tdcbf, element_position(&tdcbf, element, len, i), now, recent);
+		if (current < count) {
+			count = current;
+		}
+	}
+
+	return count;
+}
+
+/* tdcbloom_count_in_window_string() - helper function to count string
+ *                                     elements within a window
+ *
+ * Args:
+ *     tdcbf   - filter to use
+ *     element - string to count
+ *     window  - number of seconds to count over
+ *
+ * Returns:
+ *     approximate number of times 'element' was added within 'window'
+ */
+size_t tdcbloom_count_in_window_string(const tdcbloom tdcbf, const char *element, const size_t window) {
+	return tdcbloom_count_in_window(tdcbf, (uint8_t *)element, strlen(element), window);
+}
+
+/* tdcbloom_count() - approximate number of times an element was added
+ *                    within the filter's window
+ *
+ * Args:
+ *     tdcbf   - filter to use
+ *     element - element to count
+ *     len     - length of element in bytes
+ *
+ * Returns:
+ *     approximate number of times 'element' was added within the window
+ */
+size_t tdcbloom_count(const tdcbloom tdcbf, void *element, const size_t len) {
+	return tdcbloom_count_in_window(tdcbf, element, len, tdcbf.window);
+}
+
+/* tdcbloom_count_string() - helper function to count string elements
+ *
+ * Args:
+ *     tdcbf   - filter to use
+ *     element - string to count
+ *
+ * Returns:
+ *     approximate number of times 'element' was added within the window
+ */
+size_t tdcbloom_count_string(const tdcbloom tdcbf, const char *element) {
+	return tdcbloom_count(tdcbf, (uint8_t *)element, strlen(element));
+}
+
+/* tdcbloom_count_batch() - count several elements within a window
+ *
+ * Args:
+ *     tdcbf    - filter to use
+ *     elements - array of elements to count
+ *     lens     - length of each element in bytes
+ *     count    - number of elements
+ *     window   - number of seconds to count over
+ *     results  - array of 'count' values, set to each element's count
+ *
+ * Returns:
+ *     Nothing
+ */
+void tdcbloom_count_batch(const tdcbloom tdcbf, void **elements, const size_t *lens, const size_t count, const size_t window, size_t *results) {
+	uint32_t now    = current_epoch(&tdcbf);
+	size_t   recent = window_buckets(&tdcbf, window);
+	uint64_t positions[TDCBLOOM_BATCH * TDCBLOOM_MAX_HASHES];
+
+	for (size_t start = 0; start < count; start += TDCBLOOM_BATCH) {
+		size_t n = (count - start < TDCBLOOM_BATCH) ? count - start : TDCBLOOM_BATCH;
+		size_t p = 0;
+
+		for (size_t e = 0; e < n; e++) {
+			for (int i = 0; i < tdcbf.hashcount; i++, p++) {
+				positions[p] = element_position(&tdcbf, elements[start + e], lens[start + e], i);
+				__builtin_prefetch(tdcbf.filter + positions[p] * tdcbf.slot_bytes, 0);
+			}
+		}
+
+		p = 0;
+		for (size_t e = 0; e < n; e++) {
+			uint64_t min = UINT64_MAX;
+
+			for (int i = 0; i < tdcbf.hashcount; i++, p++) {
+				uint64_t current = slot_count(&tdcbf, positions[p], now, recent);
+				if (current < min) {
+					min = current;
+				}
+			}
+
+			results[start + e] = min;
+		}
+	}
+}
+
+/* tdcbloom_strerror() - returns string containing error message
+ *
+ * Args:
+ *     error - error number returned from function
+ *
+ * Returns:
+ *     "Unknown error" if 'error' is out of range. Otherwise, a pointer to
+ *     a string containing relevant error message.
+ */
+const char *tdcbloom_strerror(tdcbloom_error_t error) {
+	if (error < 0 || error >= TDCBF_ERRORCOUNT) {
+		return "Unknown error";
+	}
+
+	return tdcbloom_errors[error];
+}
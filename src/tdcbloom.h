@@ -0,0 +1,75 @@
+/* tdcbloom.h
+ */
+#ifndef TDCBLOOM_H
+#define TDCBLOOM_H
+
+#include <time.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "cbloom.h"
+
+/* tdcbloom_error_t -- error handling return values
+ */
+typedef enum {
+	TDCBF_SUCCESS,
+	TDCBF_INVALIDWINDOW,
+	TDCBF_INVALIDBUCKETS,
+	TDCBF_INVALIDCOUNTERSIZE,
+	TDCBF_OUTOFMEMORY,
+	// used for counting number of statuses. don't add statuses below this line
+	TDCBF_ERRORCOUNT
+} tdcbloom_error_t;
+
+/* tdcbloom_errors -- human-readable error messages
+ */
+extern const char *tdcbloom_errors[];
+
+/* TDCBLOOM_MAX_HASHES -- most hashes used per element. hash counts are
+ *                        clamped to 1 through this value, which covers false
+ *                        positive rates down to about 2^-32.
+ */
+#define TDCBLOOM_MAX_HASHES 32
+
+/* tdcbloom -- time-decaying counting bloom filter structure. each slot holds
+ *             a ring of 'buckets' counters, each covering 'span'
+ *             milliseconds, and the epoch of the newest bucket written.
+ */
+typedef struct {
+	size_t        size;          /* number of slots */
+	size_t        hashcount;     /* number of hashes per element */
+	size_t        window;        /* number of seconds counts are kept */
+	size_t        buckets;       /* number of counters per slot */
+	size_t        span;          /* milliseconds covered by one bucket */
+	uint32_t      cycle;         /* epochs are stored modulo this value */
+	counter_size  csize;         /* size of counters: 8, 16, 32, 64 bit */
+	size_t        counter_bytes; /* size of one counter in bytes */
+	size_t        slot_bytes;    /* size of one slot, epoch and counters */
+	size_t        filter_size;   /* size of filter in bytes */
+	size_t        expected;      /* expected number of elements per window */
+	float         accuracy;      /* desired margin of error */
+	int64_t       start_time;    /* monotonic milliseconds at initialization */
+	uint8_t      *filter;        /* array of slots */
+} tdcbloom;
+
+/* function definitions
+ */
+tdcbloom_error_t  tdcbloom_init(tdcbloom *,
+								const size_t,
+								const float,
+								const size_t,
+								const size_t,
+								counter_size);
+void              tdcbloom_destroy(tdcbloom);
+void              tdcbloom_clear(tdcbloom *);
+void              tdcbloom_add(tdcbloom *, void *, const size_t);
+void              tdcbloom_add_string(tdcbloom *, const char *);
+void              tdcbloom_add_batch(tdcbloom *, void **, const size_t *, const size_t);
+size_t            tdcbloom_count(const tdcbloom, void *, const size_t);
+size_t            tdcbloom_count_string(const tdcbloom, const char *);
+size_t            tdcbloom_count_in_window(const tdcbloom, void *, const size_t, const size_t);
+size_t            tdcbloom_count_in_window_string(const tdcbloom, const char *, const size_t);
+void              tdcbloom_count_batch(const tdcbloom, void **, const size_t *, const size_t, const size_t, size_t *);
+const char       *tdcbloom_strerror(tdcbloom_error_t);
+
+#endif /* TDCBLOOM_H */
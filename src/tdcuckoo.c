@@ -0,0 +1,548 @@
+/* tdcuckoo.c
+ *
+ * Time-decaying cuckoo filter. Each entry pairs a 16 bit fingerprint with a
+ * 16 bit timestamp, counted in ticks of 'resolution' milliseconds, so it
+ * answers the same question as tdbloom: "was this element seen in the last
+ * 'timeout' seconds?". Unlike tdbloom, elements can also be removed, and
+ * the false positive rate stays low without needing several slots per
+ * element.
+ *
+ * There is no sweeper. An expired entry counts as an empty slot, so inserts
+ * reclaim them as they go. Timestamps are 16 bits and wrap, so an entry left
+ * alone for long enough would look fresh again. To prevent this, each insert
+ * also clears expired entries from the next few buckets of a pass over the
+ * filter, paced to finish well within (65535 - 2 * timeout_ticks) ticks, and
+ * lookups report nothing once no insert has happened for a whole timeout,
+ * since every entry has expired.
+ */
+#include <time.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "xorshift.h"
+#include "tdcuckoo.h"
+
+const char *tdcuckoo_errors[] = {
+	"Success",
+	"Invalid timeout value",
+	"Invalid time resolution",
+	"Invalid accuracy",
+	"Out of memory"
+};
+
+/* get_monotonic_ms() - get monotonic time in milliseconds.
+ */
+static int64_t get_monotonic_ms() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* current_tick() - number of ticks elapsed since the filter's start time
+ */
+static int64_t current_tick(const tdcuckoo *tdcf) {
+	return (get_monotonic_ms() - tdcf->start_time) / (int64_t)tdcf->resolution;
+}
+
+/* make_entry(), entry_fingerprint() -- pack and unpack entries. the low 16
+ *     bits of an entry are the tick it was written, modulo 65536.
+ */
+static inline uint32_t make_entry(uint16_t fingerprint, int64_t tick) {
+	return ((uint32_t)fingerprint << 16) | (uint16_t)tick;
+}
+
+static inline uint16_t entry_fingerprint(uint32_t entry) {
+	return entry >> 16;
+}
+
+/* entry_age() - ticks since an entry was written
+ */
+static inline uint16_t entry_age(uint32_t entry, int64_t now) {
+	return (uint16_t)((uint16_t)now - (uint16_t)entry);
+}
+
+/* entry_live() - check if a slot holds an unexpired entry
+ */
+static inline bool entry_live(const tdcuckoo *tdcf, uint32_t entry, int64_t now) {
+	return entry != 0 && entry_age(entry, now) <= tdcf->timeout_ticks;
+}
+
+/* buckets, stash, and evictions come from cuckoocore.h, on 32 bit entries.
+ * expired entries are vacant, so inserts reuse their slots and the stash
+ * drops them.
+ */
+#define CORE_ENTRY                      uint32_t
+#define CORE_FILTER                     tdcuckoo
+#define CORE_STASH_SIZE                 TDCUCKOO_STASH_SIZE
+#define CORE_MAX_KICKS(filter)          TDCUCKOO_MAX_KICKS
+#define CORE_FINGERPRINT(entry)         entry_fingerprint(entry)
+#define CORE_VACANT(filter, entry, now) (!entry_live((filter), (entry), (now)))
+#define CORE_STORED(filter)             ((void)(filter))
+
+#include "cuckoocore.h"
+
+/* reset() - empty the filter and restart its clock
+ */
+static void reset(tdcuckoo *tdcf) {
+	memset(tdcf->entries, 0, tdcf->filter_size);
+	tdcf->stash_count     = 0;
+	tdcf->start_time      = get_monotonic_ms();
+	tdcf->clean_tick      = 0;
+	tdcf->clean_pass_tick = 0;
+	tdcf->clean_position  = 0;
+	tdcf->last_tick       = -(int64_t)tdcf->timeout_ticks - 1;
+}
+
+/* tdcuckoo_init() - initialize a time-decaying cuckoo filter with one
+ *                   second timestamp resolution
+ *
+ * Args:
+ *     tdcf     - pointer to tdcuckoo structure
+ *     expected - maximum expected number of live elements
+ *     accuracy - acceptable false positive rate
+ *     timeout  - number of seconds an element is valid
+ *
+ * Returns:
+ *     TDCF_SUCCESS on success
+ *     TDCF_INVALIDTIMEOUT if value of 'timeout' isn't sane
+ *     TDCF_INVALIDACCURACY if 'accuracy' is too low for 16 bit fingerprints
+ *     TDCF_OUTOFMEMORY if unable to allocate memory
+ */
+tdcuckoo_error_t tdcuckoo_init(tdcuckoo *tdcf, const size_t expected, const float accuracy, const size_t timeout) {
+	return tdcuckoo_init_ex(tdcf, expected, accuracy, timeout, TDCUCKOO_RESOLUTION_DEFAULT);
+}
+
+/* tdcuckoo_init_ex() - initialize a time-decaying cuckoo filter storing
+ *                      timestamps in ticks of 'resolution' milliseconds.
+ *
+ * Timeouts are limited to TDCUCKOO_MAX_TICKS ticks, about nine hours at one
+ * second resolution. The bucket size is picked from 'accuracy': larger
+ * buckets fill more fully, but raise the false positive rate, which is
+ * about 2 * bucket_size / 65536.
+ *
+ * Args:
+ *     tdcf       - pointer to tdcuckoo structure
+ *     expected   - maximum expected number of live elements
+ *     accuracy   - acceptable false positive rate
+ *     timeout    - number of seconds an element is valid
+ *     resolution - milliseconds per timestamp tick. ex: 1000 == 1 second
+ *
+ * Returns:
+ *     TDCF_SUCCESS on success
+ *     TDCF_INVALIDTIMEOUT if value of 'timeout' isn't sane
+ *     TDCF_INVALIDRESOLUTION if value of 'resolution' isn't sane
+ *     TDCF_INVALIDACCURACY if 'accuracy' is too low for 16 bit fingerprints
+ *     TDCF_OUTOFMEMORY if unable to allocate memory
+ */
+tdcuckoo_error_t tdcuckoo_init_ex(tdcuckoo *tdcf, const size_t expected, const float accuracy, const size_t timeout, const size_t resolution) {
+	// bucket sizes and the load factors they reliably reach
+	static const size_t sizes[] = { 8, 4, 2 };
+	static const double loads[] = { 0.95, 0.90, 0.80 };
+	int                 choice  = -1;
+
+	if (resolution == 0) {
+		return TDCF_INVALIDRESOLUTION;
+	}
+
+	if (timeout > SIZE_MAX / 1000 ||
+		(timeout * 1000 + resolution - 1) / resolution > TDCUCKOO_MAX_TICKS) {
+		return TDCF_INVALIDTIMEOUT;
+	}
+
+	for (int i = 0; i < 3; i++) {
+		if (2.0 * sizes[i] / 65536 <= accuracy) {
+			choice = i;
+			break;
+		}
+	}
+
+	if (choice == -1) {
+		return TDCF_INVALIDACCURACY;
+	}
+
+	tdcf->bucket_size   = sizes[choice];
+	tdcf->num_buckets   = (size_t)(expected / (sizes[choice] * loads[choice])) + 1;
+	tdcf->timeout       = timeout;
+	tdcf->resolution    = resolution;
+	tdcf->timeout_ticks = (timeout * 1000 + resolution - 1) / resolution;
+	tdcf->expected      = expected;
+	tdcf->accuracy      = accuracy;
+	tdcf->prng_state    = seed_xorshift32();
+	tdcf->filter_size   = tdcf->num_buckets * tdcf->bucket_size * sizeof(uint32_t);
+
+	tdcf->entries = malloc(tdcf->filter_size);
+	if (tdcf->entries == NULL) {
+		return TDCF_OUTOFMEMORY;
+	}
+
+	reset(tdcf);
+
+	return TDCF_SUCCESS;
+}
+
+/* tdcuckoo_destroy() - uninitialize a time-decaying cuckoo filter
+ *
+ * Args:
+ *     tdcf - filter to destroy
+ *
+ * Returns:
+ *     Nothing
+ */
+void tdcuckoo_destroy(tdcuckoo tdcf) {
+	free(tdcf.entries);
+}
+
+/* tdcuckoo_clear() - clear the contents of a time-decaying cuckoo filter
+ *                    and reset the start time to 'now'
+ *
+ * Args:
+ *     tdcf - filter to clear
+ *
+ * Returns:
+ *     Nothing
+ */
+void tdcuckoo_clear(tdcuckoo *tdcf) {
+	reset(tdcf);
+}
+
+/* element_hash(), alt_index() - a filter's view of cuckoo_hash() and
+ *     cuckoo_alt_index(), so elements hash as they do in cuckoo.c
+ */
+static void element_hash(const tdcuckoo *tdcf, void *key, size_t len, size_t *i1, uint16_t *fingerprint) {
+	cuckoo_hash(key, len, tdcf->num_buckets, 16, i1, fingerprint);
+}
+
+static size_t alt_index(const tdcuckoo *tdcf, size_t index, uint16_t fingerprint) {
+	return cuckoo_alt_index(tdcf->num_buckets, index, fingerprint);
+}
+
+/* find_live() - find a live entry holding 'fingerprint' in either bucket,
+ *               or the stash.
+ *
+ * Returns:
+ *     true and sets 'slot' if found: an index into entries, or the number
+ *          of slots in the buckets plus an index into the stash
+ *     false if there is none
+ */
+static bool find_live(const tdcuckoo *tdcf, size_t i1, size_t i2, uint16_t fingerprint, int64_t now, size_t *slot) {
+	size_t buckets[2] = { i1, i2 };
+	size_t slots      = tdcf->num_buckets * tdcf->bucket_size;
+
+	for (int i = 0; i < ((i1 == i2) ? 1 : 2); i++) {
+		size_t first = buckets[i] * tdcf->bucket_size;
+
+		for (size_t b = first; b < first + tdcf->bucket_size; b++) {
+			if (entry_fingerprint(tdcf->entries[b]) == fingerprint && entry_live(tdcf, tdcf->entries[b], now)) {
+				*slot = b;
+				return true;
+			}
+		}
+	}
+
+	for (size_t s = 0; s < tdcf->stash_count; s++) {
+		const tdcuckoovictim *victim = &tdcf->stash[s];
+
+		if ((victim->index == i1 || victim->index == i2) &&
+			entry_fingerprint(victim->entry) == fingerprint &&
+			entry_live(tdcf, victim->entry, now)) {
+			*slot = slots + s;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* slot_entry(), slot_entry_mutable() - the entry in a slot returned by
+ *     find_live(), read-only for lookups and writable for add and remove
+ */
+static const uint32_t *slot_entry(const tdcuckoo *tdcf, size_t slot) {
+	size_t slots = tdcf->num_buckets * tdcf->bucket_size;
+
+	return (slot < slots) ? &tdcf->entries[slot] : &tdcf->stash[slot - slots].entry;
+}
+
+static uint32_t *slot_entry_mutable(tdcuckoo *tdcf, size_t slot) {
+	size_t slots = tdcf->num_buckets * tdcf->bucket_size;
+
+	return (slot < slots) ? &tdcf->entries[slot] : &tdcf->stash[slot - slots].entry;
+}
+
+/* clean() - clear expired entries from the next few buckets of a pass over
+ *           the filter, so every stored timestamp is checked before it could
+ *           wrap around.
+ *
+ * Once a pass completes, every entry left was written no more than a
+ * timeout before the pass started, and clean_tick moves up to that tick.
+ * Timestamps can be trusted for (65535 - 2 * timeout_ticks) ticks after
+ * clean_tick. Each insert checks TDCUCKOO_CLEAN_BUCKETS buckets, or more if
+ * the pass is behind a schedule finishing it in half that time. If inserts
+ * are so far apart that it still runs out, the whole filter is checked at
+ * once.
+ */
+static void clean(tdcuckoo *tdcf, int64_t now) {
+	int64_t  window = 0xffff - 2 * (int64_t)tdcf->timeout_ticks;
+	int64_t  span   = (window / 2 > 0) ? window / 2 : 1;
+	uint64_t target = (uint64_t)tdcf->clean_position + TDCUCKOO_CLEAN_BUCKETS;
+
+	if (now - tdcf->clean_tick > window) {
+		// nothing written within a timeout is live, and timestamps may
+		// already have wrapped, so they can't be trusted
+		if (now - tdcf->last_tick > (int64_t)tdcf->timeout_ticks) {
+			memset(tdcf->entries, 0, tdcf->filter_size);
+			tdcf->stash_count     = 0;
+			tdcf->clean_tick      = now;
+			tdcf->clean_pass_tick = now;
+			tdcf->clean_position  = 0;
+			return;
+		}
+
+		tdcf->clean_pass_tick = now;
+		tdcf->clean_position  = 0;
+		target                = tdcf->num_buckets;
+	} else {
+		uint64_t due = (uint64_t)tdcf->num_buckets * (uint64_t)(now - tdcf->clean_pass_tick + 1) / (uint64_t)span;
+
+		if (due > target) {
+			target = due;
+		}
+	}
+
+	if (target > tdcf->num_buckets) {
+		target = tdcf->num_buckets;
+	}
+
+	uint32_t *entry = tdcf->entries + tdcf->clean_position * tdcf->bucket_size;
+	uint32_t *end   = tdcf->entries + target * tdcf->bucket_size;
+
+	for (; entry < end; entry++) {
+		if (!entry_live(tdcf, *entry, now)) {
+			*entry = 0;
+		}
+	}
+
+	tdcf->clean_position = target;
+	if (tdcf->clean_position == tdcf->num_buckets) {
+		tdcf->clean_tick      = tdcf->clean_pass_tick;
+		tdcf->clean_pass_tick = now;
+		tdcf->clean_position  = 0;
+	}
+}
+
+/* tdcuckoo_add() - add an element to a time-decaying cuckoo filter. if the
+ *                  element is already present, its timestamp is refreshed.
+ *
+ * Args:
+ *     tdcf    - filter to add element to
+ *     element - element to add to filter
+ *     len     - length of element in bytes
+ *
+ * Returns:
+ *     true if element was added
+ *     false if the filter holds too many live elements to make room. the
+ *           filter is left as it was.
+ */
+bool tdcuckoo_add(tdcuckoo *tdcf, void *element, const size_t len) {
+	size_t   i1;
+	uint16_t fingerprint;
+	int64_t  now = current_tick(tdcf);
+
+	clean(tdcf, now);
+	if (tdcf->stash_count > 0) {
+		core_stash_drain(tdcf, now);
+	}
+
+	element_hash(tdcf, element, len, &i1, &fingerprint);
+	size_t i2 = alt_index(tdcf, i1, fingerprint);
+	size_t slot;
+
+	if (find_live(tdcf, i1, i2, fingerprint, now, &slot)) {
+		*slot_entry_mutable(tdcf, slot) = make_entry(fingerprint, now);
+	} else if (core_insert(tdcf, i1, i2, make_entry(fingerprint, now), now) == false) {
+		return false;
+	}
+
+	tdcf->last_tick = now;
+
+	return true;
+}
+
+/* tdcuckoo_add_string() - helper function to add string elements
+ *
+ * Args:
+ *     tdcf    - filter to add element to
+ *     element - string to add
+ *
+ * Returns:
+ *     true if element was added
+ *     false if the filter holds too many live elements to make room
+ */
+bool tdcuckoo_add_string(tdcuckoo *tdcf, const char *element) {
+	return tdcuckoo_add(tdcf, (void *)element, strlen(element));
+}
+
+/* element_probe() - find an element's live entry
+ *
+ * Returns:
+ *     true and sets 'slot' as find_live() does, and 'now' to the current
+ *          tick, if found
+ *     false if element is not in the filter or has expired
+ */
+static bool element_probe(const tdcuckoo *tdcf, void *element, const size_t len, int64_t *now, size_t *slot) {
+	size_t   i1;
+	uint16_t fingerprint;
+
+	*now = current_tick(tdcf);
+
+	// every entry is older than the newest one, so they have all expired.
+	// past this point, stored timestamps may have wrapped.
+	if (*now - tdcf->last_tick > (int64_t)tdcf->timeout_ticks) {
+		return false;
+	}
+
+	element_hash(tdcf, element, len, &i1, &fingerprint);
+
+	return find_live(tdcf, i1, alt_index(tdcf, i1, fingerprint), fingerprint, *now, slot);
+}
+
+/* tdcuckoo_lookup() - check if an element was added within the timeout
+ *
+ * Args:
+ *     tdcf    - filter to perform lookup against
+ *     element - element to search for
+ *     len     - length of element to search (bytes)
+ *
+ * Returns:
+ *     true if element is likely in the filter
+ *     false if element is definitely not in the filter, or has expired
+ */
+bool tdcuckoo_lookup(const tdcuckoo tdcf, void *element, const size_t len) {
+	int64_t now;
+	size_t  slot;
+
+	return element_probe(&tdcf, element, len, &now, &slot);
+}
+
+/* tdcuckoo_lookup_string() - helper function to handle string lookups
+ *
+ * Args:
+ *     tdcf    - filter to use
+ *     element - string element to lookup
+ *
+ * Returns:
+ *     true if element is likely in the filter
+ *     false if element is definitely not in the filter
+ */
+bool tdcuckoo_lookup_string(const tdcuckoo tdcf, const char *element) {
+	return tdcuckoo_lookup(tdcf, (void *)element, strlen(element));
+}
+
+/* tdcuckoo_lookup_age() - check if an element is in the filter, and how
+ *                         long ago it was last added
+ *
+ * Args:
+ *     tdcf    - filter to perform lookup against
+ *     element - element to search for
+ *     len     - length of element to search (bytes)
+ *     age     - set to the element's age in milliseconds, to the
+ *               filter's resolution, if found
+ *
+ * Returns:
+ *     true if element is in filter
+ *     false if element is not in filter. 'age' is left untouched.
+ */
+bool tdcuckoo_lookup_age(const tdcuckoo tdcf, void *element, const size_t len, uint64_t *age) {
+	int64_t now;
+	size_t  slot;
+
+	if (element_probe(&tdcf, element, len, &now, &slot) == false) {
+		return false;
+	}
+
+	*age = (uint64_t)entry_age(*slot_entry(&tdcf, slot), now) * tdcf.resolution;
+
+	return true;
+}
+
+/* tdcuckoo_lookup_age_string() - helper function to handle string lookups
+ *
+ * Args:
+ *     tdcf    - filter to use
+ *     element - string element to lookup
+ *     age     - set to the element's age in milliseconds if found
+ *
+ * Returns:
+ *     true if element is likely in the filter
+ *     false if element is definitely not in the filter
+ */
+bool tdcuckoo_lookup_age_string(const tdcuckoo tdcf, const char *element, uint64_t *age) {
+	return tdcuckoo_lookup_age(tdcf, (void *)element, strlen(element), age);
+}
+
+/* tdcuckoo_remove() - remove an element before it expires
+ *
+ * Args:
+ *     tdcf    - filter to remove element from
+ *     element - element to remove
+ *     len     - length of element in bytes
+ *
+ * Returns:
+ *     true if element was removed
+ *     false if element was not found
+ */
+bool tdcuckoo_remove(tdcuckoo *tdcf, void *element, const size_t len) {
+	int64_t now;
+	size_t  slot;
+
+	if (element_probe(tdcf, element, len, &now, &slot) == false) {
+		return false;
+	}
+
+	if (slot < tdcf->num_buckets * tdcf->bucket_size) {
+		*slot_entry_mutable(tdcf, slot) = 0;
+
+		if (tdcf->stash_count > 0) {
+			core_stash_drain(tdcf, now);
+		}
+	} else {
+		tdcf->stash[slot - tdcf->num_buckets * tdcf->bucket_size] = tdcf->stash[--tdcf->stash_count];
+	}
+
+	return true;
+}
+
+/* tdcuckoo_remove_string() - helper function to remove string elements
+ *
+ * Args:
+ *     tdcf    - filter to remove element from
+ *     element - string to remove
+ *
+ * Returns:
+ *     true if element was removed
+ *     false if element was not found
+ */
+bool tdcuckoo_remove_string(tdcuckoo *tdcf, const char *element) {
+	return tdcuckoo_remove(tdcf, (void *)element, strlen(element));
+}
+
+/* tdcuckoo_strerror() - returns the error message corresponding to an
+ *                       error code
+ *
+ * Args:
+ *     error - error number returned from a tdcuckoo_* function
+ *
+ * Returns:
+ *     a string containing relevant error message.
+ */
+const char *tdcuckoo_strerror(tdcuckoo_error_t error) {
+	if (error < 0 || error >= TDCF_ERRORCOUNT) {
+		return "Unknown error";
+	}
+
+	return tdcuckoo_errors[error];
+}
@@ -0,0 +1,100 @@
+/* tdcuckoo.h
+ */
+#ifndef TDCUCKOO_H
+#define TDCUCKOO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* tdcuckoo_error_t -- error handling return values
+ */
+typedef enum {
+	TDCF_SUCCESS,
+	TDCF_INVALIDTIMEOUT,
+	TDCF_INVALIDRESOLUTION,
+	TDCF_INVALIDACCURACY,
+	TDCF_OUTOFMEMORY,
+	// used for counting number of statuses. don't add statuses below this line
+	TDCF_ERRORCOUNT
+} tdcuckoo_error_t;
+
+/* tdcuckoo_errors -- human-readable error messages
+ */
+extern const char *tdcuckoo_errors[];
+
+/* TDCUCKOO_RESOLUTION_DEFAULT -- default timestamp tick, in milliseconds
+ */
+#define TDCUCKOO_RESOLUTION_DEFAULT 1000
+
+/* TDCUCKOO_MAX_TICKS -- longest timeout, in ticks. timestamps are 16 bits,
+ *                       and must not wrap within two timeouts.
+ */
+#define TDCUCKOO_MAX_TICKS 0x7fff
+
+/* TDCUCKOO_MAX_KICKS -- maximum number of evictions attempted per insert
+ */
+#define TDCUCKOO_MAX_KICKS 500
+
+/* TDCUCKOO_STASH_SIZE -- number of entries the victim stash can hold
+ */
+#define TDCUCKOO_STASH_SIZE 8
+
+/* TDCUCKOO_CLEAN_BUCKETS -- number of buckets each insert checks for expired
+ *                           entries, unless cleaning has fallen behind
+ */
+#define TDCUCKOO_CLEAN_BUCKETS 8
+
+/* tdcuckoovictim -- an entry that couldn't be placed in a bucket, and one of
+ *                   the two buckets it belongs in.
+ */
+typedef struct {
+	size_t        index;
+	uint32_t      entry;
+} tdcuckoovictim;
+
+/* tdcuckoo -- time-decaying cuckoo filter structure
+ */
+typedef struct {
+	uint32_t       *entries;       /* fingerprint << 16 | timestamp, 0 if empty */
+	size_t          num_buckets;
+	size_t          bucket_size;   /* 2, 4, or 8, picked from accuracy */
+	size_t          timeout;       /* number of seconds an element is valid */
+	size_t          resolution;    /* milliseconds per timestamp tick */
+	size_t          timeout_ticks; /* number of ticks an element is valid */
+	size_t          filter_size;   /* size of buckets in bytes */
+	size_t          expected;      /* expected number of live elements */
+	float           accuracy;      /* desired margin of error */
+	int64_t         start_time;    /* time of filter initialization, ms */
+	int64_t         clean_tick;    /* start of last completed pass clearing expired entries */
+	int64_t         clean_pass_tick; /* tick the current cleaning pass started */
+	size_t          clean_position;  /* next bucket the current cleaning pass checks */
+	int64_t         last_tick;     /* tick of the newest entry written */
+	uint32_t        prng_state;    /* xorshift state */
+	size_t          stash_count;   /* number of entries in stash */
+	tdcuckoovictim  stash[TDCUCKOO_STASH_SIZE]; /* entries with no room in their buckets */
+} tdcuckoo;
+
+/* function definitions
+ */
+tdcuckoo_error_t  tdcuckoo_init(tdcuckoo *,
+								const size_t,
+								const float,
+								const size_t);
+tdcuckoo_error_t  tdcuckoo_init_ex(tdcuckoo *,
+								   const size_t,
+								   const float,
+								   const size_t,
+								   const size_t);
+void              tdcuckoo_destroy(tdcuckoo);
+void              tdcuckoo_clear(tdcuckoo *);
+bool              tdcuckoo_add(tdcuckoo *, void *, const size_t);
+bool              tdcuckoo_add_string(tdcuckoo *, const char *);
+bool              tdcuckoo_lookup(const tdcuckoo, void *, const size_t);
+bool              tdcuckoo_lookup_string(const tdcuckoo, const char *);
+bool              tdcuckoo_lookup_age(const tdcuckoo, void *, const size_t, uint64_t *);
+bool              tdcuckoo_lookup_age_string(const tdcuckoo, const char *, uint64_t *);
+bool              tdcuckoo_remove(tdcuckoo *, void *, const size_t);
+bool              tdcuckoo_remove_string(tdcuckoo *, const char *);
+const char       *tdcuckoo_strerror(tdcuckoo_error_t);
+
+#endif /* TDCUCKOO_H */
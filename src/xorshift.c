@@ -0,0 +1,45 @@
+/* xorshift.c
+ * TODO: xorshift64
+ */
+#include <stdint.h>
+#include <time.h>
+
+#include "xorshift.h"
+
+/* seed_xorshift32() - seed for xorshift32() taken from the monotonic clock
+ *
+ * Args:
+ *     None
+ *
+ * Returns:
+ *     uint32_t seed. never 0, which xorshift can't leave.
+ */
+uint32_t seed_xorshift32() {
+	uint32_t        seed;
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	seed = (uint32_t)(ts.tv_sec ^ ts.tv_nsec);
+
+	return (seed == 0) ? 1 : seed;
+}
+
+/* xorshift32() - fast 32 bit pseudo-random number generator. not suitable
+ *                for anything security related.
+ *
+ * Args:
+ *     state - generator state, updated on each call
+ *
+ * Returns:
+ *     uint32_t pseudo-random number
+ */
+uint32_t xorshift32(uint32_t *state) {
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+
+	return x;
+}
@@ -0,0 +1,13 @@
+/* xorshift.h
+ */
+#ifndef XORSHIFT_H
+#define XORSHIFT_H
+
+#include <stdint.h>
+
+/* function definitions
+ */
+uint32_t seed_xorshift32();
+uint32_t xorshift32(uint32_t *);
+
+#endif /* XORSHIFT_H */
@@ -0,0 +1,125 @@
+/* test_ccuckoo_basic.c
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ccuckoo.h"
+#include "cbloom.h"
+
+#define ELEMENTS 3000
+
+int main() {
+	ccuckoofilter ccf;
+	cbloomfilter  cbf;
+	char          key[32];
+
+	printf("initializing counting cuckoo filter with 4096 slots\n");
+	if (ccuckoo_init(&ccf, 1024, 4, 500) != true) {
+		fprintf(stderr, "FATAL: unable to create counting cuckoo filter\n");
+		return EXIT_FAILURE;
+	}
+
+	// element i is added (i % 5) + 1 times
+	for (int i = 0; i < ELEMENTS; i++) {
+		snprintf(key, sizeof(key), "element%d", i);
+		for (int n = 0; n <= i % 5; n++) {
+			if (ccuckoo_add_string(&ccf, key) != true) {
+				fprintf(stderr, "FATAL: unable to add \"%s\"\n", key);
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	printf("%d elements: load factor %.1f%%\n", ELEMENTS, ccuckoo_load_factor(ccf));
+	if (ccf.used + ccf.stash_count > ELEMENTS) {
+		fprintf(stderr, "FATAL: repeated adds should share an entry\n");
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 0; i < ELEMENTS; i++) {
+		snprintf(key, sizeof(key), "element%d", i);
+		if (ccuckoo_count_string(ccf, key) < (size_t)(i % 5) + 1) {
+			fprintf(stderr, "FATAL: \"%s\" count %zu, expected at least %d\n",
+					key, ccuckoo_count_string(ccf, key), (i % 5) + 1);
+			return EXIT_FAILURE;
+		}
+	}
+
+	size_t false_positives = 0;
+	for (int i = 0; i < 100000; i++) {
+		snprintf(key, sizeof(key), "absent%d", i);
+		false_positives += ccuckoo_lookup_string(ccf, key);
+	}
+	printf("false positive rate: %f\n", false_positives / 100000.0);
+	if (false_positives > 100000 * 8.0 / 4096 * 2) {
+		fprintf(stderr, "FATAL: false positive rate too high\n");
+		return EXIT_FAILURE;
+	}
+
+	// removing an occurrence decrements the count; the last one frees it
+	snprintf(key, sizeof(key), "element%d", 4);
+	size_t count = ccuckoo_count_string(ccf, key);
+	for (size_t n = 0; n < count; n++) {
+		if (ccuckoo_remove_string(&ccf, key) != true ||
+			ccuckoo_count_string(ccf, key) != count - n - 1) {
+			fprintf(stderr, "FATAL: remove should decrement \"%s\"\n", key);
+			return EXIT_FAILURE;
+		}
+	}
+	if (ccuckoo_lookup_string(ccf, key) == true || ccuckoo_remove_string(&ccf, key) == true) {
+		fprintf(stderr, "FATAL: \"%s\" should be gone\n", key);
+		return EXIT_FAILURE;
+	}
+
+	ccuckoo_destroy(ccf);
+
+	// counts past CCUCKOO_COUNTER_MAX chain into more entries
+	printf("testing counts past the counter maximum\n");
+	if (ccuckoo_init(&ccf, 1024, 4, 500) != true) {
+		fprintf(stderr, "FATAL: unable to create counting cuckoo filter\n");
+		return EXIT_FAILURE;
+	}
+
+	for (int n = 0; n < 40; n++) {
+		if (ccuckoo_add_string(&ccf, "heavy") != true) {
+			fprintf(stderr, "FATAL: unable to add \"heavy\" %d times\n", n + 1);
+			return EXIT_FAILURE;
+		}
+	}
+	if (ccuckoo_count_string(ccf, "heavy") != 40 || ccf.used + ccf.stash_count != 3) {
+		fprintf(stderr, "FATAL: \"heavy\" count %zu in %zu entries, expected 40 in 3\n",
+				ccuckoo_count_string(ccf, "heavy"), ccf.used + ccf.stash_count);
+		return EXIT_FAILURE;
+	}
+
+	for (int n = 0; n < 40; n++) {
+		ccuckoo_remove_string(&ccf, "heavy");
+	}
+	if (ccuckoo_count_string(ccf, "heavy") != 0 || ccf.used != 0) {
+		fprintf(stderr, "FATAL: \"heavy\" should be gone\n");
+		return EXIT_FAILURE;
+	}
+
+	ccuckoo_destroy(ccf);
+
+	// compare memory against a counting bloom filter with a similar error rate
+	printf("comparing memory with a counting bloom filter\n");
+	if (ccuckoo_init(&ccf, ELEMENTS * 100 / 95 / 4 + 1, 4, 500) != true ||
+		cbloom_init(&cbf, ELEMENTS, 0.002, COUNTER_8BIT) != CBF_SUCCESS) {
+		fprintf(stderr, "FATAL: unable to create filters\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("counting cuckoo: %zu bytes, counting bloom: %zu bytes\n",
+		   ccuckoo_memory(ccf), (size_t)cbf.countermap_size);
+	if (ccuckoo_memory(ccf) * 2 > cbf.countermap_size) {
+		fprintf(stderr, "FATAL: counting cuckoo filter should be much smaller\n");
+		return EXIT_FAILURE;
+	}
+
+	ccuckoo_destroy(ccf);
+	cbloom_destroy(cbf);
+
+	return EXIT_SUCCESS;
+}
@@ -1,9 +1,121 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "cuckoo.h"
 
+#define THREADS             4
+#define ELEMENTS_PER_THREAD 3500
+
+/* shared state for concurrent tests. writers publish how many of their
+ * elements are in the filter; readers check that none of those go missing
+ * while fingerprints are moved around them.
+ */
+typedef struct {
+	cuckoofilter *cf;
+	size_t        progress[THREADS];
+	bool          removing;
+	bool          done;
+	bool          failed;
+} shared_state;
+
+typedef struct {
+	shared_state *state;
+	int           id;
+} worker_args;
+
+static void *write_worker(void *arg) {
+	worker_args  *args  = arg;
+	shared_state *state = args->state;
+	uint64_t      key;
+
+	for (int i = 0; i < ELEMENTS_PER_THREAD; i++) {
+		key = ((uint64_t)args->id << 32) | i;
+
+		// add every element, or remove the odd ones
+		if (!state->removing) {
+			if (cuckoo_add(state->cf, &key, sizeof(key)) != true) {
+				__atomic_store_n(&state->failed, true, __ATOMIC_RELAXED);
+			}
+			__atomic_store_n(&state->progress[args->id], i + 1, __ATOMIC_RELEASE);
+		} else if (i % 2 == 1 && cuckoo_remove(state->cf, &key, sizeof(key)) != true) {
+			__atomic_store_n(&state->failed, true, __ATOMIC_RELAXED);
+		}
+	}
+
+	return NULL;
+}
+
+static void *read_worker(void *arg) {
+	shared_state *state = arg;
+	uint32_t      n     = 0;
+
+	while (!__atomic_load_n(&state->done, __ATOMIC_ACQUIRE)) {
+		for (int t = 0; t < THREADS; t++) {
+			size_t   published = __atomic_load_n(&state->progress[t], __ATOMIC_ACQUIRE);
+			uint64_t i;
+
+			if (published == 0) {
+				continue;
+			}
+
+			// while removing, only even elements must stay
+			n = n * 1103515245 + 12345;
+			i = (n >> 8) % published;
+			if (state->removing) {
+				i &= ~(uint64_t)1;
+			}
+
+			uint64_t key = ((uint64_t)t << 32) | i;
+			if (cuckoo_lookup(*state->cf, &key, sizeof(key)) != true) {
+				__atomic_store_n(&state->failed, true, __ATOMIC_RELAXED);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/* run_concurrent() - add, then remove, from THREADS writers while two
+ *                    readers look up elements already added
+ */
+static bool run_concurrent(cuckoofilter *cf, bool removing) {
+	static shared_state state;
+	pthread_t           writers[THREADS];
+	pthread_t           readers[2];
+	worker_args         args[THREADS];
+
+	state.cf       = cf;
+	state.removing = removing;
+	state.done     = false;
+	state.failed   = false;
+	if (!removing) {
+		memset(state.progress, 0, sizeof(state.progress));
+	}
+
+	for (int r = 0; r < 2; r++) {
+		pthread_create(&readers[r], NULL, read_worker, &state);
+	}
+
+	for (int t = 0; t < THREADS; t++) {
+		args[t].state = &state;
+		args[t].id    = t;
+		pthread_create(&writers[t], NULL, write_worker, &args[t]);
+	}
+
+	for (int t = 0; t < THREADS; t++) {
+		pthread_join(writers[t], NULL);
+	}
+
+	__atomic_store_n(&state.done, true, __ATOMIC_RELEASE);
+	for (int r = 0; r < 2; r++) {
+		pthread_join(readers[r], NULL);
+	}
+
+	return !state.failed;
+}
+
 int main() {
 	cuckoofilter cf;
 
@@ -11,8 +123,8 @@ int main() {
 	cuckoo_init(&cf, 1000, 4, 500);
 
 	// add elements to filter
-	cuckoo_add(cf, "foo", strlen("foo"));
-	cuckoo_add(cf, "bar", strlen("bar"));
+	cuckoo_add(&cf, "foo", strlen("foo"));
+	cuckoo_add(&cf, "bar", strlen("bar"));
 
 	bool result;
 	result = cuckoo_lookup(cf, "foo", strlen("foo"));
@@ -37,7 +149,7 @@ int main() {
 	}
 
 	// test removal
-	cuckoo_remove(cf, "foo", strlen("foo"));
+	cuckoo_remove(&cf, "foo", strlen("foo"));
 	result = cuckoo_lookup(cf, "foo", strlen("foo"));
 	printf("cuckoo foo lookup: %d\n", result);
 	if (result != false) {
@@ -47,8 +159,8 @@ int main() {
 
 	// test file save/load
 	printf("testing saving/loading\n");
-	cuckoo_add_string(cf, "beep");
-	cuckoo_add_string(cf, "boop");
+	cuckoo_add_string(&cf, "beep");
+	cuckoo_add_string(&cf, "boop");
 
 	printf("saving old filter to /tmp/cuckoo\n");
 	cuckoo_save(cf, "/tmp/cuckoo");
@@ -84,10 +196,383 @@ int main() {
 		return EXIT_FAILURE;
 	}
 
+	// mapped filters serve lookups in place. private mappings are
+	// copy-on-write; shared mappings write changes back to the file
+	printf("mapping /tmp/cuckoo\n");
+	cuckoofilter mapped;
+
+	if (cuckoo_map(&mapped, "/tmp/cuckoo", CUCKOO_MAP_PRIVATE) != true ||
+		cuckoo_lookup_string(mapped, "beep") != true ||
+		mapped.total_insertions != cf.total_insertions) {
+		fprintf(stderr, "FATAL: unable to map /tmp/cuckoo\n");
+		return EXIT_FAILURE;
+	}
+
+	cuckoo_add_string(&mapped, "private");
+	if (cuckoo_lookup_string(mapped, "private") != true) {
+		fprintf(stderr, "FATAL: \"private\" should be in mapped filter\n");
+		return EXIT_FAILURE;
+	}
+
+	if (cuckoo_sync(mapped) != false) {
+		fprintf(stderr, "FATAL: private mappings have nothing to sync\n");
+		return EXIT_FAILURE;
+	}
+	cuckoo_destroy(mapped);
+
+	if (cuckoo_map(&mapped, "/tmp/cuckoo", CUCKOO_MAP_SHARED) != true ||
+		cuckoo_lookup_string(mapped, "private") == true) {
+		fprintf(stderr, "FATAL: private changes should not reach the file\n");
+		return EXIT_FAILURE;
+	}
+
+	cuckoo_add_string(&mapped, "shared");
+	if (cuckoo_sync(mapped) != true) {
+		fprintf(stderr, "FATAL: unable to sync mapped filter\n");
+		return EXIT_FAILURE;
+	}
+	cuckoo_destroy(mapped);
+
+	if (cuckoo_load(&mapped, "/tmp/cuckoo") != true ||
+		cuckoo_lookup_string(mapped, "shared") != true ||
+		mapped.total_insertions != cf.total_insertions + 1) {
+		fprintf(stderr, "FATAL: shared changes should reach the file\n");
+		return EXIT_FAILURE;
+	}
+	cuckoo_destroy(mapped);
+
+	// files from a newer version are rejected
+	FILE *fp = fopen("/tmp/cuckoo", "r+b");
+	fseek(fp, 8, SEEK_SET);
+	fputc(CUCKOO_FILE_VERSION + 1, fp);
+	fclose(fp);
+
+	if (cuckoo_load(&mapped, "/tmp/cuckoo") != false ||
+		cuckoo_map(&mapped, "/tmp/cuckoo", CUCKOO_MAP_PRIVATE) != false) {
+		fprintf(stderr, "FATAL: unknown file versions should be rejected\n");
+		return EXIT_FAILURE;
+	}
+
 	remove("/tmp/cuckoo");
 	remove("/tmp/cuckoo_newcf");
-
 	cuckoo_destroy(newcf);
+
+	// test packed fingerprint widths
+	size_t widths[] = { 8, 12, 16 };
+	char   key[32];
+	for (int w = 0; w < 3; w++) {
+		cuckoofilter pcf;
+
+		printf("testing %zu bit fingerprints\n", widths[w]);
+		if (cuckoo_init_ex(&pcf, 1024, 4, 500, widths[w], 0) != true) {
+			fprintf(stderr, "FATAL: unable to create %zu bit filter\n", widths[w]);
+			return EXIT_FAILURE;
+		}
+
+		if (cuckoo_memory(pcf) != 1024 * 4 * widths[w] / 8) {
+			fprintf(stderr, "FATAL: %zu bit filter should use %zu bytes\n",
+					widths[w], 1024 * 4 * widths[w] / 8);
+			return EXIT_FAILURE;
+		}
+
+		// fill to ~85% load
+		size_t added = 0;
+		for (int i = 0; i < 3480; i++) {
+			snprintf(key, sizeof(key), "element%d", i);
+			if (cuckoo_add_string(&pcf, key) != true) {
+				break;
+			}
+			added++;
+		}
+
+		printf("added %zu elements, load factor %.1f%%\n", added, cuckoo_load_factor(pcf));
+		if (added != 3480) {
+			fprintf(stderr, "FATAL: filter should reach 85%% load\n");
+			return EXIT_FAILURE;
+		}
+
+		for (size_t i = 0; i < added; i++) {
+			snprintf(key, sizeof(key), "element%zu", i);
+			if (cuckoo_lookup_string(pcf, key) != true) {
+				fprintf(stderr, "FATAL: \"%s\" should be in filter\n", key);
+				return EXIT_FAILURE;
+			}
+		}
+
+		size_t false_positives = 0;
+		for (int i = 0; i < 100000; i++) {
+			snprintf(key, sizeof(key), "absent%d", i);
+			false_positives += cuckoo_lookup_string(pcf, key);
+		}
+
+		// expected rate is about 8 / 2^bits
+		double rate = false_positives / 100000.0;
+		printf("false positive rate: %f\n", rate);
+		if (rate > 2.0 * 8 / (1 << widths[w])) {
+			fprintf(stderr, "FATAL: false positive rate too high\n");
+			return EXIT_FAILURE;
+		}
+
+		for (size_t i = 0; i < added; i += 2) {
+			snprintf(key, sizeof(key), "element%zu", i);
+			if (cuckoo_remove_string(&pcf, key) != true) {
+				fprintf(stderr, "FATAL: unable to remove \"%s\"\n", key);
+				return EXIT_FAILURE;
+			}
+		}
+
+		for (size_t i = 1; i < added; i += 2) {
+			snprintf(key, sizeof(key), "element%zu", i);
+			if (cuckoo_lookup_string(pcf, key) != true) {
+				fprintf(stderr, "FATAL: \"%s\" should survive removals\n", key);
+				return EXIT_FAILURE;
+			}
+		}
+
+		cuckoo_save(pcf, "/tmp/cuckoo");
+		if (cuckoo_load(&newcf, "/tmp/cuckoo") != true ||
+			newcf.fingerprint_bits != widths[w] ||
+			memcmp(newcf.buckets, pcf.buckets, cuckoo_memory(pcf)) != 0) {
+			fprintf(stderr, "FATAL: %zu bit filter should load from disk\n", widths[w]);
+			return EXIT_FAILURE;
+		}
+		remove("/tmp/cuckoo");
+
+		cuckoo_destroy(newcf);
+		cuckoo_destroy(pcf);
+	}
+
+	// exercise bucket probes for every bucket geometry
+	size_t sizes[] = { 2, 4, 8 };
+	for (int b = 0; b < 3; b++) {
+		for (int w = 0; w < 3; w++) {
+			cuckoofilter pcf;
+			size_t       count = 4096 * 7 / 10;
+
+			printf("probing %zu x %zu bit buckets\n", sizes[b], widths[w]);
+			cuckoo_init_ex(&pcf, 4096 / sizes[b], sizes[b], 500, widths[w], 0);
+
+			for (size_t i = 0; i < count; i++) {
+				snprintf(key, sizeof(key), "element%zu", i);
+				if (cuckoo_add_string(&pcf, key) != true) {
+					fprintf(stderr, "FATAL: unable to add \"%s\"\n", key);
+					return EXIT_FAILURE;
+				}
+			}
+
+			for (size_t i = 0; i < count; i++) {
+				snprintf(key, sizeof(key), "element%zu", i);
+				if (cuckoo_lookup_string(pcf, key) != true) {
+					fprintf(stderr, "FATAL: \"%s\" should be in filter\n", key);
+					return EXIT_FAILURE;
+				}
+			}
+
+			for (size_t i = 0; i < count; i++) {
+				snprintf(key, sizeof(key), "element%zu", i);
+				if (cuckoo_remove_string(&pcf, key) != true) {
+					fprintf(stderr, "FATAL: unable to remove \"%s\"\n", key);
+					return EXIT_FAILURE;
+				}
+			}
+
+			for (size_t i = 0; i < cuckoo_memory(pcf); i++) {
+				if (pcf.buckets[i] != 0) {
+					fprintf(stderr, "FATAL: filter should be empty after removals\n");
+					return EXIT_FAILURE;
+				}
+			}
+
+			cuckoo_destroy(pcf);
+		}
+	}
+
+	// breadth-first eviction should fill a filter nearly to capacity
+	// without losing any fingerprints
+	for (int b = 0; b < 3; b++) {
+		cuckoofilter bcf;
+		size_t       added = 0;
+
+		printf("filling %zu slot buckets with BFS evictions\n", sizes[b]);
+		cuckoo_init_ex(&bcf, 4096 / sizes[b], sizes[b], 500, 16, CUCKOO_BFS);
+		for (int i = 0; i < 4096; i++) {
+			snprintf(key, sizeof(key), "element%d", i);
+			if (cuckoo_add_string(&bcf, key) != true) {
+				break;
+			}
+			added++;
+		}
+
+		printf("load factor at first failure: %.1f%%\n", cuckoo_load_factor(bcf));
+		if (cuckoo_load_factor(bcf) < (sizes[b] == 2 ? 80.0 : 90.0)) {
+			fprintf(stderr, "FATAL: BFS evictions should reach a higher load\n");
+			return EXIT_FAILURE;
+		}
+
+		for (size_t i = 0; i < added; i++) {
+			snprintf(key, sizeof(key), "element%zu", i);
+			if (cuckoo_lookup_string(bcf, key) != true) {
+				fprintf(stderr, "FATAL: \"%s\" lost during BFS evictions\n", key);
+				return EXIT_FAILURE;
+			}
+		}
+
+		cuckoo_destroy(bcf);
+	}
+
+	// overflowing fingerprints should go to the stash rather than be lost
+	for (int flags = 0; flags <= CUCKOO_BFS; flags += CUCKOO_BFS) {
+		cuckoofilter scf;
+		size_t       added = 0;
+
+		printf("overflowing a filter into the stash%s\n", flags ? " with BFS evictions" : "");
+		cuckoo_init_ex(&scf, 64, 4, 20, 16, flags);
+		for (int i = 0; i < 1024; i++) {
+			snprintf(key, sizeof(key), "element%d", i);
+			if (cuckoo_add_string(&scf, key) != true) {
+				break;
+			}
+			added++;
+		}
+
+		printf("added %zu elements, %zu stashed\n", added, scf.stash_count);
+		if (scf.stash_count != CUCKOO_STASH_SIZE ||
+			added != scf.total_insertions + scf.stash_count) {
+			fprintf(stderr, "FATAL: failed inserts should fill the stash first\n");
+			return EXIT_FAILURE;
+		}
+
+		for (size_t i = 0; i < added; i++) {
+			snprintf(key, sizeof(key), "element%zu", i);
+			if (cuckoo_lookup_string(scf, key) != true) {
+				fprintf(stderr, "FATAL: \"%s\" was lost\n", key);
+				return EXIT_FAILURE;
+			}
+		}
+
+		// removals free slots, which the stash drains into
+		for (int i = 0; i < 64; i++) {
+			snprintf(key, sizeof(key), "element%d", i);
+			cuckoo_remove_string(&scf, key);
+		}
+		printf("%zu stashed after removals\n", scf.stash_count);
+		if (scf.stash_count == CUCKOO_STASH_SIZE) {
+			fprintf(stderr, "FATAL: removals should drain the stash\n");
+			return EXIT_FAILURE;
+		}
+
+		for (size_t i = 64; i < added; i++) {
+			snprintf(key, sizeof(key), "element%zu", i);
+			if (cuckoo_lookup_string(scf, key) != true) {
+				fprintf(stderr, "FATAL: \"%s\" was lost while draining\n", key);
+				return EXIT_FAILURE;
+			}
+		}
+
+		for (size_t i = 64; i < added; i++) {
+			snprintf(key, sizeof(key), "element%zu", i);
+			if (cuckoo_remove_string(&scf, key) != true) {
+				fprintf(stderr, "FATAL: unable to remove \"%s\"\n", key);
+				return EXIT_FAILURE;
+			}
+		}
+
+		if (scf.total_insertions != 0 || scf.stash_count != 0) {
+			fprintf(stderr, "FATAL: filter should be empty after removals\n");
+			return EXIT_FAILURE;
+		}
+
+		cuckoo_destroy(scf);
+	}
+
+	// batch adds and lookups agree with one at a time
+	{
+		cuckoofilter bcf;
+		char         names[4000][16];
+		void        *keys[4000];
+		size_t       lens[4000];
+		bool         results[4000];
+
+		printf("adding and looking up in batches\n");
+		cuckoo_init_ex(&bcf, 1024, 4, 500, 12, 0);
+
+		for (int i = 0; i < 4000; i++) {
+			snprintf(names[i], sizeof(names[i]), "batch%d", i);
+			keys[i] = names[i];
+			lens[i] = strlen(names[i]);
+		}
+
+		// 2001 isn't a multiple of the batch size
+		if (cuckoo_add_batch(&bcf, keys, lens, 2001, results) != 2001) {
+			fprintf(stderr, "FATAL: unable to add batch\n");
+			return EXIT_FAILURE;
+		}
+
+		cuckoo_lookup_batch(bcf, keys, lens, 4000, results);
+		for (int i = 0; i < 4000; i++) {
+			if (results[i] != cuckoo_lookup(bcf, keys[i], lens[i]) || (i < 2001 && !results[i])) {
+				fprintf(stderr, "FATAL: batch lookup of \"%s\" disagrees\n", names[i]);
+				return EXIT_FAILURE;
+			}
+		}
+
+		cuckoo_destroy(bcf);
+	}
+
+	// concurrent adds, lookups, and removals at 85% load
+	size_t concurrent_widths[] = { 12, 16 };
+	for (size_t w = 0; w < sizeof(concurrent_widths) / sizeof(concurrent_widths[0]); w++) {
+		cuckoofilter ccf;
+
+		printf("adding from %d threads with %zu bit fingerprints\n", THREADS, concurrent_widths[w]);
+		if (cuckoo_init_ex(&ccf, 4096, 4, 500, concurrent_widths[w], CUCKOO_CONCURRENT) != true) {
+			fprintf(stderr, "FATAL: unable to create concurrent cuckoo filter\n");
+			return EXIT_FAILURE;
+		}
+
+		if (run_concurrent(&ccf, false) != true) {
+			fprintf(stderr, "FATAL: lost a fingerprint while adding concurrently\n");
+			return EXIT_FAILURE;
+		}
+
+		for (int t = 0; t < THREADS; t++) {
+			for (int i = 0; i < ELEMENTS_PER_THREAD; i++) {
+				uint64_t k = ((uint64_t)t << 32) | i;
+				if (cuckoo_lookup(ccf, &k, sizeof(k)) != true) {
+					fprintf(stderr, "FATAL: element %d from thread %d is missing\n", i, t);
+					return EXIT_FAILURE;
+				}
+			}
+		}
+
+		printf("load factor %.1f%%\n", cuckoo_load_factor(ccf));
+		if (ccf.total_insertions != THREADS * ELEMENTS_PER_THREAD || ccf.stash_count != 0) {
+			fprintf(stderr, "FATAL: %zu fingerprints stored, expected %d\n",
+					ccf.total_insertions, THREADS * ELEMENTS_PER_THREAD);
+			return EXIT_FAILURE;
+		}
+
+		printf("removing from %d threads\n", THREADS);
+		if (run_concurrent(&ccf, true) != true) {
+			fprintf(stderr, "FATAL: lost a fingerprint while removing concurrently\n");
+			return EXIT_FAILURE;
+		}
+
+		if (ccf.total_insertions != THREADS * ELEMENTS_PER_THREAD / 2) {
+			fprintf(stderr, "FATAL: %zu fingerprints left, expected %d\n",
+					ccf.total_insertions, THREADS * ELEMENTS_PER_THREAD / 2);
+			return EXIT_FAILURE;
+		}
+
+		cuckoo_destroy(ccf);
+	}
+
+	if (cuckoo_init_ex(&newcf, 1024, 4, 500, 10, 0) != false ||
+		cuckoo_init_ex(&newcf, 1024, 3, 500, 16, 0) != false) {
+		fprintf(stderr, "FATAL: invalid geometry should be rejected\n");
+		return EXIT_FAILURE;
+	}
+
 	cuckoo_destroy(cf);
 
 	return EXIT_SUCCESS;
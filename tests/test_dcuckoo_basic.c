@@ -0,0 +1,101 @@
+/* test_dcuckoo_basic.c
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dcuckoo.h"
+
+#define ELEMENTS 5000
+
+int main() {
+	dcuckoo dcf;
+	char    key[32];
+
+	if (dcuckoo_init(&dcf, 256, 4, 500, 16, CUCKOO_CONCURRENT) == true) {
+		fprintf(stderr, "FATAL: CUCKOO_CONCURRENT should be rejected\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("initializing dynamic cuckoo filter with 1024 slots per filter\n");
+	if (dcuckoo_init(&dcf, 256, 4, 500, 16, 0) != true) {
+		fprintf(stderr, "FATAL: unable to create dynamic cuckoo filter\n");
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 0; i < ELEMENTS; i++) {
+		snprintf(key, sizeof(key), "element%d", i);
+		if (dcuckoo_add_string(&dcf, key) != true) {
+			fprintf(stderr, "FATAL: unable to add \"%s\"\n", key);
+			return EXIT_FAILURE;
+		}
+	}
+
+	printf("%d elements: %zu filters, %zu bytes, load factor %.1f%%\n",
+		   ELEMENTS, dcf.count, dcuckoo_memory(dcf), dcuckoo_load_factor(dcf));
+	if (dcf.count < 5 || dcuckoo_count(dcf) != ELEMENTS) {
+		fprintf(stderr, "FATAL: chain should have grown to hold every element\n");
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 0; i < ELEMENTS; i++) {
+		snprintf(key, sizeof(key), "element%d", i);
+		if (dcuckoo_lookup_string(dcf, key) != true) {
+			fprintf(stderr, "FATAL: \"%s\" should be in filter\n", key);
+			return EXIT_FAILURE;
+		}
+	}
+
+	size_t false_positives = 0;
+	for (int i = 0; i < 100000; i++) {
+		snprintf(key, sizeof(key), "absent%d", i);
+		false_positives += dcuckoo_lookup_string(dcf, key);
+	}
+	printf("false positive rate: %f\n", false_positives / 100000.0);
+	if (false_positives > 100000 * 8.0 * dcf.count / 65536 * 2) {
+		fprintf(stderr, "FATAL: false positive rate too high\n");
+		return EXIT_FAILURE;
+	}
+
+	// remove most elements. the chain should shrink without the keys
+	for (int i = 500; i < ELEMENTS; i++) {
+		snprintf(key, sizeof(key), "element%d", i);
+		if (dcuckoo_remove_string(&dcf, key) != true) {
+			fprintf(stderr, "FATAL: unable to remove \"%s\"\n", key);
+			return EXIT_FAILURE;
+		}
+	}
+
+	printf("500 elements: %zu filters, %zu bytes, load factor %.1f%%\n",
+		   dcf.count, dcuckoo_memory(dcf), dcuckoo_load_factor(dcf));
+	if (dcf.count > 2 || dcuckoo_count(dcf) != 500) {
+		fprintf(stderr, "FATAL: chain should shrink after removals\n");
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 0; i < 500; i++) {
+		snprintf(key, sizeof(key), "element%d", i);
+		if (dcuckoo_lookup_string(dcf, key) != true) {
+			fprintf(stderr, "FATAL: \"%s\" was lost while shrinking\n", key);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// growing again after shrinking
+	for (int i = 500; i < ELEMENTS; i++) {
+		snprintf(key, sizeof(key), "element%d", i);
+		dcuckoo_add_string(&dcf, key);
+	}
+
+	for (int i = 0; i < ELEMENTS; i++) {
+		snprintf(key, sizeof(key), "element%d", i);
+		if (dcuckoo_lookup_string(dcf, key) != true) {
+			fprintf(stderr, "FATAL: \"%s\" should be in filter\n", key);
+			return EXIT_FAILURE;
+		}
+	}
+
+	dcuckoo_destroy(dcf);
+
+	return EXIT_SUCCESS;
+}
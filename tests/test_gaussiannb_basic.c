@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <math.h>
+#include <unistd.h>
 
 #include "gaussiannb.h"
 
@@ -55,6 +57,88 @@ int main() {
 		return EXIT_FAILURE;
 	}
 
+	// far from every class, each feature's pdf underflows to 0. the log
+	// likelihood is still finite, and the nearest class wins
+	double far[] = { 1000.0, 1000.0 };
+
+	prediction = gaussiannb_predict(&gnb, far);
+	printf("predicted far sample: %d\n", prediction);
+	if (prediction != 2) {
+		fprintf(stderr, "FAILURE: prediction should be 2\n");
+		return EXIT_FAILURE;
+	}
+
+	// cached constants follow weight changes and updates
+	gaussiannb_adjust_weight(&gnb, 0, 1e-300);
+	prediction = gaussiannb_predict(&gnb, class0);
+	printf("predicted class0 with class 0 weighted down: %d\n", prediction);
+	if (prediction == 0) {
+		fprintf(stderr, "FAILURE: prediction should follow weight\n");
+		return EXIT_FAILURE;
+	}
+	gaussiannb_adjust_weight(&gnb, 0, 1.0);
+
+	for (int i = 0; i < 20; i++) {
+		gaussiannb_update(&gnb, (double[]) { 10.0 + i % 2, 10.0 }, 0, true);
+	}
+
+	double near_update[] = { 10.5, 10.0 };
+	prediction = gaussiannb_predict(&gnb, near_update);
+	printf("predicted sample near updates to class 0: %d\n", prediction);
+	if (prediction != 0) {
+		fprintf(stderr, "FAILURE: prediction should follow updates\n");
+		return EXIT_FAILURE;
+	}
+
+	// batch predictions match single predictions exactly, on both the
+	// vector path and the leftover rows
+	double rows[7][2] = {
+		{ 2.5, 3.5 }, { 4.0, 4.0 }, { 6.0, 6.5 }, { 1000.0, 1000.0 },
+		{ 10.5, 10.0 }, { -3.0, 7.0 }, { 5.0, 5.0 },
+	};
+	int    batch[7];
+	double log_posteriors[7 * 3];
+
+	gaussiannb_predict_batch(&gnb, &rows[0][0], 7, batch, log_posteriors);
+	for (int i = 0; i < 7; i++) {
+		int best = 0;
+
+		for (int c = 1; c < 3; c++) {
+			if (log_posteriors[i * 3 + c] > log_posteriors[i * 3 + best]) {
+				best = c;
+			}
+		}
+
+		if (batch[i] != gaussiannb_predict(&gnb, rows[i]) || batch[i] != best) {
+			fprintf(stderr, "FAILURE: batch prediction %d differs from single prediction\n", i);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// large enough to be split across threads on machines with several CPUs
+	size_t  big_rows = 100003;
+	double *big      = malloc(big_rows * 2 * sizeof(double));
+	int    *big_pred = malloc(big_rows * sizeof(int));
+	if (big == NULL || big_pred == NULL) {
+		fprintf(stderr, "FATAL: malloc()\n");
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < big_rows * 2; i++) {
+		big[i] = (double)(i * 7919 % 1300) / 100.0;
+	}
+
+	gaussiannb_predict_batch(&gnb, big, big_rows, big_pred, NULL);
+	for (size_t i = 0; i < big_rows; i++) {
+		if (big_pred[i] != gaussiannb_predict(&gnb, big + i * 2)) {
+			fprintf(stderr, "FAILURE: batch prediction %zu differs from single prediction\n", i);
+			return EXIT_FAILURE;
+		}
+	}
+
+	free(big);
+	free(big_pred);
+
 	printf("distance from class0 to class2 sample: %f\n",
 		   gaussiannb_mahalanobis_distance(&gnb, class2, 0));
 
@@ -67,5 +151,278 @@ int main() {
 
 	gaussiannb_destroy(gnb);
 
+	// single pass training on a contiguous matrix matches the two pass
+	// trainer, and leaves its input alone
+	gaussiannb two_pass, one_pass;
+	double     matrix[] = {
+		1.0, 2.0,  2.0, 3.0,  1.5, 2.25,
+		3.0, 4.0,  4.0, 5.0,  3.25, 4.5,
+		5.0, 6.0,  6.0, 7.0,  5.75, 6.5,
+	};
+	int        labels[] = { 0, 0, 0, 1, 1, 1, 2, 2, 2 };
+	double    *matrix_rows[9];
+
+	for (int i = 0; i < 9; i++) {
+		matrix_rows[i] = matrix + i * 2;
+	}
+
+	if (gaussiannb_init(&two_pass, 3, 2) != true || gaussiannb_init(&one_pass, 3, 2) != true) {
+		fprintf(stderr, "FATAL: gaussiannb_init()\n");
+		return EXIT_FAILURE;
+	}
+
+	if (gaussiannb_train_contiguous(&one_pass, matrix, labels, 9) != true) {
+		fprintf(stderr, "FAILURE: gaussiannb_train_contiguous()\n");
+		return EXIT_FAILURE;
+	}
+	gaussiannb_train(&two_pass, matrix_rows, labels, 9);
+
+	for (int c = 0; c < 3; c++) {
+		for (int j = 0; j < 2; j++) {
+			if (fabs(one_pass.classes[c].mean[j] - two_pass.classes[c].mean[j]) > 1e-12 ||
+				fabs(one_pass.classes[c].variance[j] - two_pass.classes[c].variance[j]) > 1e-12) {
+				fprintf(stderr, "FAILURE: single pass statistics differ for class %d feature %d\n", c, j);
+				return EXIT_FAILURE;
+			}
+		}
+
+		if (one_pass.classes[c].count != two_pass.classes[c].count ||
+			fabs(one_pass.classes[c].prior - two_pass.classes[c].prior) > 1e-12) {
+			fprintf(stderr, "FAILURE: single pass prior differs for class %d\n", c);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// a NaN feature is skipped rather than overwritten
+	matrix[2] = NAN;
+	if (gaussiannb_train_contiguous(&one_pass, matrix, labels, 9) != true || !isnan(matrix[2])) {
+		fprintf(stderr, "FAILURE: gaussiannb_train_contiguous() modified its input\n");
+		return EXIT_FAILURE;
+	}
+
+	if (fabs(one_pass.classes[0].mean[0] - 1.25) > 1e-12 ||
+		fabs(one_pass.classes[0].mean[1] - 7.25 / 3) > 1e-12) {
+		fprintf(stderr, "FAILURE: NaN feature should be skipped\n");
+		return EXIT_FAILURE;
+	}
+
+	gaussiannb_destroy(two_pass);
+	gaussiannb_destroy(one_pass);
+
+	// models trained on separate shards merge into the model trained on
+	// all of the rows
+	gaussiannb shard_a, shard_b, whole, empty;
+
+	matrix[2] = 2.0;
+	if (gaussiannb_init(&shard_a, 3, 2) != true || gaussiannb_init(&shard_b, 3, 2) != true ||
+		gaussiannb_init(&whole, 3, 2) != true || gaussiannb_init(&empty, 2, 2) != true) {
+		fprintf(stderr, "FATAL: gaussiannb_init()\n");
+		return EXIT_FAILURE;
+	}
+
+	gaussiannb_train_contiguous(&whole, matrix, labels, 9);
+	gaussiannb_train_contiguous(&shard_a, matrix, labels, 4);
+	gaussiannb_train_contiguous(&shard_b, matrix + 4 * 2, labels + 4, 5);
+
+	if (gaussiannb_merge(&empty, &shard_a) != false) {
+		fprintf(stderr, "FAILURE: merged models of different shapes\n");
+		return EXIT_FAILURE;
+	}
+
+	if (gaussiannb_merge(&shard_a, &shard_b) != true) {
+		fprintf(stderr, "FAILURE: gaussiannb_merge()\n");
+		return EXIT_FAILURE;
+	}
+
+	for (int c = 0; c < 3; c++) {
+		for (int j = 0; j < 2; j++) {
+			if (fabs(shard_a.classes[c].mean[j] - whole.classes[c].mean[j]) > 1e-12 ||
+				fabs(shard_a.classes[c].variance[j] - whole.classes[c].variance[j]) > 1e-12) {
+				fprintf(stderr, "FAILURE: merged statistics differ for class %d feature %d\n", c, j);
+				return EXIT_FAILURE;
+			}
+		}
+
+		if (shard_a.classes[c].count != whole.classes[c].count ||
+			fabs(shard_a.classes[c].prior - whole.classes[c].prior) > 1e-12) {
+			fprintf(stderr, "FAILURE: merged prior differs for class %d\n", c);
+			return EXIT_FAILURE;
+		}
+	}
+
+	gaussiannb_destroy(shard_a);
+	gaussiannb_destroy(shard_b);
+	gaussiannb_destroy(whole);
+	gaussiannb_destroy(empty);
+
+	// enough rows to be split across threads on machines with several
+	// CPUs. the merged statistics match the two pass trainer
+	size_t   many      = 200000;
+	double  *many_X    = malloc(many * 2 * sizeof(double));
+	double **many_rows = malloc(many * sizeof(double *));
+	int     *many_y    = malloc(many * sizeof(int));
+	if (many_X == NULL || many_rows == NULL || many_y == NULL ||
+		gaussiannb_init(&two_pass, 3, 2) != true || gaussiannb_init(&one_pass, 3, 2) != true) {
+		fprintf(stderr, "FATAL: malloc()\n");
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < many; i++) {
+		many_y[i]         = i % 3;
+		many_rows[i]      = many_X + i * 2;
+		many_X[i * 2]     = many_y[i] * 2.0 + (double)(i * 7919 % 1000) / 1000.0;
+		many_X[i * 2 + 1] = many_y[i] * 2.0 + (double)(i * 104729 % 1000) / 1000.0;
+	}
+
+	gaussiannb_train_contiguous(&one_pass, many_X, many_y, many);
+	gaussiannb_train(&two_pass, many_rows, many_y, many);
+
+	for (int c = 0; c < 3; c++) {
+		for (int j = 0; j < 2; j++) {
+			if (fabs(one_pass.classes[c].mean[j] - two_pass.classes[c].mean[j]) > 1e-9 ||
+				fabs(one_pass.classes[c].variance[j] - two_pass.classes[c].variance[j]) > 1e-9) {
+				fprintf(stderr, "FAILURE: threaded statistics differ for class %d feature %d\n", c, j);
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	// batched Mahalanobis scoring finds each sample's nearest class. the
+	// vector path matches rows scored one at a time exactly
+	double distances[100], distance;
+	int    nearest[100];
+
+	gaussiannb_mahalanobis_batch(&one_pass, many_X, 100, distances, nearest);
+	for (int i = 0; i < 100; i++) {
+		double best    = INFINITY;
+		int    closest = -1;
+
+		for (int c = 0; c < 3; c++) {
+			double d = gaussiannb_mahalanobis_distance(&one_pass, many_X + i * 2, c);
+			if (d < best) {
+				best    = d;
+				closest = c;
+			}
+		}
+
+		gaussiannb_mahalanobis_batch(&one_pass, many_X + i * 2, 1, &distance, NULL);
+		if (nearest[i] != closest || fabs(distances[i] - best) > 1e-12 * fmax(1.0, best) ||
+			distance != distances[i]) {
+			fprintf(stderr, "FAILURE: batch distance %d is %f to class %d, expected %f to class %d\n",
+					i, distances[i], nearest[i], best, closest);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// streaming top-k keeps the most anomalous samples across calls
+	gaussiannbtopk    topk;
+	gaussiannbanomaly top[10];
+	double           *stream = malloc(1000 * 2 * sizeof(double));
+	double           *scores = malloc(1000 * sizeof(double));
+	if (stream == NULL || scores == NULL || gaussiannb_topk_init(&topk, 10) != true) {
+		fprintf(stderr, "FATAL: malloc()\n");
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 0; i < 1000 * 2; i++) {
+		stream[i] = (double)(i * 7919 % 997) / 50.0 - 5.0;
+	}
+	// a NaN row ranks first, and must not break the ordering of the rest
+	stream[3 * 2] = NAN;
+
+	gaussiannb_mahalanobis_batch(&one_pass, stream, 1000, scores, NULL);
+	if (gaussiannb_mahalanobis_topk(&one_pass, stream, 333, &topk) != true ||
+		gaussiannb_mahalanobis_topk(&one_pass, stream + 333 * 2, 5, &topk) != true ||
+		gaussiannb_mahalanobis_topk(&one_pass, stream + 338 * 2, 662, &topk) != true ||
+		gaussiannb_topk_results(topk, top) != 10) {
+		fprintf(stderr, "FAILURE: gaussiannb_mahalanobis_topk()\n");
+		return EXIT_FAILURE;
+	}
+
+	if (scores[3] != INFINITY || top[0].index != 3 || top[0].distance != INFINITY) {
+		fprintf(stderr, "FAILURE: NaN sample should rank first, got sample %zu at %f\n", top[0].index, top[0].distance);
+		return EXIT_FAILURE;
+	}
+
+	for (int r = 0; r < 10; r++) {
+		size_t larger = 0;
+
+		for (int i = 0; i < 1000; i++) {
+			larger += scores[i] > top[r].distance;
+		}
+
+		if (scores[top[r].index] != top[r].distance || larger > (size_t)r ||
+			(r > 0 && top[r].distance > top[r - 1].distance)) {
+			fprintf(stderr, "FAILURE: top-k result %d is sample %zu at %f\n", r, top[r].index, top[r].distance);
+			return EXIT_FAILURE;
+		}
+	}
+
+	gaussiannb_topk_destroy(topk);
+	free(stream);
+	free(scores);
+
+	// saved models load and map back with identical predictions
+	gaussiannb loaded, mapped;
+	int        original[100], from_file[100];
+
+	printf("saving model to /tmp/gaussiannb\n");
+	if (gaussiannb_save(&one_pass, "/tmp/gaussiannb") != true) {
+		fprintf(stderr, "FAILURE: gaussiannb_save()\n");
+		return EXIT_FAILURE;
+	}
+
+	if (gaussiannb_load(&loaded, "/tmp/gaussiannb") != true ||
+		gaussiannb_map(&mapped, "/tmp/gaussiannb") != true) {
+		fprintf(stderr, "FAILURE: unable to load or map /tmp/gaussiannb\n");
+		return EXIT_FAILURE;
+	}
+
+	if (loaded.num_samples != one_pass.num_samples || mapped.num_samples != one_pass.num_samples ||
+		loaded.classes[1].count != one_pass.classes[1].count || mapped.classes[2].count != one_pass.classes[2].count) {
+		fprintf(stderr, "FAILURE: saved counts differ\n");
+		return EXIT_FAILURE;
+	}
+
+	gaussiannb_predict_batch(&one_pass, many_X, 100, original, NULL);
+	gaussiannb_predict_batch(&loaded, many_X, 100, from_file, NULL);
+	for (int i = 0; i < 100; i++) {
+		if (from_file[i] != original[i] || gaussiannb_predict(&mapped, many_X + i * 2) != original[i]) {
+			fprintf(stderr, "FAILURE: saved model predicts differently\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	// a mapped model can still be trained; the file is left alone
+	if (gaussiannb_train_contiguous(&mapped, matrix, labels, 9) != true ||
+		mapped.mapping != NULL ||
+		fabs(mapped.classes[0].mean[0] - 1.5) > 1e-12) {
+		fprintf(stderr, "FAILURE: unable to retrain mapped model\n");
+		return EXIT_FAILURE;
+	}
+
+	gaussiannb_destroy(loaded);
+	gaussiannb_destroy(mapped);
+
+	// truncated files are rejected
+	FILE *fp = fopen("/tmp/gaussiannb", "r+b");
+	if (fp == NULL || ftruncate(fileno(fp), 100) != 0) {
+		fprintf(stderr, "FATAL: unable to truncate /tmp/gaussiannb\n");
+		return EXIT_FAILURE;
+	}
+	fclose(fp);
+
+	if (gaussiannb_load(&loaded, "/tmp/gaussiannb") != false ||
+		gaussiannb_map(&mapped, "/tmp/gaussiannb") != false) {
+		fprintf(stderr, "FAILURE: loaded a truncated model\n");
+		return EXIT_FAILURE;
+	}
+
+	gaussiannb_destroy(two_pass);
+	gaussiannb_destroy(one_pass);
+	free(many_X);
+	free(many_rows);
+	free(many_y);
+
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "gaussiannb.h"
+#include "gaussiannbf.h"
+
+#define GRID 40
+
+int main() {
+	gaussiannb  gnb;
+	gaussiannbf gnbf, converted;
+
+	// the gaussiannb test data: 3 classes, 2 features
+	double X[6][2] = {
+		{ 1.0, 2.0 }, { 2.0, 3.0 },
+		{ 3.0, 4.0 }, { 4.0, 5.0 },
+		{ 5.0, 6.0 }, { 6.0, 7.0 },
+	};
+	float  Xf[6][2];
+	int    y[] = { 0, 0, 1, 1, 2, 2 };
+
+	for (int i = 0; i < 6; i++) {
+		Xf[i][0] = X[i][0];
+		Xf[i][1] = X[i][1];
+	}
+
+	if (gaussiannb_init(&gnb, 3, 2) != true || gaussiannbf_init(&gnbf, 3, 2) != true) {
+		fprintf(stderr, "FATAL: init\n");
+		return EXIT_FAILURE;
+	}
+
+	if (gaussiannb_train_contiguous(&gnb, &X[0][0], y, 6) != true ||
+		gaussiannbf_train_contiguous(&gnbf, &Xf[0][0], y, 6) != true) {
+		fprintf(stderr, "FATAL: training failed\n");
+		return EXIT_FAILURE;
+	}
+
+	if (gaussiannbf_from_double(&converted, &gnb) != true) {
+		fprintf(stderr, "FAILURE: gaussiannbf_from_double()\n");
+		return EXIT_FAILURE;
+	}
+
+	// statistics agree with the double model to float precision
+	for (int c = 0; c < 3; c++) {
+		for (int j = 0; j < 2; j++) {
+			double mean     = gnb.classes[c].mean[j];
+			double variance = gnb.classes[c].variance[j];
+
+			if (fabs(gnbf.classes[c].mean[j] - mean) > 1e-6 * fabs(mean) ||
+				fabs(gnbf.classes[c].variance[j] - variance) > 1e-6 * variance ||
+				converted.classes[c].mean[j] != gnbf.classes[c].mean[j]) {
+				fprintf(stderr, "FAILURE: statistics differ for class %d feature %d\n", c, j);
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	double class0[] = { 2.5, 3.5 }, class1[] = { 4.0, 4.0 }, class2[] = { 6.0, 6.5 };
+	float  class0f[] = { 2.5, 3.5 }, class1f[] = { 4.0, 4.0 }, class2f[] = { 6.0, 6.5 };
+
+	if (gaussiannbf_predict(&gnbf, class0f) != gaussiannb_predict(&gnb, class0) ||
+		gaussiannbf_predict(&gnbf, class1f) != gaussiannb_predict(&gnb, class1) ||
+		gaussiannbf_predict(&gnbf, class2f) != gaussiannb_predict(&gnb, class2)) {
+		fprintf(stderr, "FAILURE: float predictions differ from double\n");
+		return EXIT_FAILURE;
+	}
+
+	// sweep a grid over the data. log posteriors and distances agree
+	// within float precision; predictions agree unless two classes are
+	// within rounding of each other
+	double grid[GRID * GRID][2];
+	float  gridf[GRID * GRID][2];
+	int    predictions[GRID * GRID], predictionsf[GRID * GRID];
+	double log_posteriors[GRID * GRID * 3];
+	float  log_posteriorsf[GRID * GRID * 3];
+	int    disagreements = 0;
+
+	for (int i = 0; i < GRID * GRID; i++) {
+		grid[i][0]  = gridf[i][0] = (i % GRID) * 0.2f;
+		grid[i][1]  = gridf[i][1] = (i / GRID) * 0.2f + 1.0f;
+	}
+
+	gaussiannb_predict_batch(&gnb, &grid[0][0], GRID * GRID, predictions, log_posteriors);
+	gaussiannbf_predict_batch(&gnbf, &gridf[0][0], GRID * GRID, predictionsf, log_posteriorsf);
+
+	for (int i = 0; i < GRID * GRID; i++) {
+		if (predictionsf[i] != gaussiannbf_predict(&gnbf, gridf[i])) {
+			fprintf(stderr, "FAILURE: float batch prediction %d differs from single prediction\n", i);
+			return EXIT_FAILURE;
+		}
+
+		for (int c = 0; c < 3; c++) {
+			double lp = log_posteriors[i * 3 + c];
+
+			if (fabs(log_posteriorsf[i * 3 + c] - lp) > 1e-5 * fmax(1.0, fabs(lp))) {
+				fprintf(stderr, "FAILURE: log posterior %d/%d is %f, expected %f\n", i, c, log_posteriorsf[i * 3 + c], lp);
+				return EXIT_FAILURE;
+			}
+
+			double distance  = gaussiannb_mahalanobis_distance(&gnb, grid[i], c);
+			float  distancef = gaussiannbf_mahalanobis_distance(&gnbf, gridf[i], c);
+			if (fabs(distancef - distance) > 1e-5 * fmax(1.0, distance)) {
+				fprintf(stderr, "FAILURE: distance %d/%d is %f, expected %f\n", i, c, distancef, distance);
+				return EXIT_FAILURE;
+			}
+		}
+
+		if (predictionsf[i] != predictions[i]) {
+			double margin = fabs(log_posteriors[i * 3 + predictions[i]] - log_posteriors[i * 3 + predictionsf[i]]);
+
+			if (margin > 1e-4 * fmax(1.0, fabs(log_posteriors[i * 3 + predictions[i]]))) {
+				fprintf(stderr, "FAILURE: float prediction %d is %d, expected %d\n", i, predictionsf[i], predictions[i]);
+				return EXIT_FAILURE;
+			}
+			disagreements++;
+		}
+	}
+
+	printf("float and double disagree on %d of %d grid points\n", disagreements, GRID * GRID);
+
+	// batch Mahalanobis scoring agrees with the double batch within float
+	// precision, and with the single sample distance exactly. the last few
+	// rows don't fill a vector, and take the scalar path
+	double distances[GRID * GRID];
+	float  distancesf[GRID * GRID];
+	int    nearest[GRID * GRID], nearestf[GRID * GRID];
+	size_t rows = GRID * GRID - 3;
+
+	gridf[5][1] = NAN;
+	grid[5][1]  = NAN;
+	gaussiannb_mahalanobis_batch(&gnb, &grid[0][0], rows, distances, nearest);
+	gaussiannbf_mahalanobis_batch(&gnbf, &gridf[0][0], rows, distancesf, nearestf);
+
+	for (size_t i = 0; i < rows; i++) {
+		if (nearestf[i] == -1) {
+			if (distancesf[i] != INFINITY || nearest[i] != -1) {
+				fprintf(stderr, "FAILURE: batch distance %zu should be infinite\n", i);
+				return EXIT_FAILURE;
+			}
+			continue;
+		}
+
+		if (distancesf[i] != gaussiannbf_mahalanobis_distance(&gnbf, gridf[i], nearestf[i])) {
+			fprintf(stderr, "FAILURE: float batch distance %zu differs from single distance\n", i);
+			return EXIT_FAILURE;
+		}
+
+		if (fabs(distancesf[i] - distances[i]) > 1e-5 * fmax(1.0, distances[i])) {
+			fprintf(stderr, "FAILURE: batch distance %zu is %f, expected %f\n", i, distancesf[i], distances[i]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (nearestf[5] != -1) {
+		fprintf(stderr, "FAILURE: rows with NaN features should have no nearest class\n");
+		return EXIT_FAILURE;
+	}
+
+	// weights still steer predictions
+	gaussiannbf_adjust_weight(&gnbf, 0, 1e-30);
+	if (gaussiannbf_predict(&gnbf, class0f) == 0) {
+		fprintf(stderr, "FAILURE: prediction should follow weight\n");
+		return EXIT_FAILURE;
+	}
+
+	gaussiannb_destroy(gnb);
+	gaussiannbf_destroy(gnbf);
+	gaussiannbf_destroy(converted);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,121 @@
+/* test_swbloom_basic.c
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "swbloom.h"
+
+int main() {
+	swbloom         swbf;
+	swbloom_error_t init_result;
+	bool            result;
+
+	printf("Creating a sliding-window bloom filter. 100 elements, 60 seconds, 4 generations\n");
+	init_result = swbloom_init(&swbf, 100, 0.01, 60, 4);
+	if (init_result != SWBF_SUCCESS) {
+		fprintf(stderr, "FAILURE: %s\n", swbloom_strerror(init_result));
+		return EXIT_FAILURE;
+	}
+
+	printf("generation span: %zu ms\n", swbf.span);
+	printf("bitmap bytes: %zu\n", swbloom_memory(swbf));
+	if (swbf.span != 20000) {
+		fprintf(stderr, "FAILURE: generation span should be 20000ms\n");
+		return EXIT_FAILURE;
+	}
+
+	swbloom_add_string(&swbf, "a");
+	swbloom_add(&swbf, "b", 1);
+
+	result = swbloom_lookup_string(swbf, "a");
+	printf("a: %d\n", result);
+	if (result != true) {
+		fprintf(stderr, "FAILURE: \"a\" should be in filter\n");
+		return EXIT_FAILURE;
+	}
+
+	result = swbloom_lookup(swbf, "b", 1);
+	printf("b: %d\n", result);
+	if (result != true) {
+		fprintf(stderr, "FAILURE: \"b\" should be in filter\n");
+		return EXIT_FAILURE;
+	}
+
+	result = swbloom_lookup_string(swbf, "c");
+	printf("c: %d\n", result);
+	if (result != false) {
+		fprintf(stderr, "FAILURE: \"c\" should NOT be in filter\n");
+		return EXIT_FAILURE;
+	}
+
+	// elements must survive for at least the window
+	puts("sleeping 59 seconds...");
+	swbf.start_time -= 59 * 1000;
+	swbloom_add_string(&swbf, "c");
+
+	result = swbloom_lookup_string(swbf, "a");
+	printf("a: %d\n", result);
+	if (result != true) {
+		fprintf(stderr, "FAILURE: \"a\" should be in filter\n");
+		return EXIT_FAILURE;
+	}
+
+	// and be gone after window + span
+	puts("sleeping 21 more seconds...");
+	swbf.start_time -= 21 * 1000;
+
+	result = swbloom_lookup_string(swbf, "a");
+	printf("a: %d\n", result);
+	if (result != false) {
+		fprintf(stderr, "FAILURE: \"a\" should NOT be in filter\n");
+		return EXIT_FAILURE;
+	}
+
+	result = swbloom_lookup_string(swbf, "c");
+	printf("c: %d\n", result);
+	if (result != true) {
+		fprintf(stderr, "FAILURE: \"c\" should be in filter\n");
+		return EXIT_FAILURE;
+	}
+
+	// adding rotates the expired generation out without clobbering "c"
+	swbloom_add_string(&swbf, "d");
+	if (swbloom_lookup_string(swbf, "a") != false ||
+		swbloom_lookup_string(swbf, "c") != true ||
+		swbloom_lookup_string(swbf, "d") != true) {
+		fprintf(stderr, "FAILURE: wrong results after rotation\n");
+		return EXIT_FAILURE;
+	}
+
+	// idle for longer than all generations combined
+	puts("sleeping 10 minutes...");
+	swbf.start_time -= 600 * 1000;
+	if (swbloom_lookup_string(swbf, "c") != false ||
+		swbloom_lookup_string(swbf, "d") != false) {
+		fprintf(stderr, "FAILURE: filter should be empty\n");
+		return EXIT_FAILURE;
+	}
+
+	swbloom_add_string(&swbf, "e");
+	if (swbloom_lookup_string(swbf, "e") != true ||
+		swbloom_lookup_string(swbf, "d") != false) {
+		fprintf(stderr, "FAILURE: wrong results after long idle period\n");
+		return EXIT_FAILURE;
+	}
+
+	swbloom_clear(&swbf);
+	if (swbloom_lookup_string(swbf, "e") != false) {
+		fprintf(stderr, "FAILURE: \"e\" should NOT be in filter after clear\n");
+		return EXIT_FAILURE;
+	}
+
+	if (swbloom_init(&swbf, 100, 0.01, 60, 1) != SWBF_INVALIDGENERATIONS) {
+		fprintf(stderr, "FAILURE: 1 generation should be rejected\n");
+		return EXIT_FAILURE;
+	}
+
+	swbloom_destroy(swbf);
+
+	return EXIT_SUCCESS;
+}
@@ -4,9 +4,53 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "tdbloom.h"
 
+#define THREADS            4
+#define ELEMENTS_PER_THREAD 5000
+
+typedef struct {
+	tdbloom *tdbf;
+	int      id;
+} worker_args;
+
+static void *add_worker(void *arg) {
+	worker_args *args = arg;
+	uint64_t     key;
+
+	for (int i = 0; i < ELEMENTS_PER_THREAD; i++) {
+		key = ((uint64_t)args->id << 32) | i;
+		tdbloom_add(args->tdbf, &key, sizeof(key));
+	}
+
+	return NULL;
+}
+
+static void *signalling_add_worker(void *arg) {
+	worker_args *args = arg;
+	uint64_t     key;
+
+	for (int i = 0; i < ELEMENTS_PER_THREAD; i++) {
+		key = ((uint64_t)args->id << 32) | i;
+		tdbloom_add(args->tdbf, &key, sizeof(key));
+	}
+	__atomic_store_n(&args->id, -1, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+static void *sweep_worker(void *arg) {
+	tdbloom *tdbf = arg;
+
+	for (int i = 0; i < 100; i++) {
+		tdbloom_sweep(tdbf, tdbf->size / 10);
+	}
+
+	return NULL;
+}
+
 int main() {
 	tdbloom tf;
 
@@ -17,7 +61,7 @@ int main() {
 	printf("time value bytes: %d\n", tf.bytes);
 	printf("max time: %d\n", tf.max_time);
 
-	tdbloom_add_string(tf, "a");
+	tdbloom_add_string(&tf, "a");
 	tdbloom_add(&tf, "b", 1);
 
 	printf("filter hex dump: ");
@@ -49,7 +93,7 @@ int main() {
 	}
 
 	puts("sleeping three seconds to expire results...");
-	tf.start_time -= 3;
+	tf.start_time -= 3 * 1000;
 
 	result = tdbloom_lookup_string(tf, "a");
 	printf("a: %d\n", result);
@@ -65,7 +109,7 @@ int main() {
 		return EXIT_FAILURE;
 	}
 
-	tdbloom_add_string(tf, "c");
+	tdbloom_add_string(&tf, "c");
 	result = tdbloom_lookup(tf, (uint8_t *)"c", 1);
 	printf("c: %d\n", result);
 	if (result != true) {
@@ -75,9 +119,9 @@ int main() {
 
 	tdbloom tf2;
 	tdbloom_init(&tf2, 10, 0.01, 200);
-	tdbloom_add_string(tf2, "testytesttest");
+	tdbloom_add_string(&tf2, "testytesttest");
 	printf("sleeping 270 seconds\n");
-	tf2.start_time -= 270;
+	tf2.start_time -= 270 * 1000;
 
 	result = tdbloom_lookup(tf2, "testytesttest", strlen("testytesttest"));
 	printf("testytesttest: %d\n", result);
@@ -86,8 +130,8 @@ int main() {
 		return EXIT_FAILURE;
 	}
 
-	tf2.start_time += 270; // reset start time
-	tdbloom_add_string(tf2, "lol");
+	tf2.start_time += 270 * 1000; // reset start time
+	tdbloom_add_string(&tf2, "lol");
 	result = tdbloom_lookup(tf2, "lol", strlen("lol"));
 	printf("lol: %d\n", result);
 	if (result != true) {
@@ -95,9 +139,483 @@ int main() {
 		return EXIT_FAILURE;
 	}
 
+	printf("Creating a 10 minute filter with 10 second resolution\n");
+	tdbloom tf3;
+	init_result = tdbloom_init_ex(&tf3, 10, 0.01, 600, 10000, 0);
+	if (init_result != TDBF_SUCCESS) {
+		fprintf(stderr, "FAILURE: %s\n", tdbloom_strerror(init_result));
+		return EXIT_FAILURE;
+	}
+
+	printf("time value bits: %d\n", tf3.bits);
+	if (tf3.bits != 8) {
+		fprintf(stderr, "FAILURE: 60 ticks should fit 8 bit timestamps\n");
+		return EXIT_FAILURE;
+	}
+
+	tdbloom_add_string(&tf3, "coarse");
+	tf3.start_time -= 590 * 1000;
+	result = tdbloom_lookup_string(tf3, "coarse");
+	printf("coarse after 590 seconds: %d\n", result);
+	if (result != true) {
+		fprintf(stderr, "FAILURE: \"coarse\" should be in the filter\n");
+		return EXIT_FAILURE;
+	}
+
+	tf3.start_time -= 20 * 1000;
+	result = tdbloom_lookup_string(tf3, "coarse");
+	printf("coarse after 610 seconds: %d\n", result);
+	if (result != false) {
+		fprintf(stderr, "FAILURE: \"coarse\" should NOT be in the filter\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("Creating a 1 hour filter with packed 12 bit timestamps\n");
+	tdbloom tf4;
+	init_result = tdbloom_init_ex(&tf4, 200, 0.01, 3600,
+								  TDBLOOM_RESOLUTION_DEFAULT, TDBLOOM_PACKED12);
+	if (init_result != TDBF_SUCCESS) {
+		fprintf(stderr, "FAILURE: %s\n", tdbloom_strerror(init_result));
+		return EXIT_FAILURE;
+	}
+
+	printf("time value bits: %d, filter bytes: %zu\n", tf4.bits, tf4.filter_size);
+	if (tf4.bits != 12 || tf4.filter_size != ((tf4.size + 1) / 2) * 3) {
+		fprintf(stderr, "FAILURE: expected packed 12 bit timestamps\n");
+		return EXIT_FAILURE;
+	}
+
+	// neighboring packed slots must not clobber each other
+	char key[16];
+	for (int i = 0; i < 150; i++) {
+		snprintf(key, sizeof(key), "packed%d", i);
+		tdbloom_add_string(&tf4, key);
+		tf4.start_time -= 25 * 1000;
+	}
+
+	for (int i = 0; i < 150; i++) {
+		snprintf(key, sizeof(key), "packed%d", i);
+		result = tdbloom_lookup_string(tf4, key);
+		// element i was added (150 - i) * 25 seconds ago
+		if (result != ((150 - i) * 25 <= 3600)) {
+			fprintf(stderr, "FAILURE: wrong lookup result for \"%s\"\n", key);
+			return EXIT_FAILURE;
+		}
+	}
+
+	printf("Creating a 1 second filter with 100ms resolution\n");
+	tdbloom tf5;
+	init_result = tdbloom_init_ex(&tf5, 10, 0.01, 1, 100, 0);
+	if (init_result != TDBF_SUCCESS || tf5.timeout_ticks != 10) {
+		fprintf(stderr, "FAILURE: unable to create 100ms filter\n");
+		return EXIT_FAILURE;
+	}
+
+	tdbloom_add_string(&tf5, "fast");
+	if (tdbloom_lookup_string(tf5, "fast") != true) {
+		fprintf(stderr, "FAILURE: \"fast\" should be in the filter\n");
+		return EXIT_FAILURE;
+	}
+
+	// start_time is kept in milliseconds, so ticks shorter than a second
+	// expire on time rather than up to a second late
+	tf5.start_time -= 900;
+	if (tdbloom_lookup_string(tf5, "fast") != true) {
+		fprintf(stderr, "FAILURE: \"fast\" should be in the filter after 900ms\n");
+		return EXIT_FAILURE;
+	}
+
+	tf5.start_time -= 200;
+	if (tdbloom_lookup_string(tf5, "fast") != false) {
+		fprintf(stderr, "FAILURE: \"fast\" should expire after 1100ms\n");
+		return EXIT_FAILURE;
+	}
+
+	tf5.start_time -= 2 * 1000;
+	if (tdbloom_lookup_string(tf5, "fast") != false) {
+		fprintf(stderr, "FAILURE: \"fast\" should NOT be in the filter\n");
+		return EXIT_FAILURE;
+	}
+
+	if (tdbloom_init_ex(&tf5, 10, 0.01, 1, 0, 0) != TDBF_INVALIDRESOLUTION) {
+		fprintf(stderr, "FAILURE: resolution of 0 should be rejected\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("Creating a 24 hour filter to answer multiple windows\n");
+	tdbloom tf6;
+	init_result = tdbloom_init(&tf6, 100, 0.01, 86400);
+	if (init_result != TDBF_SUCCESS) {
+		fprintf(stderr, "FAILURE: %s\n", tdbloom_strerror(init_result));
+		return EXIT_FAILURE;
+	}
+
+	size_t   windows[] = { 60, 3600, 86400 };
+	bool     seen[3];
+	uint64_t age;
+
+	tdbloom_add_string(&tf6, "older");
+	tf6.start_time -= 1800 * 1000;
+	tdbloom_add_string(&tf6, "newer");
+
+	result = tdbloom_lookup_age_string(tf6, "older", &age);
+	printf("older: %d, age: %lums\n", result, age);
+	// allow for a tick boundary passing between adding and looking up
+	if (result != true || age < 1800000 || age > 1801000) {
+		fprintf(stderr, "FAILURE: \"older\" should be 30 minutes old\n");
+		return EXIT_FAILURE;
+	}
+
+	result = tdbloom_lookup_windows(tf6, "older", strlen("older"), windows, 3, seen);
+	printf("older: %d, 1m: %d, 1h: %d, 24h: %d\n", result, seen[0], seen[1], seen[2]);
+	if (result != true || seen[0] != false || seen[1] != true || seen[2] != true) {
+		fprintf(stderr, "FAILURE: \"older\" should be in 1h and 24h windows\n");
+		return EXIT_FAILURE;
+	}
+
+	result = tdbloom_lookup_windows(tf6, "newer", strlen("newer"), windows, 3, seen);
+	printf("newer: %d, 1m: %d, 1h: %d, 24h: %d\n", result, seen[0], seen[1], seen[2]);
+	if (result != true || seen[0] != true || seen[1] != true || seen[2] != true) {
+		fprintf(stderr, "FAILURE: \"newer\" should be in all windows\n");
+		return EXIT_FAILURE;
+	}
+
+	result = tdbloom_lookup_windows(tf6, "never", strlen("never"), windows, 3, seen);
+	if (result != false || seen[0] || seen[1] || seen[2]) {
+		fprintf(stderr, "FAILURE: \"never\" should not be in any window\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("Sweeping expired slots from an 8 bit filter\n");
+	tdbloom tf7;
+	tdbloom_init(&tf7, 100, 0.01, 10);
+	tdbloom_add_string(&tf7, "stale");
+
+	// without sweeping, timestamps would wrap around every 255 seconds
+	for (int step = 1; step <= 6; step++) {
+		tf7.start_time -= 85 * 1000;
+
+		size_t cleared = tdbloom_sweep(&tf7, tf7.size);
+		printf("after %d seconds: cleared %zu slots\n", step * 85, cleared);
+		if (cleared == 0) {
+			fprintf(stderr, "FAILURE: sweep should have cleared expired slots\n");
+			return EXIT_FAILURE;
+		}
+
+		if (tdbloom_lookup_string(tf7, "stale") != false) {
+			fprintf(stderr, "FAILURE: \"stale\" should NOT be in the filter\n");
+			return EXIT_FAILURE;
+		}
+
+		tdbloom_add_string(&tf7, "stale");
+		tf7.start_time -= 5 * 1000;
+		if (tdbloom_lookup_string(tf7, "stale") != true) {
+			fprintf(stderr, "FAILURE: \"stale\" should be in the filter\n");
+			return EXIT_FAILURE;
+		}
+		tf7.start_time += 5 * 1000;
+	}
+
+	printf("Sweeping a 16 bit filter in small chunks\n");
+	tdbloom tf8;
+	tdbloom_init(&tf8, 1000, 0.01, 1000);
+	for (int i = 0; i < 100; i++) {
+		snprintf(key, sizeof(key), "old%d", i);
+		tdbloom_add_string(&tf8, key);
+	}
+
+	tf8.start_time -= 2000 * 1000;
+	for (int i = 0; i < 100; i++) {
+		snprintf(key, sizeof(key), "new%d", i);
+		tdbloom_add_string(&tf8, key);
+	}
+
+	size_t cleared = 0;
+	for (size_t swept = 0; swept < tf8.size; swept += 1000) {
+		cleared += tdbloom_sweep(&tf8, 1000);
+	}
+
+	size_t estimate = tdbloom_count_estimate(tf8);
+	printf("cleared %zu slots, estimated %zu live elements\n", cleared, estimate);
+	if (cleared == 0 || estimate < 80 || estimate > 120) {
+		fprintf(stderr, "FAILURE: expected about 100 live elements\n");
+		return EXIT_FAILURE;
+	}
+
+	if (tdbloom_sweep(&tf8, tf8.size) != 0) {
+		fprintf(stderr, "FAILURE: second sweep should not clear anything\n");
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 0; i < 100; i++) {
+		snprintf(key, sizeof(key), "new%d", i);
+		if (tdbloom_lookup_string(tf8, key) != true) {
+			fprintf(stderr, "FAILURE: \"%s\" should be in the filter\n", key);
+			return EXIT_FAILURE;
+		}
+	}
+
+	printf("Adding from %d threads concurrently while sweeping\n", THREADS);
+	tdbloom     tf9;
+	pthread_t   threads[THREADS + 1];
+	worker_args args[THREADS];
+
+	init_result = tdbloom_init_ex(&tf9, THREADS * ELEMENTS_PER_THREAD, 0.01, 3600,
+								  TDBLOOM_RESOLUTION_DEFAULT,
+								  TDBLOOM_CONCURRENT | TDBLOOM_PACKED12);
+	if (init_result != TDBF_SUCCESS || tf9.bits != 16) {
+		fprintf(stderr, "FAILURE: concurrent filters should not pack timestamps\n");
+		return EXIT_FAILURE;
+	}
+
+	for (int t = 0; t < THREADS; t++) {
+		args[t].tdbf = &tf9;
+		args[t].id   = t;
+		pthread_create(&threads[t], NULL, add_worker, &args[t]);
+	}
+	pthread_create(&threads[THREADS], NULL, sweep_worker, &tf9);
+
+	for (int t = 0; t <= THREADS; t++) {
+		pthread_join(threads[t], NULL);
+	}
+
+	for (int t = 0; t < THREADS; t++) {
+		for (int i = 0; i < ELEMENTS_PER_THREAD; i++) {
+			uint64_t k = ((uint64_t)t << 32) | i;
+			if (tdbloom_lookup(tf9, &k, sizeof(k)) != true) {
+				fprintf(stderr, "FAILURE: element %d from thread %d is missing\n", i, t);
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	// with 1ms ticks, the clock moves on while a sweep or lookup is in
+	// progress, so the writer keeps storing timestamps ahead of the tick
+	// the sweep or lookup read when it started.
+	int modes[] = { TDBLOOM_CONCURRENT, TDBLOOM_CONCURRENT | TDBLOOM_TTL };
+	for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+		printf("Sweeping while a writer adds with 1ms ticks, flags %d\n", modes[m]);
+		tdbloom     tf15;
+		pthread_t   writer;
+		worker_args writer_args;
+
+		tdbloom_init_ex(&tf15, 100 * ELEMENTS_PER_THREAD, 0.01, 60, 1, modes[m]);
+
+		writer_args.tdbf = &tf15;
+		writer_args.id   = 7;
+		pthread_create(&writer, NULL, signalling_add_worker, &writer_args);
+		while (__atomic_load_n(&writer_args.id, __ATOMIC_ACQUIRE) != -1) {
+			tdbloom_sweep(&tf15, tf15.size);
+		}
+		pthread_join(writer, NULL);
+
+		for (int i = 0; i < ELEMENTS_PER_THREAD; i++) {
+			uint64_t k = ((uint64_t)7 << 32) | i;
+			if (tdbloom_lookup(tf15, &k, sizeof(k)) != true) {
+				fprintf(stderr, "FAILURE: element %d added during the sweep is missing\n", i);
+				return EXIT_FAILURE;
+			}
+		}
+
+		tdbloom_destroy(tf15);
+	}
+
+	printf("Saving and loading a filter\n");
+	tdbloom tf10, loaded;
+
+	tdbloom_init(&tf10, 100, 0.01, 3600);
+	tdbloom_add_string(&tf10, "persist");
+	tf10.start_time -= 100 * 1000;
+
+	tdbloom_error_t save_result = tdbloom_save(tf10, "/tmp/tdbloom");
+	if (save_result != TDBF_SUCCESS) {
+		fprintf(stderr, "FAILURE: tdbloom_save(): %s\n", tdbloom_strerror(save_result));
+		return EXIT_FAILURE;
+	}
+
+	tdbloom_error_t load_result = tdbloom_load(&loaded, "/tmp/tdbloom");
+	if (load_result != TDBF_SUCCESS) {
+		fprintf(stderr, "FAILURE: tdbloom_load(): %s\n", tdbloom_strerror(load_result));
+		return EXIT_FAILURE;
+	}
+
+	result = tdbloom_lookup_age_string(loaded, "persist", &age);
+	printf("persist: %d, age: %lums\n", result, age);
+	if (result != true || age < 100000 || age > 102000) {
+		fprintf(stderr, "FAILURE: \"persist\" should be about 100 seconds old\n");
+		return EXIT_FAILURE;
+	}
+	tdbloom_destroy(loaded);
+
+	// pretend the host was down for 10 minutes after saving by moving the
+	// saved wall clock anchor, which follows the tdbloom struct, back.
+	FILE    *fp = fopen("/tmp/tdbloom", "r+b");
+	int64_t  wall_ms;
+
+	fseek(fp, sizeof(tdbloom), SEEK_SET);
+	fread(&wall_ms, sizeof(wall_ms), 1, fp);
+	wall_ms -= 600000;
+	fseek(fp, sizeof(tdbloom), SEEK_SET);
+	fwrite(&wall_ms, sizeof(wall_ms), 1, fp);
+	fclose(fp);
+
+	tdbloom_load(&loaded, "/tmp/tdbloom");
+	result = tdbloom_lookup_age_string(loaded, "persist", &age);
+	printf("persist after restart: %d, age: %lums\n", result, age);
+	if (result != true || age < 700000 || age > 702000) {
+		fprintf(stderr, "FAILURE: \"persist\" should be about 700 seconds old\n");
+		return EXIT_FAILURE;
+	}
+	tdbloom_destroy(loaded);
+
+	// down for longer than the filter can represent; everything expired
+	tdbloom tf11;
+	tdbloom_init(&tf11, 100, 0.01, 10);
+	tdbloom_add_string(&tf11, "persist");
+	tdbloom_save(tf11, "/tmp/tdbloom");
+
+	fp = fopen("/tmp/tdbloom", "r+b");
+	fseek(fp, sizeof(tdbloom), SEEK_SET);
+	fread(&wall_ms, sizeof(wall_ms), 1, fp);
+	wall_ms -= 3600000;
+	fseek(fp, sizeof(tdbloom), SEEK_SET);
+	fwrite(&wall_ms, sizeof(wall_ms), 1, fp);
+	fclose(fp);
+
+	tdbloom_load(&loaded, "/tmp/tdbloom");
+	tdbloom_add_string(&loaded, "fresh");
+	if (tdbloom_lookup_string(loaded, "persist") != false ||
+		tdbloom_lookup_string(loaded, "fresh") != true) {
+		fprintf(stderr, "FAILURE: long downtime should expire old elements\n");
+		return EXIT_FAILURE;
+	}
+	tdbloom_destroy(loaded);
+	tdbloom_destroy(tf11);
+
+	printf("Snapshotting and saving a concurrent filter\n");
+	tdbloom snapshot;
+	if (tdbloom_snapshot(&tf9, &snapshot) != TDBF_SUCCESS ||
+		memcmp(snapshot.filter, tf9.filter, tf9.filter_size) != 0) {
+		fprintf(stderr, "FAILURE: snapshot should match original filter\n");
+		return EXIT_FAILURE;
+	}
+
+	if (tdbloom_save(tf9, "/tmp/tdbloom") != TDBF_SUCCESS ||
+		tdbloom_load(&loaded, "/tmp/tdbloom") != TDBF_SUCCESS ||
+		memcmp(loaded.filter, tf9.filter, tf9.filter_size) != 0) {
+		fprintf(stderr, "FAILURE: saved concurrent filter should match original\n");
+		return EXIT_FAILURE;
+	}
+	tdbloom_destroy(loaded);
+	tdbloom_destroy(snapshot);
+
+	remove("/tmp/tdbloom");
+
+	printf("Adding an element with a ttl to a filter without TDBLOOM_TTL\n");
+	tdbloom tf14;
+	tdbloom_init(&tf14, 100, 0.01, 60);
+	tdbloom_add_ttl_string(&tf14, "plain", 30);
+	if (tdbloom_lookup_string(tf14, "plain") != true) {
+		fprintf(stderr, "FAILURE: ttl adds to plain filters should fall back to tdbloom_add()\n");
+		return EXIT_FAILURE;
+	}
+	tdbloom_destroy(tf14);
+
+	printf("Adding elements with their own ttls\n");
+	tdbloom tf12;
+	uint64_t remaining;
+	if (tdbloom_init_ex(&tf12, 1000, 0.01, 3600, 1000, TDBLOOM_TTL) != TDBF_SUCCESS) {
+		fprintf(stderr, "FAILURE: unable to create ttl filter\n");
+		return EXIT_FAILURE;
+	}
+	tdbloom_add_ttl_string(&tf12, "short", 30);
+	tdbloom_add_ttl_string(&tf12, "medium", 300);
+	tdbloom_add_ttl_string(&tf12, "long", 3600);
+	tdbloom_add_ttl_string(&tf12, "clamped", 86400);
+	tdbloom_add_string(&tf12, "default");
+
+	// a shorter ttl shouldn't cut an element's lifetime short
+	tdbloom_add_ttl_string(&tf12, "medium", 30);
+
+	if (tdbloom_lookup_ttl(tf12, "short", strlen("short"), &remaining) != true ||
+		remaining < 29000 || remaining > 30000) {
+		fprintf(stderr, "FAILURE: \"short\" should have 30 seconds left\n");
+		return EXIT_FAILURE;
+	}
+
+	if (tdbloom_lookup_ttl(tf12, "clamped", strlen("clamped"), &remaining) != true ||
+		remaining < 3599000 || remaining > 3600000) {
+		fprintf(stderr, "FAILURE: \"clamped\" should be limited to the timeout\n");
+		return EXIT_FAILURE;
+	}
+
+	if (tdbloom_lookup_age(tf12, "short", strlen("short"), &remaining) != false) {
+		fprintf(stderr, "FAILURE: ttl filters don't track age\n");
+		return EXIT_FAILURE;
+	}
+
+	tf12.start_time -= 31 * 1000;
+	if (tdbloom_lookup_string(tf12, "short") != false ||
+		tdbloom_lookup_string(tf12, "medium") != true) {
+		fprintf(stderr, "FAILURE: only \"short\" should expire after 31 seconds\n");
+		return EXIT_FAILURE;
+	}
+
+	tf12.start_time -= 270 * 1000;
+	if (tdbloom_lookup_string(tf12, "medium") != false ||
+		tdbloom_lookup_string(tf12, "long") != true ||
+		tdbloom_lookup_string(tf12, "default") != true) {
+		fprintf(stderr, "FAILURE: only \"medium\" should expire after 301 seconds\n");
+		return EXIT_FAILURE;
+	}
+
+	if (tdbloom_sweep(&tf12, tf12.size) == 0 ||
+		tdbloom_lookup_ttl(tf12, "long", strlen("long"), &remaining) != true ||
+		remaining < 3298000 || remaining > 3299000) {
+		fprintf(stderr, "FAILURE: sweeping should keep \"long\" with 3299 seconds left\n");
+		return EXIT_FAILURE;
+	}
+
+	tf12.start_time -= 3300 * 1000;
+	if (tdbloom_lookup_string(tf12, "long") != false ||
+		tdbloom_lookup_string(tf12, "clamped") != false) {
+		fprintf(stderr, "FAILURE: all elements should expire after the timeout\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("Sweeping an 8 bit ttl filter\n");
+	tdbloom tf13;
+	tdbloom_init_ex(&tf13, 100, 0.01, 10, 1000, TDBLOOM_TTL);
+	for (int step = 1; step <= 6; step++) {
+		tdbloom_add_ttl_string(&tf13, "stale", 10);
+		tf13.start_time -= 85 * 1000;
+
+		if (tdbloom_sweep(&tf13, tf13.size) == 0 ||
+			tdbloom_lookup_string(tf13, "stale") != false) {
+			fprintf(stderr, "FAILURE: sweep should have cleared expired slots\n");
+			return EXIT_FAILURE;
+		}
+
+		tdbloom_add_ttl_string(&tf13, "fresh", 10);
+		if (tdbloom_lookup_string(tf13, "fresh") != true) {
+			fprintf(stderr, "FAILURE: \"fresh\" should be in the filter\n");
+			return EXIT_FAILURE;
+		}
+	}
+
 	// Cleanup
+	tdbloom_destroy(tf13);
+	tdbloom_destroy(tf12);
+	tdbloom_destroy(tf10);
+	tdbloom_destroy(tf9);
+	tdbloom_destroy(tf7);
+	tdbloom_destroy(tf8);
+	tdbloom_destroy(tf6);
 	tdbloom_destroy(tf);
 	tdbloom_destroy(tf2);
+	tdbloom_destroy(tf3);
+	tdbloom_destroy(tf4);
+	tdbloom_destroy(tf5);
 
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,169 @@
+/* test_tdcbloom_basic.c
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tdcbloom.h"
+
+#define BATCH_ELEMENTS 1000
+
+int main() {
+	tdcbloom         tdcbf;
+	tdcbloom_error_t init_result;
+	size_t           count;
+
+	printf("Creating a time-decaying counting filter. 100 elements, 60 seconds, 6 buckets\n");
+	init_result = tdcbloom_init(&tdcbf, 100, 0.01, 60, 6, COUNTER_8BIT);
+	if (init_result != TDCBF_SUCCESS) {
+		fprintf(stderr, "FAILURE: %s\n", tdcbloom_strerror(init_result));
+		return EXIT_FAILURE;
+	}
+
+	printf("bucket span: %zu ms\n", tdcbf.span);
+	printf("slot bytes: %zu\n", tdcbf.slot_bytes);
+	if (tdcbf.span != 10000 || tdcbf.slot_bytes != 12) {
+		fprintf(stderr, "FAILURE: expected 10000ms buckets in 12 byte slots\n");
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 0; i < 5; i++) {
+		tdcbloom_add_string(&tdcbf, "key");
+	}
+
+	count = tdcbloom_count_string(tdcbf, "key");
+	printf("key: %zu\n", count);
+	if (count != 5) {
+		fprintf(stderr, "FAILURE: \"key\" should have been seen 5 times\n");
+		return EXIT_FAILURE;
+	}
+
+	if (tdcbloom_count_string(tdcbf, "other") != 0) {
+		fprintf(stderr, "FAILURE: \"other\" should not have been seen\n");
+		return EXIT_FAILURE;
+	}
+
+	puts("sleeping 10 seconds...");
+	tdcbf.start_time -= 10 * 1000;
+	for (int i = 0; i < 3; i++) {
+		tdcbloom_add(&tdcbf, "key", strlen("key"));
+	}
+
+	if (tdcbloom_count_string(tdcbf, "key") != 8 ||
+		tdcbloom_count_in_window_string(tdcbf, "key", 10) != 3 ||
+		tdcbloom_count_in_window_string(tdcbf, "key", 20) != 8) {
+		fprintf(stderr, "FAILURE: \"key\" should have been seen 3 times in 10s, 8 in 20s\n");
+		return EXIT_FAILURE;
+	}
+
+	puts("sleeping 55 seconds...");
+	tdcbf.start_time -= 55 * 1000;
+	count = tdcbloom_count_string(tdcbf, "key");
+	printf("key: %zu\n", count);
+	if (count != 3 || tdcbloom_count_in_window_string(tdcbf, "key", 10) != 0) {
+		fprintf(stderr, "FAILURE: first 5 occurrences of \"key\" should have expired\n");
+		return EXIT_FAILURE;
+	}
+
+	puts("sleeping 60 seconds...");
+	tdcbf.start_time -= 60 * 1000;
+	if (tdcbloom_count_string(tdcbf, "key") != 0) {
+		fprintf(stderr, "FAILURE: all occurrences of \"key\" should have expired\n");
+		return EXIT_FAILURE;
+	}
+
+	tdcbloom_add_string(&tdcbf, "key");
+	if (tdcbloom_count_string(tdcbf, "key") != 1) {
+		fprintf(stderr, "FAILURE: stale buckets should be cleared when written\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("Saturating 8 bit counters\n");
+	for (int i = 0; i < 300; i++) {
+		tdcbloom_add_string(&tdcbf, "busy");
+	}
+	if (tdcbloom_count_string(tdcbf, "busy") != 255) {
+		fprintf(stderr, "FAILURE: 8 bit counters should saturate at 255\n");
+		return EXIT_FAILURE;
+	}
+	tdcbloom_destroy(tdcbf);
+
+	printf("Adding and counting in batches\n");
+	tdcbloom tdcbf2;
+	char     keys[BATCH_ELEMENTS][16];
+	void    *elements[BATCH_ELEMENTS];
+	size_t   lens[BATCH_ELEMENTS];
+	size_t   counts[BATCH_ELEMENTS];
+
+	tdcbloom_init(&tdcbf2, BATCH_ELEMENTS, 0.01, 60, 6, COUNTER_16BIT);
+	for (int i = 0; i < BATCH_ELEMENTS; i++) {
+		snprintf(keys[i], sizeof(keys[i]), "key%d", i);
+		elements[i] = keys[i];
+		lens[i] = strlen(keys[i]);
+	}
+
+	// element i is added (i / 200) + 1 times
+	for (int pass = 0; pass < 5; pass++) {
+		tdcbloom_add_batch(&tdcbf2, elements + pass * 200, lens + pass * 200, BATCH_ELEMENTS - pass * 200);
+	}
+
+	tdcbloom_count_batch(tdcbf2, elements, lens, BATCH_ELEMENTS, 60, counts);
+	size_t exact = 0;
+	for (int i = 0; i < BATCH_ELEMENTS; i++) {
+		if (counts[i] != tdcbloom_count(tdcbf2, elements[i], lens[i])) {
+			fprintf(stderr, "FAILURE: batch count differs from single count for %s\n", keys[i]);
+			return EXIT_FAILURE;
+		}
+
+		if (counts[i] < (size_t)(i / 200) + 1) {
+			fprintf(stderr, "FAILURE: %s counted fewer times than it was added\n", keys[i]);
+			return EXIT_FAILURE;
+		}
+
+		exact += (counts[i] == (size_t)(i / 200) + 1);
+	}
+
+	printf("exact counts: %zu/%d\n", exact, BATCH_ELEMENTS);
+	if (exact < BATCH_ELEMENTS * 0.95) {
+		fprintf(stderr, "FAILURE: too many overcounts\n");
+		return EXIT_FAILURE;
+	}
+	tdcbloom_destroy(tdcbf2);
+
+	// loose accuracies would round down to no hashes at all, and absurd ones
+	// to more than the batch functions keep per element
+	printf("Clamping hash counts\n");
+	if (tdcbloom_init(&tdcbf, 100, 0.9, 60, 6, COUNTER_8BIT) != TDCBF_SUCCESS ||
+		tdcbloom_init(&tdcbf2, 100, 1e-15, 60, 6, COUNTER_8BIT) != TDCBF_SUCCESS) {
+		fprintf(stderr, "FAILURE: unable to initialize filters\n");
+		return EXIT_FAILURE;
+	}
+
+	if (tdcbf.hashcount != 1 || tdcbf2.hashcount != TDCBLOOM_MAX_HASHES) {
+		fprintf(stderr, "FAILURE: hash counts %zu and %zu should be clamped\n", tdcbf.hashcount, tdcbf2.hashcount);
+		return EXIT_FAILURE;
+	}
+
+	void   *clamped[]     = { "key" };
+	size_t  clamped_len[] = { 3 };
+	tdcbloom_add_batch(&tdcbf, clamped, clamped_len, 1);
+	tdcbloom_add_batch(&tdcbf2, clamped, clamped_len, 1);
+	tdcbloom_count_batch(tdcbf, clamped, clamped_len, 1, 60, counts);
+	tdcbloom_count_batch(tdcbf2, clamped, clamped_len, 1, 60, counts + 1);
+	if (counts[0] != 1 || counts[1] != 1) {
+		fprintf(stderr, "FAILURE: clamped filters should count \"key\" once\n");
+		return EXIT_FAILURE;
+	}
+	tdcbloom_destroy(tdcbf);
+	tdcbloom_destroy(tdcbf2);
+
+	printf("Rejecting invalid parameters\n");
+	if (tdcbloom_init(&tdcbf, 100, 0.01, 0, 6, COUNTER_8BIT) != TDCBF_INVALIDWINDOW ||
+		tdcbloom_init(&tdcbf, 100, 0.01, 60, 0, COUNTER_8BIT) != TDCBF_INVALIDBUCKETS ||
+		tdcbloom_init(&tdcbf, 100, 0.01, 60, 6, 42) != TDCBF_INVALIDCOUNTERSIZE) {
+		fprintf(stderr, "FAILURE: invalid parameters should be rejected\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,175 @@
+/* test_tdcuckoo_basic.c
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tdcuckoo.h"
+
+#define ELEMENTS 2000
+
+/* add_round() - add ELEMENTS elements with a given prefix, then check they
+ *               are all present
+ */
+static bool add_round(tdcuckoo *tdcf, const char *prefix) {
+	char key[32];
+
+	for (int i = 0; i < ELEMENTS; i++) {
+		snprintf(key, sizeof(key), "%s%d", prefix, i);
+		if (tdcuckoo_add_string(tdcf, key) != true) {
+			fprintf(stderr, "FATAL: unable to add \"%s\"\n", key);
+			return false;
+		}
+	}
+
+	for (int i = 0; i < ELEMENTS; i++) {
+		snprintf(key, sizeof(key), "%s%d", prefix, i);
+		if (tdcuckoo_lookup_string(*tdcf, key) != true) {
+			fprintf(stderr, "FATAL: \"%s\" should be in filter\n", key);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main() {
+	tdcuckoo         tdcf;
+	tdcuckoo_error_t result;
+	char             key[32];
+	uint64_t         age;
+
+	if (tdcuckoo_init_ex(&tdcf, ELEMENTS, 0.001, 1, 0) != TDCF_INVALIDRESOLUTION ||
+		tdcuckoo_init(&tdcf, ELEMENTS, 0.001, 86400) != TDCF_INVALIDTIMEOUT ||
+		tdcuckoo_init(&tdcf, ELEMENTS, 0.00001, 60) != TDCF_INVALIDACCURACY) {
+		fprintf(stderr, "FATAL: invalid parameters should be rejected\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("initializing time-decaying cuckoo filter with a 1 second timeout\n");
+	result = tdcuckoo_init_ex(&tdcf, ELEMENTS, 0.001, 1, 100);
+	if (result != TDCF_SUCCESS) {
+		fprintf(stderr, "FATAL: %s\n", tdcuckoo_strerror(result));
+		return EXIT_FAILURE;
+	}
+	printf("%zu buckets of %zu, %zu bytes\n", tdcf.num_buckets, tdcf.bucket_size, tdcf.filter_size);
+
+	if (tdcuckoo_lookup_string(tdcf, "element0") == true) {
+		fprintf(stderr, "FATAL: empty filter should hold nothing\n");
+		return EXIT_FAILURE;
+	}
+
+	if (add_round(&tdcf, "element") != true) {
+		return EXIT_FAILURE;
+	}
+
+	if (tdcuckoo_lookup_age_string(tdcf, "element0", &age) != true || age > 500) {
+		fprintf(stderr, "FATAL: \"element0\" should be fresh\n");
+		return EXIT_FAILURE;
+	}
+
+	size_t false_positives = 0;
+	for (int i = 0; i < 100000; i++) {
+		snprintf(key, sizeof(key), "absent%d", i);
+		false_positives += tdcuckoo_lookup_string(tdcf, key);
+	}
+	printf("false positive rate: %f\n", false_positives / 100000.0);
+	if (false_positives > 100000 * tdcf.accuracy) {
+		fprintf(stderr, "FATAL: false positive rate too high\n");
+		return EXIT_FAILURE;
+	}
+
+	// explicit deletion
+	if (tdcuckoo_remove_string(&tdcf, "element1") != true ||
+		tdcuckoo_lookup_string(tdcf, "element1") == true ||
+		tdcuckoo_remove_string(&tdcf, "element1") == true) {
+		fprintf(stderr, "FATAL: \"element1\" should have been removed\n");
+		return EXIT_FAILURE;
+	}
+
+	// re-adding an element refreshes its timestamp
+	usleep(700000);
+	tdcuckoo_add_string(&tdcf, "element2");
+	usleep(700000);
+
+	printf("checking that elements expired\n");
+	for (int i = 3; i < ELEMENTS; i++) {
+		snprintf(key, sizeof(key), "element%d", i);
+		if (tdcuckoo_lookup_string(tdcf, key) == true) {
+			fprintf(stderr, "FATAL: \"%s\" should have expired\n", key);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (tdcuckoo_lookup_age_string(tdcf, "element2", &age) != true || age > 1000) {
+		fprintf(stderr, "FATAL: \"element2\" should have been refreshed\n");
+		return EXIT_FAILURE;
+	}
+
+	// the filter is sized for ELEMENTS live elements. another full round only
+	// fits if expired entries are reclaimed
+	printf("refilling over expired entries\n");
+	if (add_round(&tdcf, "second") != true) {
+		return EXIT_FAILURE;
+	}
+
+	tdcuckoo_clear(&tdcf);
+	if (tdcuckoo_lookup_string(tdcf, "second0") == true) {
+		fprintf(stderr, "FATAL: cleared filter should hold nothing\n");
+		return EXIT_FAILURE;
+	}
+
+	tdcuckoo_destroy(tdcf);
+
+	// expired entries are cleared a few buckets per insert. walk a 1 ms
+	// resolution filter's clock past timestamp wraparound, inserting as it
+	// goes, and check no old entry comes back to life
+	printf("cleaning expired entries incrementally\n");
+	result = tdcuckoo_init_ex(&tdcf, ELEMENTS, 0.001, 1, 1);
+	if (result != TDCF_SUCCESS) {
+		fprintf(stderr, "FATAL: %s\n", tdcuckoo_strerror(result));
+		return EXIT_FAILURE;
+	}
+
+	if (add_round(&tdcf, "old") != true) {
+		return EXIT_FAILURE;
+	}
+
+	for (int step = 0; step < 33; step++) {
+		size_t position = tdcf.clean_position;
+
+		tdcf.start_time -= 2000;
+		snprintf(key, sizeof(key), "walk%d", step);
+		tdcuckoo_add_string(&tdcf, key);
+
+		size_t cleaned = (tdcf.clean_position + tdcf.num_buckets - position) % tdcf.num_buckets;
+		if (cleaned == 0 || cleaned > tdcf.num_buckets / 4) {
+			fprintf(stderr, "FATAL: one insert should clean part of the filter, not %zu of %zu buckets\n",
+					cleaned, tdcf.num_buckets);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// 65536 ticks after the old entries were written, their timestamps
+	// would read as fresh again
+	tdcf.start_time -= 65536 - 33 * 2000;
+	tdcuckoo_add_string(&tdcf, "walk33");
+
+	if (tdcf.clean_tick == 0 || tdcuckoo_lookup_string(tdcf, "walk33") != true) {
+		fprintf(stderr, "FATAL: cleaning passes should have completed\n");
+		return EXIT_FAILURE;
+	}
+
+	for (int i = 0; i < ELEMENTS; i++) {
+		snprintf(key, sizeof(key), "old%d", i);
+		if (tdcuckoo_lookup_string(tdcf, key) == true) {
+			fprintf(stderr, "FATAL: \"%s\" should have been cleaned\n", key);
+			return EXIT_FAILURE;
+		}
+	}
+
+	tdcuckoo_destroy(tdcf);
+
+	return EXIT_SUCCESS;
+}